@@ -0,0 +1,67 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "asset_packer.h"
+
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+#include "fplbase/asset_pack.h"
+#include "fplbase/utilities.h"
+
+namespace fplbase {
+
+// The name `path` is loaded with: relative to `root_dir`, with forward
+// slashes.
+static std::string PackedName(const std::string& path,
+                              const std::string& root_dir) {
+  std::string name = path;
+  for (auto it = name.begin(); it != name.end(); ++it) {
+    if (*it == '\\') *it = '/';
+  }
+  if (root_dir.empty()) return name;
+  std::string root = root_dir;
+  for (auto it = root.begin(); it != root.end(); ++it) {
+    if (*it == '\\') *it = '/';
+  }
+  if (root.back() != '/') root += '/';
+  if (name.compare(0, root.size(), root) == 0) name.erase(0, root.size());
+  return name;
+}
+
+int RunAssetPacker(const AssetPackerArgs& args) {
+  std::vector<std::pair<std::string, std::string>> entries;
+  size_t total_size = 0;
+  for (const auto& path : args.input_files) {
+    entries.push_back(std::make_pair(PackedName(path, args.root_dir),
+                                     std::string()));
+    if (!fplbase::LoadFileRaw(path.c_str(), &entries.back().second)) {
+      printf("Unable to load file: %s\n", path.c_str());
+      return 1;
+    }
+    total_size += entries.back().second.size();
+  }
+
+  if (!AssetPack::Save(args.output_file.c_str(), entries)) {
+    printf("Could not write %s.\n", args.output_file.c_str());
+    return 1;
+  }
+  printf("Packed %d files (%d bytes) into %s.\n",
+         static_cast<int>(entries.size()), static_cast<int>(total_size),
+         args.output_file.c_str());
+  return 0;
+}
+
+}  // namespace fplbase
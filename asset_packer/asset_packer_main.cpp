@@ -0,0 +1,112 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <sstream>
+
+#include "asset_packer.h"
+#include "fplbase/utilities.h"
+
+// Adds the files listed in `list_file`, one per line.
+static bool ReadFileList(const char* list_file,
+                         std::vector<std::string>* files) {
+  std::string list;
+  if (!fplbase::LoadFileRaw(list_file, &list)) {
+    printf("Unable to load file list: %s\n", list_file);
+    return false;
+  }
+  std::istringstream lines(list);
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (!line.empty() && line.back() == '\r') line.erase(line.size() - 1);
+    if (!line.empty()) files->push_back(line);
+  }
+  return true;
+}
+
+static bool ParseAssetPackerArgs(int argc, char** argv,
+                                 fplbase::AssetPackerArgs* args) {
+  bool valid_args = true;
+
+  // Last parameter is used as the output file.
+  if (argc > 1) {
+    args->output_file = std::string(argv[argc - 1]);
+  } else {
+    valid_args = false;
+  }
+
+  // Parse switches.
+  for (int i = 1; i < argc - 1; ++i) {
+    const std::string arg = argv[i];
+
+    // -r switch
+    if (arg == "-r" || arg == "--root-dir") {
+      if (i < argc - 2) {
+        ++i;
+        args->root_dir = std::string(argv[i]);
+      } else {
+        valid_args = false;
+      }
+
+      // -l switch
+    } else if (arg == "-l" || arg == "--file-list") {
+      if (i < argc - 2) {
+        ++i;
+        valid_args = ReadFileList(argv[i], &args->input_files);
+      } else {
+        valid_args = false;
+      }
+
+      // Unknown switches.
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      printf("Unknown parameter: %s\n", arg.c_str());
+      valid_args = false;
+
+      // all other (non-empty) arguments are files to pack
+    } else if (arg != "") {
+      args->input_files.push_back(arg);
+    }
+
+    if (!valid_args) break;
+  }
+
+  if (args->input_files.empty()) valid_args = false;
+
+  // Print usage.
+  if (!valid_args) {
+    printf(
+        "Usage: asset_packer [-r ROOT_DIR] [-l FILE_LIST] [FILE...]\n"
+        "                    OUTPUT_FILE\n"
+        "\n"
+        "Packs many asset files into one fplpack file, which MountAssetPack()\n"
+        "makes LoadFile() read from.\n"
+        "\n"
+        "Options:\n"
+        "  -r, --root-dir ROOT_DIR   Directory the files are loaded relative\n"
+        "                            to, stripped from their packed names.\n"
+        "  -l, --file-list FILE_LIST File with the files to pack, one per\n"
+        "                            line.\n");
+  }
+
+  return valid_args;
+}
+
+int main(int argc, char** argv) {
+  // Parse the command line arguments.
+  fplbase::AssetPackerArgs args;
+  if (!ParseAssetPackerArgs(argc, argv, &args)) {
+    return 1;
+  }
+  return fplbase::RunAssetPacker(args);
+}
@@ -0,0 +1,126 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "fplbase/compressed_file.h"
+#include "fplbase/utilities.h"
+
+struct FileCompressorArgs {
+  FileCompressorArgs()
+      : block_size(fplbase::kDefaultCompressedBlockSize),
+        decompress(false) {}
+
+  std::string input_file;
+  std::string output_file;
+  size_t block_size;
+  bool decompress;
+};
+
+static bool ParseFileCompressorArgs(int argc, char** argv,
+                                    FileCompressorArgs* args) {
+  bool valid_args = true;
+
+  // The last two parameters are the input and output files.
+  if (argc > 2) {
+    args->input_file = std::string(argv[argc - 2]);
+    args->output_file = std::string(argv[argc - 1]);
+  } else {
+    valid_args = false;
+  }
+
+  // Parse switches.
+  for (int i = 1; i < argc - 2 && valid_args; ++i) {
+    const std::string arg = argv[i];
+
+    // -b switch
+    if (arg == "-b" || arg == "--block-size") {
+      if (i < argc - 3) {
+        ++i;
+        const int block_kb = atoi(argv[i]);
+        valid_args = block_kb > 0;
+        args->block_size = static_cast<size_t>(block_kb) * 1024;
+      } else {
+        valid_args = false;
+      }
+
+      // -d switch
+    } else if (arg == "-d" || arg == "--decompress") {
+      args->decompress = true;
+
+      // Unknown switches.
+    } else {
+      printf("Unknown parameter: %s\n", arg.c_str());
+      valid_args = false;
+    }
+  }
+
+  // Print usage.
+  if (!valid_args) {
+    printf(
+        "Usage: file_compressor [-b BLOCK_KB] [-d] INPUT_FILE OUTPUT_FILE\n"
+        "\n"
+        "Compresses a file in blocks, which LoadFile() decompresses when it\n"
+        "reads the file, using several threads for large files.\n"
+        "\n"
+        "Options:\n"
+        "  -b, --block-size BLOCK_KB Size of the blocks the file is split\n"
+        "                            into, in KB. Default: %d.\n"
+        "  -d, --decompress          Decompress INPUT_FILE instead.\n",
+        static_cast<int>(fplbase::kDefaultCompressedBlockSize / 1024));
+  }
+
+  return valid_args;
+}
+
+static int RunFileCompressor(const FileCompressorArgs& args) {
+  std::string input;
+  if (!fplbase::LoadFileRaw(args.input_file.c_str(), &input)) {
+    printf("Unable to load file: %s\n", args.input_file.c_str());
+    return 1;
+  }
+
+  std::string output;
+  if (args.decompress) {
+    if (!fplbase::DecompressFileData(input.data(), input.size(), &output)) {
+      printf("Not a valid compressed file: %s\n", args.input_file.c_str());
+      return 1;
+    }
+  } else if (!fplbase::CompressFileData(input, args.block_size, &output)) {
+    printf("Invalid block size: %d KB\n",
+           static_cast<int>(args.block_size / 1024));
+    return 1;
+  }
+
+  if (!fplbase::SaveFile(args.output_file.c_str(), output)) {
+    printf("Could not write %s.\n", args.output_file.c_str());
+    return 1;
+  }
+  printf("Wrote %s: %d bytes to %d bytes (%.1f%%).\n",
+         args.output_file.c_str(), static_cast<int>(input.size()),
+         static_cast<int>(output.size()),
+         input.empty() ? 100.0 : 100.0 * output.size() / input.size());
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  // Parse the command line arguments.
+  FileCompressorArgs args;
+  if (!ParseFileCompressorArgs(argc, argv, &args)) {
+    return 1;
+  }
+  return RunFileCompressor(args);
+}
@@ -16,16 +16,41 @@
 #define FPLBASE_ASSET_H
 
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
 
 namespace fplbase {
 
 class AssetManager;
+template <typename T>
+class AssetHandle;
+
+/// @brief How many bytes of memory an asset uses.
+struct AssetMemoryUsage {
+  AssetMemoryUsage() : gpu_bytes(0), cpu_bytes(0) {}
+  AssetMemoryUsage(size_t gpu, size_t cpu) : gpu_bytes(gpu), cpu_bytes(cpu) {}
+
+  size_t total() const { return gpu_bytes + cpu_bytes; }
+
+  AssetMemoryUsage &operator+=(const AssetMemoryUsage &other) {
+    gpu_bytes += other.gpu_bytes;
+    cpu_bytes += other.cpu_bytes;
+    return *this;
+  }
+
+  /// @brief Memory owned by the graphics driver: textures, buffers.
+  size_t gpu_bytes;
+  /// @brief Memory owned by the asset itself, including data that is loaded
+  /// but not yet finalized.
+  size_t cpu_bytes;
+};
 
 /// @class Asset
 /// @brief Base class of all assets that _may_ be managed by Assetmanager.
 class Asset {
  public:
-  Asset() : refcount_(1) {}
+  Asset() : refcount_(1), handle_count_(0), last_used_(0) {}
   virtual ~Asset() {}
 
   /// @brief indicate there is an additional owner of this asset.
@@ -36,15 +61,79 @@ class Asset {
   /// asset deleted by the last one.
   void IncreaseRefCount() { refcount_++; }
 
+  /// @brief The number of AssetHandles that refer to this asset.
+  int handle_count() const { return handle_count_; }
+
+  /// @brief Estimates how much memory this asset uses.
+  ///
+  /// Reported by AssetManager::LogMemoryUsage(), and counted against the
+  /// AssetManager's memory budgets.
+  virtual AssetMemoryUsage MemoryUsage() const {
+    return AssetMemoryUsage(0, sizeof(*this));
+  }
+
  private:
   // This is private, since only the AssetManager can delete assets.
   friend class AssetManager;
+  template <typename T>
+  friend class AssetHandle;
   int DecreaseRefCount() {
     assert(refcount_ > 0);
     return --refcount_;
   };
 
   int refcount_;
+  std::atomic<int> handle_count_;
+  // When the AssetManager last handed this asset out, for LRU eviction.
+  // Atomic, since Find*() may be called on any thread.
+  std::atomic<uint64_t> last_used_;
+};
+
+/// @class AssetHandle
+/// @brief A counted reference to an asset.
+///
+/// Assets of a type that has a memory budget in the AssetManager (see
+/// AssetManager::SetMemoryBudget) may be evicted once nothing refers to them.
+/// An AssetHandle keeps its asset loaded for as long as the handle exists:
+///
+///     AssetHandle<Mesh> mesh = asset_manager.LoadMesh("tree.fplmesh");
+///
+/// Without a budget, assets are never evicted, and handles are optional.
+template <typename T>
+class AssetHandle {
+ public:
+  AssetHandle() : asset_(nullptr) {}
+  AssetHandle(T *asset) : asset_(asset) { Acquire(); }
+  AssetHandle(const AssetHandle &other) : asset_(other.asset_) { Acquire(); }
+  AssetHandle(AssetHandle &&other) : asset_(other.asset_) {
+    other.asset_ = nullptr;
+  }
+  ~AssetHandle() { Release(); }
+
+  AssetHandle &operator=(AssetHandle other) {
+    T *asset = asset_;
+    asset_ = other.asset_;
+    other.asset_ = asset;
+    return *this;
+  }
+
+  /// @brief Refers to `asset` instead, or to nothing.
+  void reset(T *asset = nullptr) { *this = AssetHandle(asset); }
+
+  T *get() const { return asset_; }
+  T *operator->() const { return asset_; }
+  T &operator*() const { return *asset_; }
+  explicit operator bool() const { return asset_ != nullptr; }
+
+ private:
+  void Acquire() {
+    if (asset_) asset_->handle_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void Release() {
+    if (asset_) asset_->handle_count_.fetch_sub(1, std::memory_order_release);
+  }
+
+  T *asset_;
 };
 
 }  // namespace fplbase
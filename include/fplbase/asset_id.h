@@ -0,0 +1,125 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ASSET_ID_H
+#define FPLBASE_ASSET_ID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_asset_manager
+/// @{
+
+namespace internal {
+
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+// 64-bit FNV-1a, in the recursive form C++11 allows in a constexpr function.
+constexpr uint64_t HashAssetNameConstexpr(const char *name, uint64_t hash) {
+  return *name ? HashAssetNameConstexpr(
+                     name + 1,
+                     (hash ^ static_cast<uint8_t>(*name)) * kFnvPrime)
+               : hash;
+}
+
+}  // namespace internal
+
+/// @brief Hashes an asset name, at runtime.
+///
+/// Gives the same result as AssetId's constexpr constructor.
+///
+/// @param name The asset name, usually a file name.
+/// @param length The length of `name`.
+/// @param hash The hash to continue from, to hash several pieces as one.
+/// @return Returns the hash of `name`.
+inline uint64_t HashAssetName(const char *name, size_t length,
+                              uint64_t hash = internal::kFnvOffsetBasis) {
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * internal::kFnvPrime;
+  }
+  return hash;
+}
+
+/// @class AssetId
+/// @brief Identifies an asset by a hash of its name.
+///
+/// Looking assets up by AssetId is cheaper than by name: it never builds a
+/// std::string, and compares a single integer. An AssetId built from a
+/// string literal is computed at compile time, e.g.
+///
+///     static constexpr AssetId kPlayerMesh("meshes/player.fplmesh");
+///     Mesh *mesh = asset_manager.FindMesh(kPlayerMesh);
+///
+/// Two names with the same 64-bit hash would share an id. The AssetManager
+/// checks for that in debug builds.
+class AssetId {
+ public:
+  /// @brief An id that no asset name maps to, in practice.
+  constexpr AssetId() : hash_(0) {}
+
+  /// @brief The id of `name`. Computed at compile time for literals.
+  constexpr explicit AssetId(const char *name)
+      : hash_(internal::HashAssetNameConstexpr(name,
+                                               internal::kFnvOffsetBasis)) {}
+
+  /// @brief The id of `name`.
+  explicit AssetId(const std::string &name)
+      : hash_(HashAssetName(name.c_str(), name.size())) {}
+
+  /// @brief The id of `name`, computed at runtime.
+  ///
+  /// Same as the constexpr constructor, but loops instead of recursing, which
+  /// is faster for names that aren't known at compile time.
+  static AssetId FromName(const char *name) {
+    uint64_t hash = internal::kFnvOffsetBasis;
+    for (; *name; ++name) {
+      hash = (hash ^ static_cast<uint8_t>(*name)) * internal::kFnvPrime;
+    }
+    return FromHash(hash);
+  }
+
+  /// @brief Makes an id from a hash returned by hash().
+  static constexpr AssetId FromHash(uint64_t hash) { return AssetId(hash, 0); }
+
+  /// @brief The hash of the name.
+  constexpr uint64_t hash() const { return hash_; }
+
+  constexpr bool operator==(AssetId other) const {
+    return hash_ == other.hash_;
+  }
+  constexpr bool operator!=(AssetId other) const {
+    return hash_ != other.hash_;
+  }
+  constexpr bool operator<(AssetId other) const { return hash_ < other.hash_; }
+
+ private:
+  constexpr AssetId(uint64_t hash, int) : hash_(hash) {}
+
+  uint64_t hash_;
+};
+
+/// @brief Hash function to use AssetId as a key of std::unordered_map.
+struct AssetIdHash {
+  size_t operator()(AssetId id) const { return static_cast<size_t>(id.hash()); }
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_ASSET_ID_H
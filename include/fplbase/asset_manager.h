@@ -15,15 +15,25 @@
 #ifndef FPLBASE_ASSET_MANAGER_H
 #define FPLBASE_ASSET_MANAGER_H
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/asset_id.h"
+#include "fplbase/async_completion.h"
 #include "fplbase/async_loader.h"
+#include "fplbase/file_watcher.h"
 #include "fplbase/fpl_common.h"
+#include "fplbase/read_mostly_mutex.h"
 #include "fplbase/renderer.h"
 #include "fplbase/texture_atlas.h"
+#include "fplbase/texture_cache.h"
+#include "fplutil/mutex.h"
 
 namespace fplbase {
 
@@ -37,10 +47,79 @@ class FileAsset : public AsyncAsset {
   virtual void Load();
   virtual bool Finalize();
   virtual bool IsValid();
+  virtual bool SupportsConcurrentLoad() const { return true; }
  public:
+  virtual AssetMemoryUsage MemoryUsage() const {
+    return AssetMemoryUsage(0, sizeof(*this) + contents.capacity());
+  }
+
   std::string contents;
 };
 
+/// @brief The kinds of assets the AssetManager holds.
+enum AssetType {
+  kAssetTypeShader,
+  kAssetTypeTexture,
+  kAssetTypeMaterial,
+  kAssetTypeMesh,
+  kAssetTypeTextureAtlas,
+  kAssetTypeFile,
+  kAssetTypeCount
+};
+
+/// @brief The memory used by one asset, see AssetManager::GetLargestAssets().
+struct AssetMemoryRecord {
+  AssetType type;
+  AssetId id;
+  /// @brief The name the asset was loaded with, if known. Materials and
+  /// texture atlases only remember their name in debug builds.
+  std::string name;
+  const Asset *asset;
+  AssetMemoryUsage usage;
+};
+
+/// @brief The memory budget of asset types that don't have one.
+const size_t kNoMemoryBudget = static_cast<size_t>(-1);
+
+/// @brief Makes AssetManager::PrefetchAssets() prefetch assets no matter
+/// when they were first used.
+const uint32_t kPrefetchAllFrames = static_cast<uint32_t>(-1);
+
+/// @brief What AssetManager::PrefetchAssets() did, see
+/// AssetManager::prefetch_stats().
+struct PrefetchStats {
+  PrefetchStats() : num_prefetched(0), num_requested(0), bytes_prefetched(0) {}
+
+  /// @brief The assets that were queued because a manifest listed them.
+  int num_prefetched;
+  /// @brief How many of those the app has asked for since. The rest were
+  /// prefetched for nothing, so far.
+  int num_requested;
+  /// @brief The file sizes the manifests listed for the prefetched assets.
+  size_t bytes_prefetched;
+};
+
+/// @brief How an AssetManager::LoadBatch() went, passed to its callback.
+struct BatchProgress {
+  BatchProgress()
+      : num_assets(0), num_loaded(0), num_failed(0), num_queued(0) {}
+
+  /// @brief The number of assets the batch listed.
+  int num_assets;
+  /// @brief How many of them loaded. A material counts once it and all its
+  /// textures loaded.
+  int num_loaded;
+  /// @brief How many of them failed to load, e.g. because a file is missing.
+  int num_failed;
+  /// @brief How many assets the batch queued, including the textures of
+  /// its materials. Assets that were loaded or queued before aren't counted.
+  int num_queued;
+};
+
+/// @brief Called once all assets of an AssetManager::LoadBatch() are
+/// finalized.
+typedef std::function<void(const BatchProgress &)> BatchCallback;
+
 /// @class AssetManager
 /// @brief Central place to own game assets loaded from disk.
 ///
@@ -50,6 +129,11 @@ class FileAsset : public AsyncAsset {
 ///
 /// Loading assets such as meshes will trigger the load of dependent assets
 /// such as textures.
+///
+/// The Find*() functions may be called on any thread, e.g. by jobs that
+/// look up meshes, even while the main thread loads and unloads assets.
+/// Everything else is for the main thread only. Assets found on another
+/// thread stay valid until the main thread unloads or evicts them.
 class AssetManager {
  public:
   /// @brief AssetManager constructor.
@@ -71,11 +155,21 @@ class AssetManager {
   /// @return Returns the shader, or nullptr if not previously loaded.
   Shader *FindShader(const char *basename);
 
+  /// @brief Returns a previously loaded shader, by id.
+  ///
+  /// Faster than looking up by name, in particular with an AssetId
+  /// computed at compile time.
+  ///
+  /// @param id The id of the name the shader was loaded with.
+  /// @return Returns the shader, or nullptr if not previously loaded.
+  Shader *FindShader(AssetId id);
+
   /// @brief Loads and returns a shader object.
   ///
   /// Loads a shader if it hasn't been loaded already, by appending .glslv
   /// and .glslf to the basename, compiling and linking them.
   /// If this returns nullptr, the error can be found in Renderer::last_error().
+  /// If not async, a shader that is still queued is loaded right away.
   ///
   /// @param basename The name of the shader.
   /// @param async A boolean to indicate whether to load asynchronously or not.
@@ -128,10 +222,21 @@ class AssetManager {
   /// @return Returns the texture, or nullptr if not previously loaded.
   Texture *FindTexture(const char *filename);
 
+  /// @brief Returns a previously loaded texture, by id.
+  ///
+  /// Faster than looking up by name, in particular with an AssetId
+  /// computed at compile time.
+  ///
+  /// @param id The id of the name the texture was loaded with.
+  /// @return Returns the texture, or nullptr if not previously loaded.
+  Texture *FindTexture(AssetId id);
+
   /// @brief Queue loading a texture if it hasn't been loaded already.
   ///
   /// If async, queues a texture for loading if it hasn't been loaded already,
-  /// otherwise loads it directly.
+  /// otherwise loads it directly. If not async, and the texture is already
+  /// queued or loading, it is loaded right away, or waited for, see
+  /// AsyncLoader::LoadJobNow().
   /// Currently only supports TGA/WebP format files.
   /// If async, the returned texture isn't usable until TryFinalize() succeeds
   /// and the id is non-zero.
@@ -145,12 +250,186 @@ class AssetManager {
                        TextureFlags flags = kTextureFlagsUseMipMaps |
                                             kTextureFlagsLoadAsync);
 
+  /// @brief Lets textures whose files are identical share one GPU texture.
+  ///
+  /// When enabled, textures loaded from then on hash their file (and the
+  /// format, flags and scale they are loaded with) after reading it. A
+  /// texture that matches one loaded earlier isn't decoded, and uses the GPU
+  /// texture of the earlier one, see Texture::original(). Use this when the
+  /// same image ships under several names.
+  ///
+  /// An async texture only shares with another async texture, and is
+  /// finalized after it. A texture loaded synchronously only shares with one
+  /// that is already finalized. The texture that is shared stays alive until
+  /// the textures using it are unloaded, even if it is unloaded itself.
+  ///
+  /// @param enable Whether to deduplicate textures. Off by default.
+  void SetTextureDeduplication(bool enable) { texture_deduplication_ = enable; }
+
+  /// @brief Whether SetTextureDeduplication() is enabled.
+  bool texture_deduplication() const { return texture_deduplication_; }
+
+  /// @brief Keeps decoded textures on disk, so that later runs read them
+  /// ready to upload instead of decoding them again.
+  ///
+  /// Applies to textures loaded from then on, see Texture::set_cache(). The
+  /// cache never shrinks: entries of files that changed are left behind, so
+  /// clear the directory when the app is updated. Main thread only.
+  ///
+  /// @param directory An existing, writable directory to keep the cache in,
+  /// or nullptr to stop caching.
+  void SetTextureCache(const char *directory);
+
+  /// @brief The cache set with SetTextureCache(), e.g. for its hit rate, or
+  /// nullptr.
+  TextureCache *texture_cache() const { return texture_cache_.get(); }
+
+  /// @brief Starts recording which assets the app loads, and when.
+  ///
+  /// Records every texture, mesh and shader (without local defines or
+  /// alias) the first time the app asks for it, in that order, together
+  /// with the frame, i.e. the number of TryFinalize() calls since recording
+  /// started. Save the recording with SaveLoadRecording(), and pass it to
+  /// PrefetchAssets() on later runs. Main thread only.
+  void StartRecordingLoads();
+
+  /// @brief Stops recording, but keeps what was recorded so far.
+  void StopRecordingLoads();
+
+  /// @brief Whether StartRecordingLoads() was called.
+  bool recording_loads() const { return recording_loads_; }
+
+  /// @brief Writes what was recorded to a prefetch manifest (see
+  /// schemas/prefetch_manifest.fbs).
+  ///
+  /// Looks up the size of every recorded file, so call this when loading
+  /// isn't time critical, e.g. on exit or from a debug menu.
+  ///
+  /// @param filename The file to write.
+  /// @return Returns false if the file couldn't be written.
+  bool SaveLoadRecording(const char *filename);
+
+  /// @brief Queues the assets listed in a prefetch manifest, in order.
+  ///
+  /// Use at startup, with the manifest of an earlier session, to load
+  /// assets in the background before the app asks for them. When the app
+  /// does, Load*() finds the asset already loaded or loading. If the app asks
+  /// asynchronously, a prefetched asset that is still queued is moved up to
+  /// kLoadPriorityNormal. If it asks synchronously, it is loaded right away,
+  /// or waited for, see AsyncLoader::LoadJobNow(). Assets that were already
+  /// loaded, or requested, are skipped. Loading starts with
+  /// StartLoadingTextures(), as usual.
+  ///
+  /// @param filename The prefetch manifest.
+  /// @param max_frame Only prefetch assets first used by this frame, e.g. to
+  ///        only load those needed for the first screen.
+  /// @param max_bytes Stop once the listed file sizes add up to more.
+  /// @param priority The priority to queue the assets with. The default
+  ///        makes the app's own requests go first.
+  /// @return Returns false if the manifest couldn't be read.
+  bool PrefetchAssets(const char *filename,
+                      uint32_t max_frame = kPrefetchAllFrames,
+                      size_t max_bytes = kNoMemoryBudget,
+                      LoadPriority priority = kLoadPriorityLow);
+
+  /// @brief How many assets PrefetchAssets() queued, and how many of them
+  /// were used.
+  PrefetchStats prefetch_stats();
+
+  /// @brief Loads the assets listed in a batch manifest, such as everything
+  /// a level needs, see schemas/asset_batch.fbs.
+  ///
+  /// Much cheaper than loading the assets one by one: all of them are
+  /// created first, and then the new ones are queued in one go, sorted by
+  /// where their files are stored (their offset in a mounted asset pack, or
+  /// else their path), so they're read sequentially. Everything loads
+  /// asynchronously, apart from the material files, whose textures are
+  /// queued with the rest. Assets that were loaded or queued before are used
+  /// as they are. Loading starts with StartLoadingTextures(), as usual.
+  ///
+  /// The batch keeps its assets loaded until its callback is called: they
+  /// aren't evicted, and unloading them only takes effect afterwards.
+  ///
+  /// @param filename The batch manifest.
+  /// @param callback Called once by TryFinalize(), when all assets are
+  ///        finalized, or right away if they already are.
+  /// @param priority The priority to queue the new assets with.
+  /// @return Returns false if the manifest couldn't be read, in which case
+  ///         `callback` is never called.
+  bool LoadBatch(const char *filename, const BatchCallback &callback,
+                 LoadPriority priority = kLoadPriorityNormal);
+
+  /// @brief Reloads assets when their files change on disk.
+  ///
+  /// While enabled, TryFinalize() checks which files were written, and
+  /// reloads the textures, shaders and materials loaded from them. Textures
+  /// and shaders are queued on the loader like any asynchronous load, and
+  /// keep being used as they were until finalized again. Their dependents
+  /// are reloaded too: all shaders that \#include a changed file, and the
+  /// textures that share a GPU texture with a changed one (see
+  /// SetTextureDeduplication()). Materials, meshes and atlases refer to their
+  /// textures, so they use reloaded textures as is. A changed material file
+  /// makes its material load its textures anew. Meshes aren't reloaded.
+  ///
+  /// Only the files assets were loaded with are watched, e.g. not the .ktx
+  /// file that replaces a .webp texture. Files are watched where the mounts
+  /// had them when they were first loaded (see ResolveMountedPath()), so
+  /// files read from a MountDirectory() mount are watched in that directory,
+  /// and files in asset packs or in memory aren't watched. Uses FileWatcher,
+  /// so only works on Linux. Main thread only.
+  ///
+  /// @param enable Whether to reload changed assets. Off by default.
+  /// @return Returns false if this isn't supported on this platform.
+  bool SetHotReload(bool enable);
+
+  /// @brief Whether SetHotReload() is enabled.
+  bool hot_reload() const { return file_watcher_ != nullptr; }
+
+  /// @brief Reloads the assets whose files changed.
+  ///
+  /// Called by TryFinalize() while SetHotReload() is enabled, so you don't
+  /// normally need to call this. Never waits for a file, or for the loader.
+  /// Assets that are still loading are reloaded once they are done.
+  ///
+  /// @return Returns the number of assets that were queued for reloading.
+  int ReloadChangedAssets();
+
   /// @brief Start loading all previously queued textures.
   ///
   /// LoadTextures doesn't actually load anything, this will start the async
   /// loading of all files, and decompression.
   void StartLoadingTextures();
 
+  /// @brief Change how urgently an asset that is queued for loading is loaded.
+  ///
+  /// Use this to load e.g. textures that are visible right now before others
+  /// that were requested earlier.
+  ///
+  /// @param asset A texture, mesh or shader returned by one of the Load*()
+  /// functions with async loading enabled.
+  /// @param priority The new priority.
+  /// @return Returns false if the asset is no longer queued.
+  bool SetLoadPriority(AsyncAsset *asset, LoadPriority priority) {
+    return loader_.SetJobPriority(asset, priority);
+  }
+
+  /// @brief Set the number of threads used to load assets asynchronously.
+  ///
+  /// Only assets whose loading is MT-safe (textures, meshes and file assets)
+  /// are spread over multiple threads. Must be called while not loading, i.e.
+  /// before StartLoadingTextures() or after StopLoadingTextures().
+  ///
+  /// Textures can additionally have their files read by separate I/O
+  /// threads, so that reading overlaps with decoding, see
+  /// AsyncLoader::SetNumIoWorkers().
+  ///
+  /// @param num_threads The number of loader threads. Defaults to 1.
+  /// @param num_io_threads The number of I/O threads. Defaults to 0.
+  void SetNumLoaderThreads(int num_threads, int num_io_threads = 0) {
+    loader_.SetNumWorkers(num_threads);
+    loader_.SetNumIoWorkers(num_io_threads);
+  }
+
   /// @brief Stop loading previously queued textures.
   ///
   /// This method will block until the currently loading textures have finished
@@ -168,6 +447,69 @@ class AssetManager {
   /// @return Returns true when all resources have been loaded & finalized.
   bool TryFinalize();
 
+  /// @brief Check for the status of async loading resources, within a budget.
+  ///
+  /// Like TryFinalize(), but only finalizes as many resources as fit in
+  /// `budget`, leaving the rest for the next call. Use this to avoid hitches
+  /// when many textures finish loading at the same time.
+  ///
+  /// @param budget How much time and how many bytes to spend per call.
+  /// @param status If not null, receives what was done, and what remains.
+  /// @return Returns true when all resources have been loaded & finalized.
+  bool TryFinalize(const FinalizeBudget &budget,
+                   FinalizeStatus *status = nullptr);
+
+  /// @brief Limits how much memory the assets of one type may use.
+  ///
+  /// When the assets of `type` use more than `bytes` of CPU and GPU memory
+  /// together (see Asset::MemoryUsage()), EvictUnusedAssets() deletes the
+  /// least recently used ones that are unused, until they fit. An asset is
+  /// unused when no AssetHandle refers to it, Asset::IncreaseRefCount() wasn't
+  /// called on it, and no other asset (such as a material using a texture)
+  /// depends on it. Assets that are still loading are never evicted. A
+  /// subsequent Load*() of an evicted asset loads it anew.
+  ///
+  /// So for types with a budget, hold on to the assets you use with an
+  /// AssetHandle. Pointers returned by Load*() and Find*() stay valid until
+  /// the next call to TryFinalize() or EvictUnusedAssets().
+  ///
+  /// Materials, atlases and shaders use next to no memory themselves. Give
+  /// them a budget of 0 to evict them as soon as they're unused, which in
+  /// turn makes their textures unused.
+  ///
+  /// @param type The type of asset to limit.
+  /// @param bytes The budget, or kNoMemoryBudget to never evict `type`.
+  void SetMemoryBudget(AssetType type, size_t bytes);
+
+  /// @brief The memory budget set by SetMemoryBudget().
+  size_t memory_budget(AssetType type) const { return memory_budgets_[type]; }
+
+  /// @brief Evicts unused assets of the types that are over their budget.
+  ///
+  /// Called by TryFinalize(), so you don't normally need to call this.
+  ///
+  /// @return Returns the number of bytes freed.
+  size_t EvictUnusedAssets();
+
+  /// @brief The memory used by all assets of one type.
+  ///
+  /// Textures used by materials, meshes and atlases are counted as textures
+  /// only.
+  ///
+  /// @param type The type of asset to add up.
+  /// @return Returns the sum of Asset::MemoryUsage() of the assets of `type`.
+  AssetMemoryUsage GetMemoryUsage(AssetType type);
+
+  /// @brief The assets that use the most memory.
+  ///
+  /// @param count The maximum number of assets to return.
+  /// @return Returns up to `count` assets of any type, largest first.
+  std::vector<AssetMemoryRecord> GetLargestAssets(size_t count);
+
+  /// @brief Logs the memory used by each type of asset, and the `count`
+  /// largest assets.
+  void LogMemoryUsage(size_t count);
+
   /// @brief Deletes the previously loaded texture.
   ///
   /// Deletes the texture and removes it from the material manager. Any
@@ -184,6 +526,15 @@ class AssetManager {
   /// @return Returns the material, or nullptr if not previously loaded.
   Material *FindMaterial(const char *filename);
 
+  /// @brief Returns a previously loaded material, by id.
+  ///
+  /// Faster than looking up by name, in particular with an AssetId
+  /// computed at compile time.
+  ///
+  /// @param id The id of the name the material was loaded with.
+  /// @return Returns the material, or nullptr if not previously loaded.
+  Material *FindMaterial(AssetId id);
+
   /// @brief Loads and returns a material object.
   ///
   /// Loads a material, which is a compiled FlatBuffer file with
@@ -211,10 +562,24 @@ class AssetManager {
   /// @return Returns the mesh, or nullptr if not previously loaded.
   Mesh *FindMesh(const char *filename);
 
+  /// @brief Returns a previously loaded mesh, by id.
+  ///
+  /// Faster than looking up by name, in particular with an AssetId
+  /// computed at compile time.
+  ///
+  /// @param id The id of the name the mesh was loaded with.
+  /// @return Returns the mesh, or nullptr if not previously loaded.
+  Mesh *FindMesh(AssetId id);
+
   /// @brief Loads and returns a mesh object.
   ///
   /// Loads a mesh, which is a compiled FlatBuffer file with root Mesh.
   /// If this returns nullptr, the error can be found in Renderer::last_error().
+  /// When loading asynchronously, the materials of the mesh are loaded as
+  /// soon as the mesh file is, so their textures load in parallel with the
+  /// mesh. The mesh is only finalized once its textures are.
+  /// Loading synchronously a mesh that is still being loaded asynchronously
+  /// finishes that load, see AsyncLoader::LoadJobNow().
   ///
   /// @param filename The name of the mesh.
   /// @return
@@ -236,6 +601,15 @@ class AssetManager {
   /// @return Pointer to the texture atlas if found, nullptr otherwise.
   TextureAtlas *FindTextureAtlas(const char *filename);
 
+  /// @brief Returns a previously loaded texture atlas, by id.
+  ///
+  /// Faster than looking up by name, in particular with an AssetId
+  /// computed at compile time.
+  ///
+  /// @param id The id of the name the texture atlas was loaded with.
+  /// @return Returns the texture atlas, or nullptr if not previously loaded.
+  TextureAtlas *FindTextureAtlas(AssetId id);
+
   /// @brief Loads a texture atlas.
   ///
   /// Loads a texture atlas, which is a compiled FlatBuffer file containing a
@@ -267,6 +641,15 @@ class AssetManager {
   /// @return Pointer to the file asset if found, nullptr otherwise.
   FileAsset *FindFileAsset(const char *filename);
 
+  /// @brief Returns a previously loaded file asset, by id.
+  ///
+  /// Faster than looking up by name, in particular with an AssetId
+  /// computed at compile time.
+  ///
+  /// @param id The id of the name the file asset was loaded with.
+  /// @return Returns the file asset, or nullptr if not previously loaded.
+  FileAsset *FindFileAsset(AssetId id);
+
   /// @brief Loads a file asset.
   ///
   /// @return nullptr on error.
@@ -287,6 +670,17 @@ class AssetManager {
   /// @return Returns the renderer.
   const Renderer &renderer() const { return renderer_; }
 
+  /// @brief Accessor for the loader of async assets, e.g. to record load
+  /// telemetry with AsyncLoader::SetTelemetryEnabled().
+  ///
+  /// @return Returns the loader.
+  AsyncLoader &loader() { return loader_; }
+
+  /// @brief Accessor for the loader of async assets.
+  ///
+  /// @return Returns the loader.
+  const AsyncLoader &loader() const { return loader_; }
+
   /// @brief Removes and destructs all assets held by the AssetManager.
   ///
   /// Will be called automatically by the destructor, but can also be called
@@ -318,15 +712,115 @@ class AssetManager {
                            const char *alias, bool async);
   FPL_DISALLOW_COPY_AND_ASSIGN(AssetManager);
 
+  template <typename T>
+  using AssetMap = std::unordered_map<AssetId, T *, AssetIdHash>;
+
+  // Deletes the least recently used assets in `asset_map` for which
+  // `can_evict` returns true, until the rest use at most `budget` bytes.
+  template <typename T>
+  size_t EvictLeastRecentlyUsed(AssetMap<T> &asset_map, size_t budget,
+                                const std::function<bool(T *)> &can_evict,
+                                const std::function<void(T *)> &destroy);
+
+  // Adds the memory used by each asset in `asset_map` to `records`.
+  template <typename T>
+  void GetMemoryRecords(const AssetMap<T> &asset_map, AssetType type,
+                        std::vector<AssetMemoryRecord> *records);
+
+  // The function set with Texture::set_dedup_fn(). Returns the texture that
+  // `tex` should share, or `tex` itself if none. Called on loader threads.
+  Texture *ShareTexture(uint64_t content_hash, Texture *tex);
+
+  // Deletes `tex`, which is no longer in texture_map_, unless other textures
+  // share it. Also deletes the texture `tex` shares, if it was unloaded and
+  // `tex` was the last one to share it.
+  void DestroyTexture(Texture *tex);
+
+  // Whether `tex` has to stay alive, since other textures share it.
+  bool IsTextureShared(Texture *tex);
+
+  // Called by Load*() whenever the app asks for an asset, for
+  // StartRecordingLoads() and PrefetchAssets(). `created` says whether the
+  // asset was created for this request.
+  void NoteRequest(AssetType type, const char *name, AsyncAsset *asset,
+                   bool created, TextureFormat format = kFormatAuto,
+                   TextureFlags flags = kTextureFlagsNone);
+
+  // LoadTexture(), except that a texture requested async earlier, but needed
+  // now, is added to `load_now` instead of being loaded. Callers holding
+  // material_mutex_ load those once they've released it, since loader threads
+  // loading meshes may need it meanwhile.
+  Texture *LoadTexture(const char *filename, TextureFormat format,
+                       TextureFlags flags, std::vector<Texture *> *load_now);
+
+  // Makes ReloadChangedAssets() reload the asset `id` of `type` when `file`
+  // changes where the mounts have it. Call with material_mutex_ locked.
+  void WatchFile(const std::string &file, AssetType type, AssetId id);
+
+  // Reloads `tex`, and the textures sharing its GPU texture, since reloading
+  // replaces it. Returns false if any of them is still loading.
+  bool ReloadTexture(Texture *tex);
+
+  // Reloads the definition of `mat` from `filename`, and loads its
+  // textures.
+  void ReloadMaterial(Material *mat, const char *filename);
+
+  // Deletes the PendingBatches whose callbacks were called, and unloads their
+  // assets once, for the refcount LoadBatch() added.
+  void ForgetFinishedBatches();
+
+  // Marks `asset` as used this frame, for EvictLeastRecentlyUsed(). Only
+  // writes to it once per frame, so threads finding the same assets don't
+  // contend for its cache line.
+  template <typename T>
+  T *Touch(T *asset) {
+    if (asset) {
+      const uint64_t now = use_clock_.load(std::memory_order_relaxed);
+      if (asset->last_used_.load(std::memory_order_relaxed) != now) {
+        asset->last_used_.store(now, std::memory_order_relaxed);
+      }
+    }
+    return asset;
+  }
+
+  // Looks up `id` in `asset_map`, for the Find*() functions.
+  template <typename T>
+  T *FindAsset(const AssetMap<T> &asset_map, AssetId id) {
+    ReadMostlyMutex::ReadLock lock(map_mutex_);
+    auto it = asset_map.find(id);
+    return Touch(it != asset_map.end() ? it->second : nullptr);
+  }
+
+  // Adds `asset` to `asset_map`, or removes it, while other threads may be
+  // finding assets in it.
+  template <typename T>
+  void InsertAsset(AssetMap<T> &asset_map, AssetId id, T *asset) {
+    ReadMostlyMutex::WriteLock lock(map_mutex_);
+    asset_map[id] = Touch(asset);
+  }
+  template <typename T>
+  void EraseAsset(AssetMap<T> &asset_map, AssetId id) {
+    ReadMostlyMutex::WriteLock lock(map_mutex_);
+    asset_map.erase(id);
+  }
+
+  // The id an asset named `name` is stored under. In debug builds, also
+  // checks that no other name hashes to the same id.
+  AssetId IdOf(const char *name);
+
   // This implements the mechanism for each asset to be both loadable
   // sync or async.
   // It gets passed a blank asset that we take ownership of, and the map it
   // should go into if all succeeds.
   template <typename T>
-  T *LoadOrQueue(T *asset, std::map<std::string, T *> &asset_map, bool async,
+  T *LoadOrQueue(T *asset, AssetMap<T> &asset_map, bool async,
                  const char *alias) {
-    asset_map[alias != nullptr ? alias : asset->filename()] = asset;
-    if (async) {
+    InsertAsset(asset_map,
+                IdOf(alias != nullptr ? alias : asset->filename().c_str()),
+                asset);
+    if (async && batch_) {
+      batch_->push_back(asset);
+    } else if (async) {
       loader_.QueueJob(asset);
     } else {
       asset->LoadNow();
@@ -335,15 +829,111 @@ class AssetManager {
   }
 
   Renderer &renderer_;
-  std::map<std::string, Shader *> shader_map_;
-  std::map<std::string, Texture *> texture_map_;
-  std::map<std::string, TextureAtlas *> texture_atlas_map_;
-  std::map<std::string, Material *> material_map_;
-  std::map<std::string, Mesh *> mesh_map_;
-  std::map<std::string, FileAsset *> file_map_;
+  // Meshes that load asynchronously create their materials and textures on a
+  // loader thread, so texture_map_ and material_map_ are protected by this.
+  // Recursive, since loading a material loads its textures.
+  fplutil::Mutex material_mutex_;
+  // Find*() may be called on any thread, so all maps below are changed with
+  // this locked for writing. Lock it after material_mutex_, and only around
+  // the change itself: it isn't recursive.
+  ReadMostlyMutex map_mutex_;
+  AssetMap<Shader> shader_map_;
+  AssetMap<Texture> texture_map_;
+  AssetMap<TextureAtlas> texture_atlas_map_;
+  AssetMap<Material> material_map_;
+  AssetMap<Mesh> mesh_map_;
+  AssetMap<FileAsset> file_map_;
+#ifndef NDEBUG
+  // Names of all ids handed out by IdOf(), to catch hash collisions.
+  // Protected by material_mutex_.
+  std::unordered_map<AssetId, std::string, AssetIdHash> asset_names_;
+#endif
   AsyncLoader loader_;
   mathfu::vec2 texture_scale_;
 
+  // Textures that take part in deduplication, see SetTextureDeduplication().
+  struct TextureSharing {
+    uint64_t content_hash;
+    // The texture this one shares, or nullptr if it is an original.
+    Texture *original;
+    // The number of textures that share this one.
+    int num_sharers;
+    // Whether this one was unloaded, and only lives on for its sharers.
+    bool unloaded;
+  };
+  bool texture_deduplication_;
+  // See SetTextureCache(). Guarded by material_mutex_.
+  std::shared_ptr<TextureCache> texture_cache_;
+  // Separate from material_mutex_, since ShareTexture() runs on loader
+  // threads that the main thread may be waiting for in LoadTexture().
+  fplutil::Mutex texture_sharing_mutex_;
+  std::unordered_map<uint64_t, Texture *> texture_contents_;
+  std::unordered_map<Texture *, TextureSharing> texture_sharing_;
+
+  // An asset requested while recording, see StartRecordingLoads().
+  struct RecordedLoad {
+    AssetType type;
+    std::string name;
+    TextureFormat format;
+    TextureFlags flags;
+    uint32_t frame;
+  };
+  // The number of TryFinalize() calls so far.
+  uint32_t num_frames_;
+  bool recording_loads_;
+  uint32_t recording_start_frame_;
+  // The rest are protected by material_mutex_, since textures may be
+  // requested on a loader thread.
+  std::vector<RecordedLoad> recorded_loads_;
+  std::unordered_set<AssetId, AssetIdHash> recorded_ids_;
+  // Assets PrefetchAssets() queued that the app hasn't asked for yet.
+  // With the priority they were prefetched with.
+  std::unordered_map<AssetId, LoadPriority, AssetIdHash> prefetched_ids_;
+  // Set while PrefetchAssets() loads assets, which aren't app requests.
+  bool prefetching_;
+  PrefetchStats prefetch_stats_;
+
+  // Set while SetHotReload() is enabled. The rest are protected by
+  // material_mutex_, since textures may be loaded on a loader thread.
+  std::unique_ptr<FileWatcher> file_watcher_;
+  typedef std::pair<AssetType, AssetId> AssetKey;
+  // The assets loaded from each watched file, by the name they were loaded
+  // with.
+  std::unordered_map<std::string, std::vector<AssetKey>> watched_files_;
+  // The name of each watched file, by the path the FileWatcher watches.
+  std::unordered_map<std::string, std::string> watched_paths_;
+  // Shaders whose files are only known once they are finalized.
+  std::vector<AssetId> unwatched_shaders_;
+  // Textures and shaders whose files changed, but that were still loading.
+  std::vector<AssetKey> pending_reloads_;
+
+  // A LoadBatch() whose assets are still loading.
+  struct PendingBatch : public FinalizeListener {
+    PendingBatch() : done(false) {}
+    virtual void OnFinalized();
+    // The listed assets, apart from materials that failed to load.
+    std::vector<AsyncAsset *> assets;
+    std::vector<Material *> materials;
+    // The type and name of each asset whose refcount LoadBatch() increased.
+    std::vector<std::pair<AssetType, std::string>> pinned;
+    std::unique_ptr<WhenAll> group;
+    BatchProgress progress;
+    BatchCallback callback;
+    // Set once `callback` was called. Deleted by TryFinalize(), since the
+    // group is still notifying its listeners meanwhile.
+    bool done;
+  };
+  std::vector<std::unique_ptr<PendingBatch>> pending_batches_;
+  // Set by LoadBatch(), with material_mutex_ locked, while it creates the
+  // assets: LoadOrQueue() collects the new async assets in it, instead of
+  // queueing them.
+  std::vector<AsyncAsset *> *batch_;
+
+  size_t memory_budgets_[kAssetTypeCount];
+  bool has_memory_budget_;
+  // Advanced every frame, by TryFinalize().
+  std::atomic<uint64_t> use_clock_;
+
   std::vector<std::string> defines_to_add_;
   std::vector<std::string> defines_to_omit_;
 };
@@ -0,0 +1,150 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ASSET_PACK_H
+#define FPLBASE_ASSET_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace packdef {
+struct AssetPack;
+}
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_asset_pack
+/// @{
+
+/// @brief The first bytes of every pack file.
+const char kAssetPackMagic[4] = {'F', 'P', 'L', 'P'};
+/// @brief The size of the header before the table of contents.
+const size_t kAssetPackHeaderSize = 8;
+/// @brief The contents of pack entries start at multiples of this.
+const size_t kAssetPackAlignment = 16;
+
+/// @class AssetPack
+/// @brief A file holding many assets, see schemas/asset_pack.fbs.
+///
+/// The pack file is mapped into memory, so opening it only reads its table of
+/// contents, and entries can be used in place without copying them.
+/// Opening one file instead of thousands of small ones also saves a lot of
+/// time on platforms where opening files is slow.
+///
+/// Use MountAssetPack() to have LoadFile() read from a pack.
+class AssetPack {
+ public:
+  AssetPack();
+  ~AssetPack();
+
+  /// @brief Maps a pack file into memory.
+  ///
+  /// @param filename The pack file, e.g. as written by asset_packer.
+  /// @return Returns false if the file can't be read or isn't a pack file.
+  bool Open(const char *filename);
+
+  /// @brief Unmaps the pack file. Invalidates all pointers into it.
+  void Close();
+
+  /// @brief Whether Open() succeeded.
+  bool IsOpen() const { return toc_ != nullptr; }
+
+  /// @brief Finds an entry, without copying it.
+  ///
+  /// @param name The name of the entry, as it was packed.
+  /// @param size If not null, receives the size of the entry.
+  /// @return Returns the contents of the entry, which stay valid until the
+  /// pack is closed, or nullptr if there's no such entry.
+  const uint8_t *FindEntry(const char *name, size_t *size) const;
+
+  /// @brief Copies an entry into `dest`.
+  ///
+  /// @return Returns false if there's no such entry.
+  bool LoadEntry(const char *name, std::string *dest) const;
+
+  /// @brief The number of entries in the pack.
+  size_t num_entries() const;
+
+  /// @brief The name of the pack file.
+  const std::string &filename() const { return filename_; }
+
+  /// @brief Writes a pack file.
+  ///
+  /// @param filename The file to write.
+  /// @param entries The name and contents of each entry. Names must be unique.
+  /// @return Returns false if the file couldn't be written.
+  static bool Save(
+      const char *filename,
+      const std::vector<std::pair<std::string, std::string>> &entries);
+
+ private:
+  std::string filename_;
+  // The whole file, either mapped, or in contents_ where mapping files is
+  // unsupported.
+  const void *mapped_;
+  int32_t mapped_size_;
+  std::string contents_;
+  const packdef::AssetPack *toc_;
+  const uint8_t *data_;
+  size_t data_size_;
+
+  AssetPack(const AssetPack &);
+  AssetPack &operator=(const AssetPack &);
+};
+
+/// @brief Makes LoadFile() read from a pack file.
+///
+/// Packs are one kind of mount, see fplbase/file_system.h: files found in a
+/// mounted pack are read from it, unless a mount that was added later has
+/// them too. May be called from any thread.
+///
+/// @param filename The pack file.
+/// @return Returns false if the pack couldn't be opened.
+bool MountAssetPack(const char *filename);
+
+/// @brief Stops LoadFile() from reading from a pack file.
+///
+/// Loads already reading from the pack finish first.
+///
+/// @param filename The pack file, as passed to MountAssetPack().
+/// @return Returns false if the pack wasn't mounted.
+bool UnmountAssetPack(const char *filename);
+
+/// @brief Reads a file from the mounted packs.
+///
+/// LoadFile() calls this, so there's usually no need to.
+///
+/// @return Returns false if no mounted pack has the file.
+bool LoadFileFromAssetPacks(const char *filename, std::string *dest);
+
+/// @brief Finds a file in the mounted packs, without copying it.
+///
+/// @param filename The name of the file.
+/// @param size Receives the size of the file.
+/// @param pack Receives the pack holding the file, which keeps the returned
+/// pointer valid even if the pack is unmounted meanwhile.
+/// @return Returns the contents of the file, or nullptr if no mounted pack has
+/// it.
+const uint8_t *FindInAssetPacks(const char *filename, size_t *size,
+                                std::shared_ptr<const AssetPack> *pack);
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_ASSET_PACK_H
@@ -0,0 +1,173 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ASYNC_COMPLETION_H
+#define FPLBASE_ASYNC_COMPLETION_H
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+#include "fplbase/async_loader.h"
+
+#ifdef FPLBASE_ENABLE_COROUTINES
+#include <coroutine>
+#endif
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_async_loader
+/// @{
+
+/// @class FinalizeFunction
+/// @brief A FinalizeListener that calls a function object.
+///
+/// The function object is stored in the listener itself, so unlike
+/// AsyncAsset::AddFinalizeCallback(), this never allocates. Use
+/// MakeFinalizeFunction() to create one from a lambda.
+template <typename Function>
+class FinalizeFunction : public FinalizeListener {
+ public:
+  explicit FinalizeFunction(const Function &function) : function_(function) {}
+  virtual void OnFinalized() { function_(); }
+
+ private:
+  Function function_;
+};
+
+/// @brief Wraps `function` in a FinalizeFunction.
+template <typename Function>
+FinalizeFunction<Function> MakeFinalizeFunction(const Function &function) {
+  return FinalizeFunction<Function>(function);
+}
+
+/// @class WhenAll
+/// @brief Waits for a group of assets to be finalized.
+///
+/// Listens to each of the assets with a FinalizeListener of its own, all
+/// allocated in one go, and notifies its own listeners once the last of them
+/// is finalized. Continuations added with Then() can in turn add listeners
+/// to other assets or groups, to chain loads. Main thread only.
+class WhenAll {
+ public:
+  /// @brief Starts waiting for `assets`.
+  ///
+  /// @param assets The assets to wait for. Must be distinct. Assets that are
+  /// already finalized don't need waiting for.
+  explicit WhenAll(const std::vector<AsyncAsset *> &assets);
+
+  /// @brief Starts waiting for `count` assets, starting at `assets`.
+  WhenAll(AsyncAsset *const *assets, size_t count);
+
+  /// @brief Stops waiting for the assets that weren't finalized yet. Listeners
+  /// added with Then() are not notified.
+  ~WhenAll();
+
+  /// @brief The number of assets that weren't finalized yet.
+  int num_pending() const { return num_pending_; }
+
+  /// @brief Whether all assets were finalized.
+  bool IsReady() const { return num_pending_ == 0; }
+
+  /// @brief Notifies `listener` once all assets are finalized.
+  ///
+  /// Listeners are notified in the order they were added. If all assets are
+  /// finalized already, `listener` is notified right away.
+  ///
+  /// @param listener The listener, owned by the caller.
+  void Then(FinalizeListener *listener);
+
+  /// @brief Stops waiting with `listener`.
+  ///
+  /// @return Returns false if `listener` wasn't waiting for this group.
+  bool RemoveListener(FinalizeListener *listener) {
+    return listeners_.Remove(listener);
+  }
+
+ private:
+  // Listens to one of the assets.
+  class AssetListener : public FinalizeListener {
+   public:
+    AssetListener() : group(nullptr), asset(nullptr) {}
+    virtual void OnFinalized();
+    WhenAll *group;
+    // The asset, until it's finalized.
+    AsyncAsset *asset;
+  };
+
+  void Init(AsyncAsset *const *assets, size_t count);
+
+  std::unique_ptr<AssetListener[]> asset_listeners_;
+  size_t num_assets_;
+  int num_pending_;
+  FinalizeListenerList listeners_;
+
+  WhenAll(const WhenAll &);
+  WhenAll &operator=(const WhenAll &);
+};
+
+#ifdef FPLBASE_ENABLE_COROUTINES
+/// @class FinalizeAwaiter
+/// @brief Lets a C++20 coroutine `co_await` an asset, or a WhenAll.
+///
+/// Resumes the coroutine on the main thread, from inside
+/// AsyncLoader::TryFinalize(), once the asset or group is finalized. The
+/// awaiter lives in the coroutine frame, so waiting doesn't allocate.
+/// Requires building with FPLBASE_ENABLE_COROUTINES, see the
+/// fplbase_enable_coroutines CMake option.
+class FinalizeAwaiter : public FinalizeListener {
+ public:
+  explicit FinalizeAwaiter(AsyncAsset *asset)
+      : asset_(asset), group_(nullptr) {}
+  explicit FinalizeAwaiter(WhenAll *group) : asset_(nullptr), group_(group) {}
+
+  bool await_ready() const {
+    return asset_ ? asset_->IsFinalized() : group_->IsReady();
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    if (asset_) return asset_->AddFinalizeListener(this);
+    if (group_->IsReady()) return false;
+    group_->Then(this);
+    return true;
+  }
+
+  void await_resume() const {}
+
+  virtual void OnFinalized() { handle_.resume(); }
+
+ private:
+  AsyncAsset *asset_;
+  WhenAll *group_;
+  std::coroutine_handle<> handle_;
+};
+
+/// @brief `co_await Finalized(asset)` suspends until `asset` is finalized.
+inline FinalizeAwaiter Finalized(AsyncAsset *asset) {
+  return FinalizeAwaiter(asset);
+}
+
+/// @brief `co_await Finalized(&group)` suspends until all assets in `group`
+/// are finalized.
+inline FinalizeAwaiter Finalized(WhenAll *group) {
+  return FinalizeAwaiter(group);
+}
+#endif  // FPLBASE_ENABLE_COROUTINES
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_ASYNC_COMPLETION_H
@@ -16,8 +16,12 @@
 #define FPLBASE_ASYNC_LOADER_H
 
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <functional>
+#include <list>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,9 +43,225 @@ namespace fplbase {
 typedef void *Thread;
 typedef void *Mutex;
 typedef void *Semaphore;
+typedef void *ConditionVariable;
 
 class AsyncLoader;
 
+/// @brief How urgently a queued asset should be loaded.
+///
+/// The loader always starts loading the highest priority job it can find, so
+/// a kLoadPriorityHighest job only waits for the jobs that are already being
+/// loaded. Jobs with the same priority are loaded in the order they were
+/// queued.
+enum LoadPriority {
+  kLoadPriorityLowest = 0,
+  kLoadPriorityLow,
+  kLoadPriorityNormal,  ///< @brief The default priority.
+  kLoadPriorityHigh,
+  kLoadPriorityHighest,
+  kLoadPriorityCount  // Must be at end.
+};
+
+/// @brief Limits how much work a single AsyncLoader::TryFinalize() call does.
+///
+/// Finalizing an asset usually means uploading it to the GPU, which can
+/// take a significant part of a frame. Pass a budget to spread the finalizing
+/// of many assets that finished loading together over multiple frames.
+struct FinalizeBudget {
+  /// @brief The default budget has no limits, i.e. finalizes everything.
+  FinalizeBudget() : max_seconds(0.0), max_bytes(0) {}
+
+  /// @brief Construct a budget with the given limits.
+  /// @param seconds Value for max_seconds.
+  /// @param bytes Value for max_bytes.
+  FinalizeBudget(double seconds, size_t bytes)
+      : max_seconds(seconds), max_bytes(bytes) {}
+
+  /// @brief Stop finalizing once this much time has been spent. Assets whose
+  /// predicted finalize time doesn't fit in what remains are skipped.
+  /// 0 means no limit.
+  double max_seconds;
+
+  /// @brief Only finalize assets while the sum of their
+  /// AsyncAsset::EstimateFinalizeCost() stays within this. 0 means no limit.
+  size_t max_bytes;
+};
+
+/// @brief What a call to AsyncLoader::TryFinalize() did, and what remains.
+struct FinalizeStatus {
+  FinalizeStatus()
+      : num_finalized(0),
+        bytes_finalized(0),
+        seconds(0.0),
+        num_ready(0),
+        bytes_ready(0),
+        num_pending(0) {}
+
+  /// @brief The number of assets finalized by this call.
+  int num_finalized;
+  /// @brief The estimated cost of the assets finalized by this call.
+  size_t bytes_finalized;
+  /// @brief The time spent finalizing, in seconds.
+  double seconds;
+  /// @brief The number of assets that are loaded, and waiting to be finalized.
+  int num_ready;
+  /// @brief The estimated cost of finalizing the num_ready assets.
+  size_t bytes_ready;
+  /// @brief The number of assets that are queued, loading, or waiting to be
+  /// finalized.
+  int num_pending;
+};
+
+/// @brief When, and how much, a single asset was loaded.
+///
+/// Recorded by the AsyncLoader for every asset it finalizes while telemetry
+/// is enabled, see AsyncLoader::SetTelemetryEnabled(). Times are in seconds
+/// since the AsyncLoader was created, and are 0 for steps the asset didn't go
+/// through.
+struct AssetLoadRecord {
+  AssetLoadRecord()
+      : priority(kLoadPriorityNormal),
+        queued(0.0),
+        load_start(0.0),
+        read_end(0.0),
+        decode_start(0.0),
+        load_end(0.0),
+        finalize_start(0.0),
+        finalize_end(0.0),
+        bytes_read(0),
+        decoded_bytes(0) {}
+
+  /// @brief The file the asset was loaded from.
+  std::string filename;
+  /// @brief The priority the asset had when a worker started loading it.
+  LoadPriority priority;
+  /// @brief When the asset was queued.
+  double queued;
+  /// @brief When a worker started loading, or reading, the asset.
+  double load_start;
+  /// @brief When the asset's file data was read. Only for assets that
+  /// AsyncAsset::SupportsStagedLoad().
+  double read_end;
+  /// @brief When a worker started decoding the file data. Only for assets
+  /// that AsyncAsset::SupportsStagedLoad().
+  double decode_start;
+  /// @brief When loading, or decoding, was done.
+  double load_end;
+  /// @brief When AsyncAsset::Finalize() was called.
+  double finalize_start;
+  /// @brief When AsyncAsset::Finalize() returned.
+  double finalize_end;
+  /// @brief AsyncAsset::FileDataSize() once the file data was read. 0 for
+  /// assets that don't AsyncAsset::SupportsStagedLoad().
+  size_t bytes_read;
+  /// @brief AsyncAsset::EstimateFinalizeCost() once loading was done.
+  size_t decoded_bytes;
+};
+
+/// @brief How many assets were at each stage of loading, at some point.
+///
+/// Recorded by AsyncLoader::TryFinalize() while telemetry is enabled, but only
+/// when the numbers changed since the previous sample. The assets that are
+/// being loaded, or wait for their dependencies, make up the difference
+/// between num_pending and the other counts.
+struct QueueDepthSample {
+  QueueDepthSample()
+      : time(0.0), num_queued(0), num_staged(0), num_ready(0), num_pending(0) {}
+
+  /// @brief Seconds since the AsyncLoader was created.
+  double time;
+  /// @brief Assets waiting for a worker, or an I/O worker, to load them.
+  int num_queued;
+  /// @brief Assets whose file data was read, waiting to be decoded.
+  int num_staged;
+  /// @brief Assets waiting to be finalized.
+  int num_ready;
+  /// @brief Assets that are queued, loading, or waiting to be finalized.
+  int num_pending;
+};
+
+/// @brief How useful the read-ahead hints of an AsyncLoader were.
+///
+/// See AsyncLoader::SetReadAheadDepth(). A job counts as loaded when a worker
+/// starts reading its file.
+struct ReadAheadStats {
+  ReadAheadStats()
+      : num_hints(0),
+        num_failed_hints(0),
+        num_hinted_loads(0),
+        num_unhinted_loads(0),
+        num_wasted_hints(0),
+        total_lead_seconds(0.0) {}
+
+  /// @brief The number of queued jobs whose file was read ahead.
+  int num_hints;
+  /// @brief Of num_hints, the files that couldn't be read ahead, see
+  /// ReadAheadFile().
+  int num_failed_hints;
+  /// @brief Jobs loaded after their file was read ahead.
+  int num_hinted_loads;
+  /// @brief Jobs loaded before a worker got to read their file ahead, e.g.
+  /// because they were queued with a high priority, or the read-ahead depth
+  /// is too small to keep up with the workers.
+  int num_unhinted_loads;
+  /// @brief Jobs whose file was read ahead, but that were aborted before
+  /// being loaded.
+  int num_wasted_hints;
+  /// @brief The time between reading the file ahead and loading it, summed
+  /// over num_hinted_loads, in seconds. When this is short on average, the
+  /// OS had little time to read the files, and a larger depth helps.
+  double total_lead_seconds;
+};
+
+/// @class FinalizeListener
+/// @brief Gets notified when an asset is finalized, without allocating.
+///
+/// An alternative to AsyncAsset::AddFinalizeCallback() for when many assets
+/// need a continuation. A listener is linked into the list of listeners of
+/// the asset it waits for, so adding it never allocates. Derive from this
+/// (or use FinalizeFunction, see async_completion.h), and pass it to
+/// AsyncAsset::AddFinalizeListener(). A listener waits for one thing at a
+/// time, and must stay alive until it's notified or removed.
+class FinalizeListener {
+ public:
+  FinalizeListener() : next_(nullptr) {}
+  virtual ~FinalizeListener() {}
+
+  /// @brief Called on the main thread once what this listens to is done.
+  ///
+  /// May add or remove other listeners, and delete this one.
+  virtual void OnFinalized() = 0;
+
+ private:
+  FinalizeListener *next_;
+
+  friend class FinalizeListenerList;
+};
+
+/// @class FinalizeListenerList
+/// @brief An intrusive list of FinalizeListener, notified in the order they
+/// were added.
+class FinalizeListenerList {
+ public:
+  FinalizeListenerList() : head_(nullptr), tail_(nullptr) {}
+
+  /// @brief Appends `listener`, which must not be in any list.
+  void Add(FinalizeListener *listener);
+
+  /// @brief Takes `listener` out of the list.
+  ///
+  /// @return Returns false if `listener` wasn't in the list.
+  bool Remove(FinalizeListener *listener);
+
+  /// @brief Empties the list, and then calls FinalizeListener::OnFinalized()
+  /// on each listener that was in it.
+  void Notify();
+
+ private:
+  FinalizeListener *head_;
+  FinalizeListener *tail_;
+};
+
 /// @class AsyncResource
 /// @brief Any resource that can be loaded asynchronously should inherit from
 ///        this.
@@ -51,7 +271,20 @@ class AsyncAsset : public Asset {
   typedef std::function<void()> AssetFinalizedCallback;
 
   /// @brief Default constructor for an empty AsyncAsset.
-  AsyncAsset() : data_(nullptr), finalized_(false) {}
+  AsyncAsset()
+      : data_(nullptr),
+        finalized_(false),
+        loader_(nullptr),
+        load_priority_(kLoadPriorityNormal),
+        finalize_cost_(0),
+        loader_state_(kNotQueued),
+        loader_worker_(0),
+        load_cancelled_(false),
+        delete_when_loaded_(false),
+        staged_bytes_(0),
+        read_ahead_(false),
+        read_ahead_time_(0.0),
+        next_completed_(nullptr) {}
 
   /// @brief Construct an AsyncAsset with a given file name.
   /// @param[in] filename A C-string corresponding to the name of the asset
@@ -60,7 +293,18 @@ class AsyncAsset : public Asset {
       : filename_(filename),
         data_(nullptr),
         finalize_callbacks_(0),
-        finalized_(false) {}
+        finalized_(false),
+        loader_(nullptr),
+        load_priority_(kLoadPriorityNormal),
+        finalize_cost_(0),
+        loader_state_(kNotQueued),
+        loader_worker_(0),
+        load_cancelled_(false),
+        delete_when_loaded_(false),
+        staged_bytes_(0),
+        read_ahead_(false),
+        read_ahead_time_(0.0),
+        next_completed_(nullptr) {}
 
   /// @brief AsyncAsset destructor.
   virtual ~AsyncAsset() {}
@@ -68,12 +312,60 @@ class AsyncAsset : public Asset {
   /// @brief Override with the actual loading behavior.
   ///
   /// Load should perform the actual loading of filename_, and store the
-  /// result in data_, or nullptr upon failure. It is called on the loader
+  /// result in data_, or nullptr upon failure. It is called on a loader
   /// thread, so should not access any program state outside of this object.
-  /// Since there will be only one loader thread, any libraries called by Load
-  /// need not be MT-safe as long as they're not also called by the main thread.
+  /// Unless SupportsConcurrentLoad() returns true, Load is only ever called on
+  /// a single loader thread, so any libraries called by Load need not be
+  /// MT-safe as long as they're not also called by the main thread.
+  /// Long running implementations should poll IsLoadCancelled(), and return
+  /// early when it's true.
   virtual void Load() = 0;
 
+  /// @brief Override to allow Load() to run on any loader thread.
+  ///
+  /// When the AsyncLoader runs more than one worker, assets returning true
+  /// here may be loaded on any worker, at the same time as other assets.
+  /// Their Load() implementation, and any library it calls, must then be
+  /// MT-safe. Assets returning false (the default) are all loaded, one at a
+  /// time, on the first worker.
+  ///
+  /// @return Returns true if Load() may run concurrently with other loads.
+  virtual bool SupportsConcurrentLoad() const { return false; }
+
+  /// @brief Override to split Load() into an I/O and a decode stage.
+  ///
+  /// When the AsyncLoader has I/O workers (see AsyncLoader::SetNumIoWorkers),
+  /// assets returning true here are loaded by calling LoadFileData() on an
+  /// I/O worker, and then DecodeFileData() on a regular worker, instead of
+  /// calling Load(). That way reading one file overlaps with decoding
+  /// another. Without I/O workers, a regular worker calls both in a row.
+  /// Load() must still do both stages, for LoadNow(). Both stages may run on
+  /// any thread, so this requires SupportsConcurrentLoad().
+  ///
+  /// @return Returns true if LoadFileData() and DecodeFileData() are
+  /// implemented.
+  virtual bool SupportsStagedLoad() const { return false; }
+
+  /// @brief Override with the I/O stage of a staged load.
+  ///
+  /// Should read the file(s) needed to load filename_ into memory owned by
+  /// this asset, without doing any expensive processing.
+  virtual void LoadFileData() {}
+
+  /// @brief Override with the decode stage of a staged load.
+  ///
+  /// Should turn what LoadFileData() read into data_, like Load() does, and
+  /// free the file data.
+  virtual void DecodeFileData() {}
+
+  /// @brief Override to report how much memory LoadFileData() holds on to.
+  ///
+  /// Used to limit how much data is read ahead of decoding, see
+  /// AsyncLoader::SetMaxStagedBytes().
+  ///
+  /// @return Returns the size of the data read by LoadFileData().
+  virtual size_t FileDataSize() const { return 0; }
+
   /// @brief Override with converting the data into the resource.
   ///
   /// This should implement the behavior of turning data_ into the actual
@@ -81,6 +373,15 @@ class AsyncAsset : public Asset {
   /// Should check if data_ is null.
   virtual bool Finalize() = 0;
 
+  /// @brief Override to tell the loader how expensive Finalize() will be.
+  ///
+  /// Called on the loader thread right after Load(). The result is used to
+  /// fit finalizing into a FinalizeBudget, so it should be roughly the number
+  /// of bytes Finalize() hands to the GPU, e.g. the size of a decoded image.
+  ///
+  /// @return Returns the estimated cost. Defaults to 0, i.e. free.
+  virtual size_t EstimateFinalizeCost() const { return 0; }
+
   /// @brief Whether this object has been loaded and finalized. This does not
   /// signal success or not -- check IsValid for that.
   bool IsFinalized() const { return finalized_; }
@@ -113,6 +414,17 @@ class AsyncAsset : public Asset {
   /// @return Returns the filename.
   const std::string &filename() const { return filename_; }
 
+  /// @brief The priority this asset was last queued with.
+  ///
+  /// Change it with AsyncLoader::SetJobPriority().
+  LoadPriority load_priority() const { return load_priority_; }
+
+  /// @brief Whether the job loading this asset was aborted.
+  ///
+  /// Safe to call from Load(), on the loader thread. Once this returns true,
+  /// whatever Load() produces is thrown away, so it may as well stop.
+  bool IsLoadCancelled() const { return load_cancelled_; }
+
   /// @brief Adds a callback to be called when the asset is finalized.
   ///
   /// Add a callback so logic can be executed when an asset is done loading.
@@ -129,7 +441,45 @@ class AsyncAsset : public Asset {
     return true;
   }
 
+  /// @brief Adds a listener to be notified when the asset is finalized.
+  ///
+  /// Like AddFinalizeCallback(), but doesn't allocate. Listeners are notified
+  /// in the order they were added, after the finalize callbacks, and once
+  /// IsFinalized() returns true. Listeners of an asset that is destroyed
+  /// before being finalized are never notified. Main thread only.
+  ///
+  /// @param listener The listener, owned by the caller.
+  /// @return Returns true if the asset is not finalized and the listener was
+  /// added.
+  bool AddFinalizeListener(FinalizeListener *listener) {
+    if (finalized_) return false;
+    finalize_listeners_.Add(listener);
+    return true;
+  }
+
+  /// @brief Removes a listener added with AddFinalizeListener() before it was
+  /// notified.
+  ///
+  /// @param listener The listener to remove.
+  /// @return Returns false if `listener` wasn't waiting for this asset.
+  bool RemoveFinalizeListener(FinalizeListener *listener) {
+    return finalize_listeners_.Remove(listener);
+  }
+
  protected:
+  /// @brief Declares that this asset must not be finalized before
+  /// `dependency` is.
+  ///
+  /// Call from Load() as soon as the names of the assets this one refers to
+  /// are known, e.g. the textures of a mesh's materials. If `dependency`
+  /// isn't queued yet, it is queued right away, so it loads in parallel with
+  /// this asset rather than after it. Does nothing if this asset wasn't
+  /// queued on an AsyncLoader (e.g. when loaded with LoadNow()).
+  /// See AsyncLoader::AddDependency().
+  ///
+  /// @param dependency The asset this one depends on.
+  void AddDependency(AsyncAsset *dependency);
+
   /// @brief Calls app callbacks when an asset is ready to be used.
   ///
   /// This should be called by descendants as soon as they are finalized.
@@ -140,6 +490,7 @@ class AsyncAsset : public Asset {
     }
     finalize_callbacks_.clear();
     finalized_ = true;
+    finalize_listeners_.Notify();
   }
 
   /// @brief The resource file name.
@@ -151,45 +502,319 @@ class AsyncAsset : public Asset {
   std::vector<AssetFinalizedCallback> finalize_callbacks_;
   /// @brief Whether the asset has been finalized.
   bool finalized_;
+  /// @brief Listeners to be notified when the asset is finalized.
+  FinalizeListenerList finalize_listeners_;
+
+ private:
+  // Where this asset is in the AsyncLoader's bookkeeping.
+  enum LoaderState {
+    kNotQueued,
+    kQueued,   // In workers_[loader_worker_].queues[load_priority_].
+    // Being loaded (or read, or decoded) by a worker, in no list. Stays in
+    // this state while in AsyncLoader::completed_.
+    kLoading,
+    kRead,     // Read by an I/O worker, in read_queues_[load_priority_].
+    kWaitingForDependencies,  // Loaded, but dependencies_ isn't empty yet.
+    kLoaded,     // In done_, waiting for Finalize().
+    kFinalized,  // Taken out of done_ to be finalized.
+  };
+
+  // Owned by the AsyncLoader, and only accessed under its lock, unless noted
+  // otherwise.
+  AsyncLoader *loader_;
+  LoadPriority load_priority_;
+  // Result of EstimateFinalizeCost(), cached once Load() is done. Written
+  // without the lock by the worker that loaded the asset.
+  size_t finalize_cost_;
+  LoaderState loader_state_;
+  // Index in AsyncLoader::workers_ of the worker whose queue has this asset,
+  // or AsyncLoader::kIoQueue.
+  int loader_worker_;
+  // Position in the list given by loader_state_, for constant time removal.
+  std::list<AsyncAsset *>::iterator loader_position_;
+  // Set by AsyncLoader::AbortJob() while Load() is running. Read by Load().
+  std::atomic<bool> load_cancelled_;
+  // Set by AsyncLoader::AbortJobAndDelete() while Load() is running.
+  bool delete_when_loaded_;
+  // Assets that must be finalized before this one, and assets waiting for
+  // this one to be finalized, respectively.
+  std::vector<AsyncAsset *> dependencies_;
+  std::vector<AsyncAsset *> dependents_;
+  // Result of FileDataSize() while in the kRead state.
+  size_t staged_bytes_;
+  // Whether the loader read this asset's file ahead since it was queued, and
+  // when, in AsyncLoader::TelemetryTime().
+  bool read_ahead_;
+  double read_ahead_time_;
+  // Next asset in AsyncLoader::completed_. Written without the lock, by the
+  // worker pushing this asset, and then by the main thread popping it.
+  AsyncAsset *next_completed_;
+  // Telemetry, written by whoever the asset's loader_state_ says owns it.
+  // The filename is only filled in when the record is handed out.
+  AssetLoadRecord load_record_;
 
   friend class AsyncLoader;
 };
 
+/// @class AsyncExecutor
+/// @brief Runs the work of an AsyncLoader.
+///
+/// By default, an AsyncLoader loads assets on threads of its own, see
+/// ThreadPoolExecutor. To load them on an app's job system instead, so both
+/// don't compete for the same cores, implement this interface and pass it to
+/// AsyncLoader::SetExecutor().
+///
+/// The loader hands the executor one task per worker (see
+/// AsyncLoader::SetNumWorkers()) that has something to do. A task loads
+/// assets until its worker runs out of work, and then returns, rather than
+/// waiting for more, so tasks never sit idle on the executor's threads.
+class AsyncExecutor {
+ public:
+  virtual ~AsyncExecutor() {}
+
+  /// @brief Runs `task` once, on any thread.
+  ///
+  /// May be called from any thread, including from inside a task, but never
+  /// with the loader's lock held, so it's fine to run `task` right away on
+  /// the calling thread. A task takes at least as long as a single
+  /// AsyncAsset::Load().
+  ///
+  /// @param task The work to do.
+  virtual void Execute(const std::function<void()> &task) = 0;
+};
+
+/// @class ThreadPoolExecutor
+/// @brief An AsyncExecutor that runs tasks on a fixed number of threads.
+///
+/// This is what an AsyncLoader uses unless given an executor of its own, with
+/// one thread per worker. Uses SDL threads or std::thread, depending on the
+/// backend.
+class ThreadPoolExecutor : public AsyncExecutor {
+ public:
+  /// @brief Launches the threads.
+  ///
+  /// @param num_threads The number of threads. Must be > 0.
+  explicit ThreadPoolExecutor(int num_threads);
+
+  /// @brief Runs the tasks that were already passed to Execute(), and then
+  /// joins the threads.
+  virtual ~ThreadPoolExecutor();
+
+  /// @brief Queues `task` to run on the first thread that is free.
+  ///
+  /// @param task The work to do.
+  virtual void Execute(const std::function<void()> &task);
+
+ private:
+  // Runs tasks until the destructor is called, and no tasks remain.
+  void RunTasks();
+  static int PoolThread(void *user_data);
+
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_;
+#ifdef FPLBASE_BACKEND_SDL
+  std::vector<Thread> threads_;
+  Mutex mutex_;
+  ConditionVariable task_cv_;
+#elif defined(FPLBASE_BACKEND_STDLIB)
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable task_cv_;
+#else
+#error Need to define FPLBASE_BACKEND_XXX
+#endif
+};
+
 /// @class AsyncLoader
 /// @brief Handles loading AsyncAsset objects.
+///
+/// Assets are loaded by a number of workers (one by default, see
+/// SetNumWorkers()), which run on an AsyncExecutor. Each worker has its own
+/// job queue, and steals jobs from the other workers' queues once its own
+/// runs dry.
 class AsyncLoader {
  public:
   AsyncLoader();
   ~AsyncLoader();
 
+  /// @brief Sets the number of worker threads used to load assets.
+  ///
+  /// Must not be called while the loader is running, i.e. call it before
+  /// StartLoading(), or after PauseLoading() or Stop(). Jobs that are already
+  /// queued are kept, and will be spread over the new workers.
+  ///
+  /// @param num_workers The number of loader threads to use. Must be > 0.
+  void SetNumWorkers(int num_workers);
+
+  /// @brief The number of worker threads used to load assets.
+  int num_workers() const { return static_cast<int>(workers_.size()); }
+
+  /// @brief Runs the workers on `executor`, instead of on threads of the
+  /// loader's own.
+  ///
+  /// The loader never runs more tasks on `executor` at the same time than it
+  /// has workers and I/O workers. Assets that don't
+  /// AsyncAsset::SupportsConcurrentLoad() are still loaded one at a time,
+  /// though not necessarily on the same thread. Must not be called while the
+  /// loader is running. The loader doesn't take ownership of `executor`, which
+  /// must stay alive until PauseLoading() or Stop() returns.
+  ///
+  /// @param executor The executor to use, or nullptr to use a
+  /// ThreadPoolExecutor (the default).
+  void SetExecutor(AsyncExecutor *executor);
+
+  /// @brief Sets the number of threads that only do I/O.
+  ///
+  /// With I/O workers, assets that SupportsStagedLoad() have their files read
+  /// by the I/O workers, and decoded by the regular workers, so that disk
+  /// waits and decoding overlap. With 0 (the default), the regular workers
+  /// load them in one go. Must not be called while the loader is running.
+  ///
+  /// @param num_io_workers The number of I/O threads to use.
+  void SetNumIoWorkers(int num_io_workers);
+
+  /// @brief The number of threads that only do I/O.
+  int num_io_workers() const { return static_cast<int>(io_workers_.size()); }
+
+  /// @brief Limits how much file data is read ahead of decoding.
+  ///
+  /// I/O workers stop reading new files while the files that were read, but
+  /// not yet decoded, add up to at least this many bytes. Defaults to 64MB.
+  ///
+  /// @param max_staged_bytes The limit. Must be > 0.
+  void SetMaxStagedBytes(size_t max_staged_bytes);
+
+  /// @brief Sets how many queued jobs have their file read ahead.
+  ///
+  /// Whenever a worker takes a job, the files of the next `depth` jobs in
+  /// the queues, the ones most likely to be loaded next, are handed to
+  /// ReadAheadFile(). The OS then reads them into its cache in the background
+  /// (with posix_fadvise() on Linux and Android), so they're ready by the time
+  /// a worker loads them, instead of every load waiting for the disk in turn.
+  /// This helps the most on slow storage. The file read ahead for a job is
+  /// the one named by its AsyncAsset::filename(). 0 (the default) turns
+  /// read-ahead off. See GetReadAheadStats() to tune the depth.
+  ///
+  /// @param depth The number of jobs to read ahead. Must be >= 0.
+  void SetReadAheadDepth(int depth);
+
+  /// @brief How useful reading ahead was since the loader was created, or
+  /// since ResetReadAheadStats().
+  ReadAheadStats GetReadAheadStats();
+
+  /// @brief Resets the counts of GetReadAheadStats().
+  void ResetReadAheadStats();
+
   /// @brief Queues AsyncResources to be loaded by StartLoading.
   ///
   /// Call this any number of times before StartLoading.
   ///
   /// @param res The resource to queue for loading.
-  void QueueJob(AsyncAsset *res);
+  /// @param priority Higher priority jobs are loaded before lower ones.
+  void QueueJob(AsyncAsset *res, LoadPriority priority = kLoadPriorityNormal);
+
+  /// @brief Queues many AsyncResources at once.
+  ///
+  /// Like calling QueueJob() for each of `jobs` in order, but takes the
+  /// loader's lock and wakes up the workers only once.
+  ///
+  /// @param jobs The resources to queue, in the order to load them.
+  /// @param priority Higher priority jobs are loaded before lower ones.
+  void QueueJobs(const std::vector<AsyncAsset *> &jobs,
+                 LoadPriority priority = kLoadPriorityNormal);
+
+  /// @brief Changes the priority of a job that is still queued.
+  ///
+  /// Use this to pull assets that are needed right now in front of ones that
+  /// were queued earlier, or to push back ones that are no longer urgent.
+  /// The job moves to the back of the jobs with its new priority.
+  ///
+  /// @param res The resource whose load should be re-prioritized.
+  /// @param priority The new priority.
+  /// @return Returns false if `res` isn't queued, e.g. because it's already
+  /// loading or loaded. Its priority is left unchanged in that case.
+  bool SetJobPriority(AsyncAsset *res, LoadPriority priority);
+
+  /// @brief Makes sure `res` isn't finalized before `dependency` is.
+  ///
+  /// If `dependency` isn't queued, loading or loaded yet, it is queued with
+  /// the priority of `res`. If it's queued with a lower priority, it's moved
+  /// up to that of `res`. Once `res` has been loaded, it waits for all its
+  /// dependencies to be finalized (or aborted) before it gets finalized.
+  /// Dependencies must not form a cycle. MT-safe, so this can be called from
+  /// AsyncAsset::Load().
+  ///
+  /// @param res A resource that was queued on this loader.
+  /// @param dependency The resource `res` depends on.
+  void AddDependency(AsyncAsset *res, AsyncAsset *dependency);
 
   /// @brief Aborts any pending operations for the given asset.
   ///
-  /// If the given asset is currently loading, this blocks until it is complete.
-  /// If it has not yet been loaded, this removes it from the queue.
+  /// Never blocks. If the asset is queued or waiting to be finalized, it is
+  /// removed from the loader. If it is currently loading, its
+  /// AsyncAsset::IsLoadCancelled() starts returning true, and whatever its
+  /// Load() produces is discarded instead of finalized. The loader keeps
+  /// using the asset until the first TryFinalize() after Load() returns, so
+  /// it must not be destroyed until then: use AbortJobAndDelete() to destroy
+  /// it when that is safe.
   ///
   /// @param res The resource to abort performing any operations on.
-  void AbortJob(AsyncAsset *res);
+  /// @return Returns true if the loader no longer uses `res`, false if it is
+  /// still being loaded.
+  bool AbortJob(AsyncAsset *res);
+
+  /// @brief Aborts any pending operations for the given asset, and deletes it.
+  ///
+  /// Never blocks. Like AbortJob(), but also deletes `res`: right away if
+  /// the loader isn't using it, or otherwise on the main thread (from
+  /// TryFinalize() or Stop()) once its Load() returns.
+  ///
+  /// @param res The resource to abort, and delete.
+  void AbortJobAndDelete(AsyncAsset *res);
+
+  /// @brief Loads and finalizes a job right away, on the calling thread.
+  ///
+  /// Lets a synchronous load share an asynchronous one that is already in
+  /// flight, instead of returning an asset that isn't loaded yet. If `res`
+  /// is still queued, it's taken off the queue and loaded here. If a worker
+  /// is loading it, this blocks until the worker is done. Assets that don't
+  /// SupportsConcurrentLoad() are instead moved to the front of the first
+  /// worker's queue, and waited for, unless loading is paused. Either way,
+  /// the assets `res` depends on are then loaded like this too, and finalized
+  /// before `res` is. Call from the main thread only.
+  ///
+  /// @param res A resource that was queued on this loader.
+  /// @return Returns false if `res` isn't queued, loading or loaded, e.g.
+  /// because it's finalized already, or was aborted.
+  bool LoadJobNow(AsyncAsset *res);
+
+  /// @brief Queues an asset that was loaded before, to load it again.
+  ///
+  /// Use this to pick up changes to the asset's files. The asset stays
+  /// finalized meanwhile, so it can still be used until Finalize() replaces
+  /// its contents. Main thread only.
+  ///
+  /// @param res The asset, which was finalized by this loader, or loaded
+  /// with AsyncAsset::LoadNow().
+  /// @param priority The priority to load it with.
+  /// @return Returns false if `res` is queued or loading already, or was
+  /// never finalized.
+  bool ReloadJob(AsyncAsset *res, LoadPriority priority = kLoadPriorityNormal);
 
-  /// @brief Launches the loading thread for the previously queued jobs.
+  /// @brief Starts loading the previously queued jobs, and any jobs queued
+  /// from now on.
   void StartLoading();
 
-  /// @brief Pause the loading thread for previously queued jobs.
+  /// @brief Pause loading previously queued jobs.
   ///
-  /// Blocks until only the current job is finished loading. You can resume
+  /// Blocks until only the current jobs are finished loading. You can resume
   /// loading assets by calling StartLoading().
   void PauseLoading();
 
-  /// @brief Ends the loading thread when all jobs are done.
+  /// @brief Lets the workers stop once all jobs are done.
   ///
-  /// Cleans-up the background loading thread once all jobs have been completed.
-  /// You can restart with StartLoading() if you like.
+  /// Use Stop() to also wait for that. You can restart with StartLoading() if
+  /// you like.
   void StopLoadingWhenComplete();
 
   /// @brief Call to Finalize any resources that have finished loading.
@@ -202,11 +827,109 @@ class AsyncLoader {
   /// @return Returns true once the queue is empty.
   bool TryFinalize();
 
+  /// @brief Finalize resources that have finished loading, within a budget.
+  ///
+  /// Like TryFinalize(), but stops once `budget` is used up, and leaves the
+  /// remaining resources for the next call. Resources that don't fit in what
+  /// remains of the budget are skipped in favor of cheaper ones, so they may
+  /// be finalized in a different order than they finished loading. Every call
+  /// finalizes at least one resource, if any are ready, so resources that are
+  /// more expensive than the whole budget still get finalized eventually.
+  ///
+  /// @param budget How much time and how many bytes to spend.
+  /// @param status If not null, receives what was done, and what remains.
+  /// @return Returns true once the queue is empty.
+  bool TryFinalize(const FinalizeBudget &budget,
+                   FinalizeStatus *status = nullptr);
+
+  /// @brief The number of jobs that are queued, loading, or waiting to be
+  /// finalized.
+  ///
+  /// Doesn't take the loader's lock, so it's cheap to poll every frame.
+  /// Reaches 0 once everything that was queued has been finalized or aborted.
+  int num_pending_jobs() const { return num_pending_requests_; }
+
+  /// @brief Starts, or stops, recording load telemetry. Off by default.
+  ///
+  /// While enabled, an AssetLoadRecord is kept for every asset that gets
+  /// finalized, and TryFinalize() records a QueueDepthSample whenever the
+  /// number of assets in each stage changed. Use these to tell whether loads
+  /// are held up by I/O, decoding, or finalizing. Call from the main thread.
+  ///
+  /// @param enabled Whether to record telemetry.
+  void SetTelemetryEnabled(bool enabled) { telemetry_enabled_ = enabled; }
+
+  /// @brief Whether load telemetry is being recorded.
+  bool telemetry_enabled() const { return telemetry_enabled_; }
+
+  /// @brief The assets finalized while telemetry was enabled, in the order
+  /// they were finalized. Main thread only.
+  const std::vector<AssetLoadRecord> &load_records() const {
+    return load_records_;
+  }
+
+  /// @brief The queue depths recorded while telemetry was enabled, oldest
+  /// first. Main thread only.
+  const std::vector<QueueDepthSample> &queue_depth_samples() const {
+    return queue_depth_samples_;
+  }
+
+  /// @brief Forgets all recorded telemetry. Main thread only.
+  void ClearTelemetry();
+
+  /// @brief The recorded telemetry, as a JSON object with an "assets" array
+  /// of load_records() and a "queue_depth" array of queue_depth_samples().
+  /// Main thread only.
+  std::string TelemetryToJson() const;
+
+  /// @brief Writes TelemetryToJson() to a file, for offline analysis.
+  ///
+  /// @param filename The file to write.
+  /// @return Returns false if the file couldn't be written.
+  bool SaveTelemetry(const char *filename) const;
+
   /// @brief Shuts down the loader after completing all pending loads.
   void Stop();
 
  private:
-#ifdef FPLBASE_BACKEND_SDL
+  typedef std::list<AsyncAsset *> JobList;
+
+  // Per-worker state. Each worker has one queue per LoadPriority. A worker
+  // takes the highest priority job available: it pops from the front of its
+  // own queue, or steals from the back of another worker's queue of the same
+  // priority. Assets that don't SupportsConcurrentLoad() always go to the
+  // first worker's queues, and are never stolen.
+  struct Worker {
+    Worker() : loader(nullptr), index(0), io(false), running(false) {}
+    AsyncLoader *loader;
+    int index;
+    // I/O workers have no queues of their own, they all share io_queues_.
+    bool io;
+    // Whether a task for this worker was handed to the executor, and hasn't
+    // run out of work yet.
+    bool running;
+    JobList queues[kLoadPriorityCount];
+  };
+
+  // What a worker should do with a job.
+  enum Stage {
+    kStageLoad,    // Call Load().
+    kStageRead,    // Call LoadFileData(), on an I/O worker.
+    kStageDecode,  // Call DecodeFileData().
+  };
+
+  // Value of AsyncAsset::loader_worker_ for jobs in io_queues_.
+  static const int kIoQueue = -1;
+
+  // What the workers should do once they run out of work, or sooner.
+  enum StopMode {
+    kKeepRunning,
+    kStopWhenComplete,
+    kStopNow,
+  };
+
+  // Backend-specific primitives, implemented in async_loader_sdl.cpp and
+  // async_loader_stdlib.cpp. Everything else is in async_loader_common.cpp.
   void Lock(const std::function<void()> &body);
   template <typename T>
   T LockReturn(const std::function<T()> &body) {
@@ -214,28 +937,133 @@ class AsyncLoader {
     Lock([&ret, &body]() { ret = body(); });
     return ret;
   }
-#endif
+  // Blocks until Notify() is called. Must only be called from inside a Lock()
+  // body.
+  void Wait();
+  // Wakes up all threads blocked in Wait().
+  void Notify();
 
-  void LoaderWorker();
-  static int LoaderThread(void *user_data);
+  // Whether workers may be running, i.e. StartLoading() was called, and the
+  // workers weren't stopped since.
+  bool IsLoading();
+  // Blocks until no worker is running. Must be called from inside a Lock()
+  // body.
+  void WaitForWorkers();
+  // Hands a task to the executor for each worker that isn't running, and
+  // has something to do. Must be called without the lock held.
+  void ScheduleWorkers();
+  void QueueJobLocked(AsyncAsset *res, LoadPriority priority);
+  // The queues, one per priority, of workers_[worker], or io_queues_.
+  JobList *QueuesOf(int worker);
+  void SetJobPriorityLocked(AsyncAsset *res, LoadPriority priority);
+  // Moves a loaded `res` to done_, or makes it wait for its dependencies.
+  // Must be called with the lock held.
+  void JobLoaded(AsyncAsset *res);
+  // Removes `res` from done_. Must be called with the lock held.
+  void RemoveLoadedJob(AsyncAsset *res);
+  // Unblocks the assets that were waiting for `res`, and forgets about the
+  // ones `res` was waiting for. Must be called with the lock held.
+  void ReleaseDependencies(AsyncAsset *res);
+  // Returns the next job for `worker`, and what to do with it, or nullptr if
+  // there is nothing it can run right now. Must be called with the lock held.
+  AsyncAsset *PopJob(Worker *worker, Stage *stage);
+  AsyncAsset *PopIoJob(Stage *stage);
+  // Counts whether `res`, which a worker is about to load, was read ahead.
+  // Must be called with the lock held.
+  void CountReadAhead(AsyncAsset *res);
+  // Adds the filenames of the next read_ahead_depth_ queued jobs that weren't
+  // read ahead yet to `filenames`, and marks them read ahead. Must be called
+  // with the lock held.
+  void SelectReadAhead(std::vector<std::string> *filenames);
+  // Reads the files picked by SelectReadAhead() ahead. Called without the
+  // lock.
+  void ReadAhead(const std::vector<std::string> &filenames);
+  // Whether PopJob() may find something for `worker`. Must be called with the
+  // lock held.
+  bool HasWork(const Worker &worker) const;
+  // Removes `res` from whichever list holds it, or flags it as cancelled if
+  // it's loading. Returns false in the latter case. Must be called with the
+  // lock held.
+  bool AbortJobLocked(AsyncAsset *res);
+  // Hands a job a worker is done with to the main thread. Lock-free, and
+  // may be called from any worker at the same time.
+  void PushCompletedJob(AsyncAsset *res);
+  // Takes all jobs pushed by PushCompletedJob() in one go, and moves them to
+  // done_, or deletes the ones passed to AbortJobAndDelete() while loading.
+  // Only called by the main thread.
+  void CollectCompletedJobs();
+  // Calls Load(), LoadFileData() or DecodeFileData() on `res`, depending on
+  // `stage`, and records telemetry. Returns the size of the file data read
+  // for kStageRead, and the finalize cost otherwise. Called without the lock.
+  size_t RunJob(AsyncAsset *res, Stage stage);
+  // Finalizes `res`, which must already be taken out of the loader, and
+  // returns its finalize cost. Only called by the main thread.
+  size_t FinalizeJob(AsyncAsset *res);
+  // Seconds since the loader was created, for telemetry. MT-safe.
+  double TelemetryTime() const;
+  // Adds a QueueDepthSample, unless nothing changed since the last one.
+  void SampleQueueDepth();
+  // Returns true if finalizing `res` is expected to fit in the remainder of
+  // `budget`. Must be called with the lock held.
+  bool FitsBudget(const AsyncAsset *res, const FinalizeBudget &budget,
+                  double seconds_spent, size_t bytes_spent) const;
 
-  std::deque<AsyncAsset *> queue_, done_;
-  AsyncAsset *loading_;
-  int num_pending_requests_;
-#ifdef FPLBASE_BACKEND_SDL
-  // Keep handle to the worker thread around so that we can wait for it to
-  // finish before destroying the class.
-  Thread worker_thread_;
+  // The task run by the executor: loads assets until `worker` runs out of
+  // work.
+  void RunWorker(Worker *worker);
 
-  // This lock protects ALL state in this class, i.e. the two vectors.
+  std::vector<Worker> workers_;
+  std::vector<Worker> io_workers_;
+  // Jobs waiting for an I/O worker, and jobs waiting to be decoded after
+  // that. Only used with I/O workers.
+  JobList io_queues_[kLoadPriorityCount];
+  JobList read_queues_[kLoadPriorityCount];
+  // Sum of AsyncAsset::staged_bytes_ of the jobs in read_queues_.
+  size_t staged_bytes_;
+  size_t max_staged_bytes_;
+  // See SetReadAheadDepth() and GetReadAheadStats().
+  int read_ahead_depth_;
+  ReadAheadStats read_ahead_stats_;
+  // Jobs workers are done with, most recent first, linked through
+  // AsyncAsset::next_completed_. Workers push onto this without taking the
+  // lock, and the main thread takes the whole stack at once, so finishing a
+  // job never contends with the main thread.
+  std::atomic<AsyncAsset *> completed_;
+  JobList done_;
+  // done_.size(), so TryFinalize() can see there is nothing to do without
+  // taking the lock.
+  std::atomic<int> num_done_;
+  size_t next_worker_;
+  // The number of workers that are running.
+  int num_running_;
+  // The number of threads in LoadJobNow() waiting for a worker. Workers only
+  // Notify() when they complete a job while there are any.
+  std::atomic<int> num_job_waiters_;
+  // Only modified under the lock, but read without it.
+  std::atomic<int> num_pending_requests_;
+  StopMode stop_mode_;
+  // Running average of the measured cost of Finalize(), used to predict
+  // whether an asset fits in a FinalizeBudget. Only used by the main thread.
+  double finalize_seconds_per_byte_;
+  // Telemetry. Only used by the main thread, apart from start_time_, which
+  // never changes.
+  std::chrono::steady_clock::time_point start_time_;
+  bool telemetry_enabled_;
+  std::vector<AssetLoadRecord> load_records_;
+  std::vector<QueueDepthSample> queue_depth_samples_;
+  // Set by SetExecutor(). Without it, workers run on default_executor_,
+  // which only exists while loading. Both only change while no worker runs.
+  AsyncExecutor *executor_;
+  std::unique_ptr<ThreadPoolExecutor> default_executor_;
+#ifdef FPLBASE_BACKEND_SDL
+  // This lock protects ALL state in this class, i.e. the queues.
   Mutex mutex_;
 
-  // Kick-off the worker thread when a new job arrives.
-  Semaphore job_semaphore_;
+  // Signaled when a worker stops running.
+  ConditionVariable idle_cv_;
 #elif defined(FPLBASE_BACKEND_STDLIB)
-  std::thread worker_thread_;
   std::mutex mutex_;
-  std::condition_variable job_cv_;
+  std::condition_variable_any idle_cv_;
 #else
 #error Need to define FPLBASE_BACKEND_XXX
 #endif
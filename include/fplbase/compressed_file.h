@@ -0,0 +1,99 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_COMPRESSED_FILE_H
+#define FPLBASE_COMPRESSED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_compressed_file
+/// @{
+///
+/// A compressed file holds the contents of another file, split into blocks
+/// that are compressed (with zlib) independently of each other, so that the
+/// blocks of a large file can be decompressed by several threads at once.
+///
+/// LoadFile() and LoadFileView() recognize compressed files, wherever they
+/// are read from, and return what was compressed. So any asset can be
+/// replaced by its compressed version (e.g. as written by file_compressor)
+/// without changing the code that loads it. That trades CPU time for less
+/// I/O, which pays off on slow storage such as SD cards or network drives.
+///
+/// The layout of a compressed file, with all integers little endian:
+///
+///     char magic[4];          // kCompressedFileMagic
+///     uint32_t block_size;    // Size of every block but the last, before
+///                             // compression.
+///     uint64_t size;          // Size of the file before compression.
+///     uint32_t block_sizes[]; // Size of each block after compression.
+///     ...                     // The blocks.
+///
+/// Blocks that don't get smaller are stored uncompressed, which is the case
+/// exactly when their size is that before compression.
+
+/// @brief The first bytes of every compressed file.
+const char kCompressedFileMagic[4] = {'F', 'P', 'L', 'Z'};
+/// @brief The size of the header before the block sizes.
+const size_t kCompressedFileHeaderSize = 16;
+/// @brief The block size CompressFileData() uses by default.
+const size_t kDefaultCompressedBlockSize = 256 * 1024;
+
+/// @brief Whether `data` is a compressed file.
+///
+/// Only checks the magic, so DecompressFileData() may still find the file
+/// corrupt.
+bool IsCompressedFileData(const void *data, size_t size);
+
+/// @brief Compresses the contents of a file.
+///
+/// @param src The contents of the file.
+/// @param block_size The size the file is split into blocks of. Smaller
+/// blocks can be decompressed by more threads, larger ones compress better.
+/// @param dest Receives the compressed file.
+/// @return Returns false if block_size is 0 or too large.
+bool CompressFileData(const std::string &src, size_t block_size,
+                      std::string *dest);
+
+/// @brief Decompresses a compressed file.
+///
+/// Files of more than a few blocks are decompressed by up to
+/// MaxDecompressionThreads() threads, including the calling one.
+///
+/// @param data The compressed file.
+/// @param size The size of the compressed file.
+/// @param dest Receives the contents of the file.
+/// @return Returns false, and logs an error, if the file is corrupt.
+bool DecompressFileData(const void *data, size_t size, std::string *dest);
+
+/// @brief Sets the number of threads DecompressFileData() may use for one
+/// file.
+///
+/// The default is the number of cores, but at most 4, since loads are
+/// usually already spread across the AsyncLoader's workers.
+///
+/// @param max_threads At least 1. 1 decompresses on the calling thread only.
+void SetMaxDecompressionThreads(int max_threads);
+
+/// @brief The number of threads DecompressFileData() may use for one file.
+int MaxDecompressionThreads();
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_COMPRESSED_FILE_H
@@ -0,0 +1,143 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_FILE_SYSTEM_H
+#define FPLBASE_FILE_SYSTEM_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_file_system
+/// @{
+///
+/// LoadFile(), LoadFileView(), and everything that reads files through them
+/// (LoadFileWithDirectives(), AssetManager, ...) search an ordered table of
+/// mounts: directories, asset packs (see MountAssetPack()) and files held in
+/// memory. The most recently mounted is searched first. Files no mount has
+/// are read by the function set with SetLoadFileFunction(). Wherever a file
+/// is found, it's decompressed if it's a compressed file (see
+/// compressed_file.h).
+///
+/// Files that can't be found anywhere are remembered, so asking for them
+/// again fails right away, without touching the disk. That is forgotten
+/// whenever the mounts or the load file function change, when SaveFile()
+/// writes a file, and on ForgetMissingFiles(). Files that a function set
+/// with SetLoadFileFunction() didn't find aren't remembered, since it may
+/// find them later.
+///
+/// All functions may be called from any thread.
+
+/// @brief The kinds of mounts, see MountStats.
+enum MountType {
+  kMountDirectory,
+  kMountAssetPack,
+  kMountMemory,
+  /// @brief Not a mount: the function set with SetLoadFileFunction(), which
+  /// is asked for files after all mounts.
+  kMountLoadFileFunction
+};
+
+/// @brief How often a mount was searched, see GetMountStats().
+struct MountStats {
+  /// @brief The directory, pack file or name the mount was mounted with.
+  std::string name;
+  MountType type;
+  /// @brief The number of files read from the mount.
+  int num_hits;
+  /// @brief The number of files searched for in the mount, but not found.
+  int num_misses;
+  /// @brief The number of bytes read from the mount, or used in place.
+  uint64_t num_bytes;
+};
+
+/// @brief Makes LoadFile() read files from a directory.
+///
+/// A file named "textures/a.webp" is read from "<directory>/textures/a.webp".
+/// Where the platform allows, the files in the directory and all directories
+/// below it are listed once, when mounting, so looking for a file the
+/// directory doesn't have doesn't touch the disk. Files added to the
+/// directory later are only found after mounting it again. Links to
+/// directories are followed, unless they lead back to a directory they are
+/// in.
+///
+/// Like all Mount*() functions, this replaces any mount with the same name,
+/// and the new mount is searched first.
+///
+/// @param directory The directory, e.g. where downloaded content is kept.
+/// @return Returns false if the directory can't be read.
+bool MountDirectory(const char *directory);
+
+/// @brief Makes LoadFile() read files held in memory, e.g. generated by the
+/// app, or embedded in the executable.
+///
+/// @param name The name to unmount the files with.
+/// @param files The name and contents of each file. They are copied.
+void MountMemoryFiles(
+    const char *name,
+    const std::vector<std::pair<std::string, std::string>> &files);
+
+/// @brief Removes a mount, added by any of the Mount*() functions.
+///
+/// Loads already reading from the mount finish first.
+///
+/// @param name The directory, pack file or name the mount was mounted with.
+/// @return Returns false if there's no such mount.
+bool Unmount(const char *name);
+
+/// @brief Tells the OS that a file will be loaded soon, so that it can read
+/// it into its cache in the background.
+///
+/// Finds the file like LoadFile(), but returns right away, without waiting
+/// for the file to be read. Used by AsyncLoader to read the files of queued
+/// jobs ahead, see AsyncLoader::SetReadAheadDepth().
+///
+/// @param filename The file, as passed to LoadFile().
+/// @return Returns false if the file isn't found, or can't be read ahead:
+/// files held in memory, files read by the function set with
+/// SetLoadFileFunction(), and all files on platforms without such hints.
+bool ReadAheadFile(const char *filename);
+
+/// @brief Gets the path LoadFile() would read a file from.
+///
+/// @param filename The file, as passed to LoadFile().
+/// @return Returns the path in the first directory mount that has the file,
+/// or `filename` itself if no mount has it, since the load file function
+/// is then asked for it. Returns an empty string if an asset pack or memory
+/// mount has the file, which isn't read from a path then.
+std::string ResolveMountedPath(const char *filename);
+
+/// @brief Forgets which files were found missing, e.g. after writing files
+/// without calling SaveFile().
+void ForgetMissingFiles();
+
+/// @brief Gets the statistics of all mounts, in the order they are searched,
+/// followed by those of the load file function.
+void GetMountStats(std::vector<MountStats> *stats);
+
+/// @brief The number of times a file was known to be missing, and wasn't
+/// searched for.
+int NumCachedMisses();
+
+/// @brief Resets the counts of GetMountStats() and NumCachedMisses().
+void ResetMountStats();
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FILE_SYSTEM_H
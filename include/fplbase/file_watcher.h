@@ -0,0 +1,83 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_FILE_WATCHER_H
+#define FPLBASE_FILE_WATCHER_H
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "fplbase/fpl_common.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_file_watcher
+/// @{
+
+/// @class FileWatcher
+/// @brief Tells which files changed on disk, e.g. to reload them.
+///
+/// Uses inotify, so it only works on Linux (but not Android, where assets
+/// live in the APK). Elsewhere, IsSupported() returns false and no changes
+/// are ever reported.
+///
+/// Watches the directories of the files, rather than the files themselves,
+/// since editors often save by writing a new file and renaming it.
+class FileWatcher {
+ public:
+  FileWatcher();
+  ~FileWatcher();
+
+  /// @brief Whether files can be watched on this platform.
+  static bool IsSupported();
+
+  /// @brief Starts watching a file.
+  ///
+  /// @param filename The file, as passed to LoadFile(). It doesn't need to
+  /// exist yet, but its directory does.
+  /// @return Returns false if the file can't be watched.
+  bool Watch(const char *filename);
+
+  /// @brief Whether Watch() was called for `filename`.
+  bool IsWatched(const std::string &filename) const {
+    return files_.count(filename) != 0;
+  }
+
+  /// @brief Gets the watched files that were written since the last call.
+  ///
+  /// Never blocks, so it can be called every frame.
+  ///
+  /// @param changed Receives the names of the files, as passed to Watch(),
+  /// each at most once.
+  void Poll(std::vector<std::string> *changed);
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(FileWatcher);
+
+  // The inotify instance, or -1.
+  int fd_;
+  // The prefix of the files in each watched directory (e.g. "textures/"),
+  // by watch descriptor, and the other way around.
+  std::unordered_map<int, std::string> dirs_;
+  std::unordered_map<std::string, int> dir_watches_;
+  std::unordered_set<std::string> files_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FILE_WATCHER_H
@@ -59,6 +59,12 @@ class Material : public Asset {
   /// "BlendMode" enum for this Material.
   int blend_mode() const { return blend_mode_; }
 
+  /// @brief The material itself, not counting its textures.
+  virtual AssetMemoryUsage MemoryUsage() const {
+    return AssetMemoryUsage(
+        0, sizeof(*this) + textures_.capacity() * sizeof(textures_[0]));
+  }
+
   /// @brief Set the blend mode.
   /// @param[in] blend_mode A @ref fplbase_material "BlendMode" enum
   /// corresponding to the blend mode to set for this texture.
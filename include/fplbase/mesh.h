@@ -101,12 +101,37 @@ class Mesh : public AsyncAsset {
                               mathfu::vec3 *max_position = nullptr,
                               mathfu::vec3 *min_position = nullptr);
 
-  /// @brief Loads and unpacks the Mesh from 'filename_' and 'data_'.
+  /// @brief Loads the Mesh from 'filename_' into 'data_'.
+  ///
+  /// Reads and parses the file, interleaves its vertices and computes its
+  /// bounds and bones, so that Finalize() only has to upload the buffers.
   virtual void Load();
 
-  /// @brief Creates a mesh from 'data_'.
+  /// @brief Meshes don't touch the GPU in Load(), so they can be loaded
+  /// concurrently.
+  virtual bool SupportsConcurrentLoad() const { return true; }
+
+  /// @brief Creates the materials in Load() instead of in Finalize().
+  ///
+  /// This lets the textures of the materials load in parallel with the mesh,
+  /// rather than after it, and makes the mesh wait for them before it gets
+  /// finalized. The MaterialCreateFn is then called on a loader thread, so it
+  /// must be MT-safe.
+  ///
+  /// @param b Whether to create the materials in Load().
+  void set_create_materials_in_load(bool b) { create_materials_in_load_ = b; }
+
+  /// @brief Creates a mesh from 'data_', by uploading the vertex and index
+  /// buffers prepared by Load(), and creating any materials Load() didn't.
   virtual bool Finalize();
 
+  /// @brief The size of the vertex and index buffers Finalize() uploads.
+  virtual size_t EstimateFinalizeCost() const;
+
+  /// @brief The vertex and index buffers in GPU memory, plus the bone arrays
+  /// and any loaded mesh not yet finalized.
+  virtual AssetMemoryUsage MemoryUsage() const;
+
   /// @brief Whether this object loaded and finalized correctly. Call after
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid();
@@ -168,6 +193,9 @@ class Mesh : public AsyncAsset {
   /// @return Returns the material of the corresponding IBO.
   Material *GetMaterial(int i) { return indices_[i].mat; }
 
+  /// @brief The number of IBOs, each with its own material.
+  size_t num_index_arrays() const { return indices_.size(); }
+
   /// @brief Define the vertex buffer format.
   ///
   /// `format` must have length <= kMaxAttributes, including `kEND`.
@@ -374,6 +402,26 @@ class Mesh : public AsyncAsset {
   static MeshImpl *CreateMeshImpl();
   static void DestroyMeshImpl(MeshImpl *impl);
 
+  // A mesh file parsed by Load(), with everything computed that Finalize()
+  // needs, but doesn't need the GPU for. Defined in mesh_common.cpp.
+  struct Staging;
+
+  // Parses a MeshDef FlatBuffer into `staging`. Doesn't touch the GPU, or
+  // anything outside of this object.
+  bool Stage(const void *meshdef_buffer, Staging *staging);
+
+  // Creates the mesh from `staging`, taking its bones.
+  bool Upload(Staging *staging);
+
+  // The CPU memory held by 'data_', while loaded but not yet finalized.
+  size_t StagedBytes() const;
+
+  // Finds the bounds of the positions in `vertex_data`.
+  static void CalculateBounds(const void *vertex_data, size_t count,
+                              size_t vertex_size, const Attribute *format,
+                              mathfu::vec3 *min_position,
+                              mathfu::vec3 *max_position);
+
   static const int kMaxAttributes = 10;
 
   struct Indices {
@@ -426,6 +474,11 @@ class Mesh : public AsyncAsset {
 
   // Function to create material.
   MaterialCreateFn material_create_fn_;
+
+  // Materials for each surface, created by Load() if
+  // create_materials_in_load_ is set, and used by Finalize().
+  bool create_materials_in_load_;
+  std::vector<Material *> loaded_materials_;
 };
 
 /// @}
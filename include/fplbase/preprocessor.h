@@ -57,6 +57,25 @@ bool LoadFileWithDirectives(const char *filename, std::string *dest,
                             const std::set<std::string> &defines,
                             std::string *error_message);
 
+/// @brief Overloaded LoadFileWithDirectives to also return the names of the
+/// files that were read, e.g. to reload when one of them changes.
+///
+/// @param[in] filename A UTF-8 C-string representing the file to load.
+/// @param[out] dest A pointer to a `std::string` to capture the preprocessed
+/// version of the file.
+/// @param[in] defines A set of identifiers which will be
+/// prefixed with \#define at the start of the file.
+/// @param[out] error_message A pointer to a `std::string` that captures an
+/// error message (if the function returned `false`, indicating failure).
+/// @param[out] files Receives `filename`, and every file it \#includes,
+/// directly or indirectly.
+/// @return If this function returns false, `error_message` indicates which
+/// directive caused the problem and why.
+bool LoadFileWithDirectives(const char *filename, std::string *dest,
+                            const std::set<std::string> &defines,
+                            std::string *error_message,
+                            std::set<std::string> *files);
+
 /// @brief Overloaded LoadFileWithDirectives to allow pre-definining \#define
 /// identifiers in an array.
 ///
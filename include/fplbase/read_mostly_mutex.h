@@ -0,0 +1,132 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_READ_MOSTLY_MUTEX_H
+#define FPLBASE_READ_MOSTLY_MUTEX_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "fplbase/fpl_common.h"
+#include "fplutil/mutex.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_read_mostly_mutex
+/// @{
+
+/// @class ReadMostlyMutex
+/// @brief A readers-writer lock for data that is read far more often than
+/// it is written, such as the AssetManager's tables.
+///
+/// Unlike a plain readers-writer lock, readers don't all update one shared
+/// counter: each counts itself in one of several slots, picked by thread
+/// and on separate cache lines, so readers on different cores don't slow
+/// each other down. Taking the lock for reading is lock-free while nobody
+/// writes. Writers are serialized, and wait for all readers to leave, so
+/// writes are slower and should be short.
+///
+/// Neither side is recursive: a thread holding the lock must not lock it
+/// again.
+class ReadMostlyMutex {
+ public:
+  ReadMostlyMutex() : writing_(false) {
+    for (int i = 0; i < kNumSlots; ++i) slots_[i].readers = 0;
+  }
+
+  /// @brief Locks for reading. Waits while another thread writes.
+  ///
+  /// @return Returns the token to pass to UnlockRead().
+  int LockRead() {
+    const int slot = SlotOfThisThread();
+    std::atomic<int> &readers = slots_[slot].readers;
+    readers.fetch_add(1);
+    // Both sequentially consistent, so that either this sees the writer,
+    // or the writer sees this.
+    if (writing_.load()) {
+      readers.fetch_sub(1);
+      WaitForWriter(readers);
+    }
+    return slot;
+  }
+
+  /// @brief Unlocks after LockRead().
+  void UnlockRead(int token) {
+    slots_[token].readers.fetch_sub(1, std::memory_order_release);
+  }
+
+  /// @brief Locks for writing. Waits for other writers, and for readers.
+  void LockWrite();
+
+  /// @brief Unlocks after LockWrite().
+  void UnlockWrite();
+
+  /// @class ReadLock
+  /// @brief Holds a ReadMostlyMutex locked for reading while in scope.
+  class ReadLock {
+   public:
+    explicit ReadLock(ReadMostlyMutex &mutex)
+        : mutex_(mutex), token_(mutex.LockRead()) {}
+    ~ReadLock() { mutex_.UnlockRead(token_); }
+
+   private:
+    FPL_DISALLOW_COPY_AND_ASSIGN(ReadLock);
+    ReadMostlyMutex &mutex_;
+    int token_;
+  };
+
+  /// @class WriteLock
+  /// @brief Holds a ReadMostlyMutex locked for writing while in scope.
+  class WriteLock {
+   public:
+    explicit WriteLock(ReadMostlyMutex &mutex) : mutex_(mutex) {
+      mutex_.LockWrite();
+    }
+    ~WriteLock() { mutex_.UnlockWrite(); }
+
+   private:
+    FPL_DISALLOW_COPY_AND_ASSIGN(WriteLock);
+    ReadMostlyMutex &mutex_;
+  };
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(ReadMostlyMutex);
+
+  static const int kNumSlots = 16;
+  static const int kCacheLineSize = 64;
+
+  struct Slot {
+    alignas(kCacheLineSize) std::atomic<int> readers;
+  };
+
+  static int SlotOfThisThread() {
+    return static_cast<int>(
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % kNumSlots);
+  }
+
+  // Waits until no writer holds the lock, then counts this thread in
+  // `readers`.
+  void WaitForWriter(std::atomic<int> &readers);
+
+  Slot slots_[kNumSlots];
+  alignas(kCacheLineSize) std::atomic<bool> writing_;
+  fplutil::Mutex writer_mutex_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_READ_MOSTLY_MUTEX_H
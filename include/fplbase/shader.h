@@ -96,6 +96,12 @@ class Shader : public AsyncAsset {
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid() { return ValidShaderHandle(program_); }
 
+  /// @brief The defines of this shader, and any source not yet compiled.
+  ///
+  /// The size of compiled programs isn't exposed by all drivers, so isn't
+  /// counted.
+  virtual AssetMemoryUsage MemoryUsage() const;
+
   /// @brief Find a non-standard uniform by name.
   ///
   /// @param uniform_name The name of the uniform to find.
@@ -187,6 +193,10 @@ class Shader : public AsyncAsset {
   /// the shader is used. Otherwise an assert will be hit in Shader::Set().
   void MarkDirty() { dirty_ = true; }
 
+  /// @brief The files the shader was last compiled from: its .glslv and
+  /// .glslf files, and the files they \#include. Empty until finalized.
+  const std::set<std::string> &source_files() const { return source_files_; }
+
   // For internal use.
   ShaderImpl *impl() { return impl_; }
 
@@ -203,6 +213,7 @@ class Shader : public AsyncAsset {
   struct ShaderSourcePair {
     std::string vertex_shader;
     std::string fragment_shader;
+    std::set<std::string> files;
   };
 
   // Used by constructor to init inner variables.
@@ -249,6 +260,9 @@ class Shader : public AsyncAsset {
 
   // If true, means this shader needs to be reloaded.
   bool dirty_;
+
+  // See source_files().
+  std::set<std::string> source_files_;
 };
 
 /// @}
@@ -15,6 +15,8 @@
 #ifndef FPLBASE_TEXTURE_H
 #define FPLBASE_TEXTURE_H
 
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include "fplbase/config.h"  // Must come first.
@@ -27,6 +29,7 @@
 namespace fplbase {
 
 class Renderer;
+class TextureCache;
 struct TextureImpl;
 
 /// @file
@@ -97,6 +100,13 @@ inline bool IsCompressed(TextureFormat format) {
   }
 }
 
+class Texture;
+
+/// @brief Picks the texture that `texture` shares its GPU texture with, see
+/// Texture::set_dedup_fn().
+typedef std::function<Texture *(uint64_t content_hash, Texture *texture)>
+    TextureDedupFn;
+
 /// @class Texture
 /// @brief Abstraction for a texture object loaded on the GPU.
 ///
@@ -116,6 +126,56 @@ class Texture : public AsyncAsset {
   /// also sets the original size, if it has not yet been set.
   virtual void Load();
 
+  /// @brief Textures only decode into their own buffer, so they can be loaded
+  /// concurrently.
+  virtual bool SupportsConcurrentLoad() const { return true; }
+
+  /// @brief Textures can be read and decoded on different threads.
+  virtual bool SupportsStagedLoad() const { return true; }
+
+  /// @brief Reads the file that Load() would unpack.
+  virtual void LoadFileData();
+
+  /// @brief Unpacks the file read by LoadFileData() into `data_`.
+  virtual void DecodeFileData();
+
+  /// @brief The size of the file read by LoadFileData().
+  virtual size_t FileDataSize() const { return file_data_.size(); }
+
+  /// @brief Lets textures with identical files share one GPU texture.
+  ///
+  /// Once the file is read, DecodeFileData() hashes it, together with the
+  /// format, flags and scale, and passes that to `dedup_fn`. If it returns
+  /// another texture, this one isn't decoded, and Finalize() makes it use
+  /// the GPU texture of the other one instead. `dedup_fn` is called on a
+  /// loader thread, and must make sure that the texture it returns is
+  /// finalized before this one, and outlives it. AssetManager does that, see
+  /// AssetManager::SetTextureDeduplication().
+  ///
+  /// @param dedup_fn The function to call, or nullptr to always decode.
+  void set_dedup_fn(const TextureDedupFn &dedup_fn) { dedup_fn_ = dedup_fn; }
+
+  /// @brief The texture whose GPU texture this one uses, or nullptr.
+  Texture *original() const { return original_; }
+
+  /// @brief Keeps what DecodeFileData() decodes in `cache`, and reads it
+  /// from there instead of decoding, when the file was decoded before.
+  ///
+  /// The entries are keyed by the same hash as set_dedup_fn() uses. They hold
+  /// the pixels as they are uploaded: textures that CreateTexture() would
+  /// convert to 5551 or 565 are converted when decoding instead, on the
+  /// loader thread. Compressed files (ASTC, PKM, KTX) aren't cached.
+  ///
+  /// @param cache The cache to use, or nullptr to always decode.
+  void set_cache(const std::shared_ptr<TextureCache> &cache) {
+    cache_ = cache;
+  }
+
+  /// @brief The hash passed to the function set with set_dedup_fn(), and
+  /// used as the key of the cache set with set_cache(), or 0 if neither was
+  /// set.
+  uint64_t content_hash() const { return content_hash_; }
+
   /// @brief Create a texture from data in memory.
   /// @param[in] data The Texture data in memory to load from.
   /// @param[in] size A const `mathfu::vec2i` reference to the original
@@ -127,6 +187,13 @@ class Texture : public AsyncAsset {
   /// @brief Creates a Texture from `data_` and stores the handle in `id_`.
   virtual bool Finalize();
 
+  /// @brief The size of the unpacked image, including mipmaps.
+  virtual size_t EstimateFinalizeCost() const;
+
+  /// @brief The texture in GPU memory, including mipmaps and cube map faces,
+  /// plus any file or image data not yet uploaded.
+  virtual AssetMemoryUsage MemoryUsage() const;
+
   /// @brief Whether this object loaded and finalized correctly. Call after
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid() { return ValidTextureHandle(id_); }
@@ -412,6 +479,28 @@ class Texture : public AsyncAsset {
   /// @brief Backend specific conversion of flags to TextureTarget.
   static TextureTarget TextureTargetFromFlags(TextureFlags flags);
 
+  // The two halves of LoadAndUnpackTexture(). LoadTextureFile() reads the file
+  // to unpack into `file`. That isn't always `filename`: formats the renderer
+  // doesn't support fall back to WebP. It returns the extension of the file
+  // it read in `ext`, which UnpackTextureFile() then uses to unpack it.
+  static bool LoadTextureFile(const char *filename, std::string *file,
+                              std::string *ext);
+  static uint8_t *UnpackTextureFile(const char *filename,
+                                    const std::string &file,
+                                    const std::string &ext,
+                                    const mathfu::vec2 &scale,
+                                    TextureFlags flags,
+                                    mathfu::vec2i *dimensions,
+                                    TextureFormat *texture_format);
+
+  // Hashes `file_data_`, together with everything else that affects what it
+  // decodes into.
+  uint64_t HashFileData() const;
+
+  // Converts `data_` to the 16 bit format CreateTexture() would upload it
+  // as, if any, so that the cache holds what is uploaded.
+  void ConvertForUpload();
+
   TextureImpl *impl_;
   TextureHandle id_;
   mathfu::vec2i size_;
@@ -422,6 +511,13 @@ class Texture : public AsyncAsset {
   TextureFormat desired_;
   TextureFlags flags_;
   bool is_external_;
+  TextureDedupFn dedup_fn_;
+  std::shared_ptr<TextureCache> cache_;
+  uint64_t content_hash_;
+  Texture *original_;
+  // The file read by LoadFileData(), and its extension.
+  std::string file_data_;
+  std::string file_ext_;
 };
 
 /// @brief used by some functions to allow the texture loading mechanism to
@@ -47,7 +47,7 @@ class TextureAtlas : public Asset {
 
   /// @brief Delete the texture associated with this atlas.
   void Delete() {
-    atlas_texture_->Delete();
+    if (atlas_texture_) atlas_texture_->Delete();
     atlas_texture_ = nullptr;
   }
 
@@ -113,6 +113,17 @@ class TextureAtlas : public Asset {
   /// @ref subtexture_bounds().
   std::map<std::string, size_t> &index_map() { return index_map_; }
 
+  /// @brief The subtexture bounds and names, not counting the texture.
+  virtual AssetMemoryUsage MemoryUsage() const {
+    AssetMemoryUsage usage(0, sizeof(*this));
+    usage.cpu_bytes +=
+        subtexture_bounds_.capacity() * sizeof(subtexture_bounds_[0]);
+    for (auto it = index_map_.begin(); it != index_map_.end(); ++it) {
+      usage.cpu_bytes += sizeof(*it) + it->first.capacity();
+    }
+    return usage;
+  }
+
   /// @brief Load a texture atlas file. Used by the more convenient AssetManager
   /// interface, but can be used without it.
   static TextureAtlas *LoadTextureAtlas(const char *filename,
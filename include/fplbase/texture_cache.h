@@ -0,0 +1,111 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_TEXTURE_CACHE_H
+#define FPLBASE_TEXTURE_CACHE_H
+
+#include <atomic>
+#include <string>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/fpl_common.h"
+#include "fplbase/texture.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_texture_cache
+/// @{
+
+/// @class TextureCache
+/// @brief Keeps decoded textures on disk, ready to upload, so later runs
+/// don't decode them again.
+///
+/// Each entry is a file in the cache directory, named after its key, that
+/// holds a small header followed by the pixels, exactly as they are passed
+/// to the GPU. Texture computes the key from the contents of the source file
+/// and everything else that affects what it decodes into, so a changed
+/// source file simply misses, and its old entry is left behind.
+///
+/// Only uncompressed formats are cached: compressed files are already in
+/// the format they are uploaded in.
+///
+/// Read() and Write() may be called on any thread.
+class TextureCache {
+ public:
+  /// @brief Constructor for a TextureCache.
+  /// @param directory Where to keep the entries. It must already exist, and
+  /// be writable, e.g. the app's cache directory on Android.
+  explicit TextureCache(const char *directory);
+
+  /// @brief Reads the entry for `key`.
+  ///
+  /// @param key The key the entry was written with.
+  /// @param[out] size The size of the texture.
+  /// @param[out] texture_format The format of the returned pixels.
+  /// @return Returns the pixels, or nullptr if there is no valid entry for
+  /// `key`.
+  /// @note You must `free()` on the returned pointer when done.
+  uint8_t *Read(uint64_t key, mathfu::vec2i *size,
+                TextureFormat *texture_format);
+
+  /// @brief Writes the entry for `key`, replacing any existing one.
+  ///
+  /// Writes to a temporary file first, so that a Read() on another thread,
+  /// or in a later run after a crash, never sees a partial entry.
+  ///
+  /// @param key The key to read the entry with later.
+  /// @param pixels The pixels, `DataSize(size, texture_format)` bytes.
+  /// @param size The size of the texture.
+  /// @param texture_format The format of `pixels`, which must not be
+  /// compressed.
+  /// @return Returns false if the entry couldn't be written.
+  bool Write(uint64_t key, const uint8_t *pixels, const mathfu::vec2i &size,
+             TextureFormat texture_format);
+
+  /// @brief The number of bytes of a texture in an uncompressed format, or
+  /// 0 for other formats.
+  static size_t DataSize(const mathfu::vec2i &size,
+                         TextureFormat texture_format);
+
+  /// @brief The file that holds the entry for `key`.
+  std::string EntryFilename(uint64_t key) const;
+
+  /// @brief The directory passed to the constructor.
+  const std::string &directory() const { return directory_; }
+
+  /// @brief The number of Read() calls that returned an entry.
+  int num_hits() const { return num_hits_; }
+
+  /// @brief The number of Read() calls that didn't.
+  int num_misses() const { return num_misses_; }
+
+  /// @brief The number of entries written.
+  int num_writes() const { return num_writes_; }
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(TextureCache);
+
+  std::string directory_;
+  std::atomic<int> num_hits_;
+  std::atomic<int> num_misses_;
+  std::atomic<int> num_writes_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_TEXTURE_CACHE_H
@@ -16,6 +16,7 @@
 #define FPLBASE_UTILITIES_H
 
 #include <functional>
+#include <memory>
 #include <string>
 #include "fplbase/config.h"  // Must come first.
 
@@ -118,8 +119,9 @@ struct HighPerformanceParams {
 bool LoadFileRaw(const char *filename, std::string *dest);
 
 /// @brief Loads a file and returns its contents via string pointer.
-/// @details In contrast to `LoadFileRaw()`, this method simply calls the
-/// function set by `SetLoadFileFunction()` to read the specified file.
+/// @details In contrast to `LoadFileRaw()`, this method reads the file from
+/// the first mount that has it (see fplbase/file_system.h), and otherwise
+/// calls the function set by `SetLoadFileFunction()` to read it.
 /// @param[in] filename A UTF-8 C-string representing the file to load.
 /// @param[out] dest A pointer to a `std::string` to capture the output of
 /// the file.
@@ -135,6 +137,61 @@ bool LoadFile(const char *filename, std::string *dest);
 /// @return Returns the function previously set by `LoadFileFunction()`.
 LoadFileFunction SetLoadFileFunction(LoadFileFunction load_file_function);
 
+/// @class FileView
+/// @brief The read-only contents of a file, filled in by `LoadFileView()`.
+///
+/// Depending on where the file is, the view refers to the file mapped into
+/// memory, to an entry of a mounted asset pack, or to a copy of the file.
+/// Either way, `data()` is aligned well enough to read a FlatBuffer in place,
+/// and stays valid until the view is reset or destroyed.
+class FileView {
+ public:
+  FileView();
+  FileView(FileView &&other);
+  FileView &operator=(FileView &&other);
+  ~FileView() { Reset(); }
+
+  /// @brief Releases the file.
+  void Reset();
+
+  /// @brief The contents of the file.
+  const uint8_t *data() const {
+    return data_ ? data_ : reinterpret_cast<const uint8_t *>(contents_.data());
+  }
+  /// @brief The size of the file, in bytes.
+  size_t size() const { return data_ ? size_ : contents_.size(); }
+  /// @brief Whether the view refers to nothing, or to an empty file.
+  bool empty() const { return size() == 0; }
+
+ private:
+  friend bool LoadFileView(const char *filename, FileView *view);
+
+  FileView(const FileView &);
+  FileView &operator=(const FileView &);
+
+  // Points into the mapped file or the mount, or is null when the file was
+  // copied into contents_.
+  const uint8_t *data_;
+  size_t size_;
+  void *mapped_;
+  size_t mapped_size_;
+  // The mount that data_ points into, which stays mounted while in use.
+  std::shared_ptr<const void> owner_;
+  std::string contents_;
+};
+
+/// @brief Loads a file like `LoadFile()`, but without copying it if possible.
+/// @details Files in a mounted pack, or mounted in memory, are used in place.
+/// Other files are mapped into memory on platforms that support it, unless a
+/// function was set with `SetLoadFileFunction()`, and read by `LoadFile()`
+/// otherwise.
+/// @param[in] filename A UTF-8 C-string representing the file to load.
+/// @param[out] view Receives the contents of the file. Any file it referred
+/// to before is released.
+/// @return Returns `false` if the file couldn't be loaded (usually means it's
+/// not present, but can also mean there was a read error).
+bool LoadFileView(const char *filename, FileView *view);
+
 /// @brief Save a string to a file, overwriting the existing contents.
 /// @param[in] filename A UTF-8 C-string representing the file to save to.
 /// @param[in] data A const reference to a `std::string` containing the data
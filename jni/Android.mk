@@ -25,6 +25,12 @@ FPLBASE_DIR := $(LOCAL_PATH)
 
 FPLBASE_COMMON_SRC_FILES := \
   src/asset_manager.cpp \
+  src/asset_pack.cpp \
+  src/async_completion.cpp \
+  src/async_loader_common.cpp \
+  src/compressed_file.cpp \
+  src/file_system.cpp \
+  src/file_watcher.cpp \
   src/gpu_debug_gl.cpp \
   src/input.cpp \
   src/material.cpp \
@@ -32,6 +38,7 @@ FPLBASE_COMMON_SRC_FILES := \
   src/mesh_gl.cpp \
   src/precompiled.cpp \
   src/preprocessor.cpp \
+  src/read_mostly_mutex.cpp \
   src/render_target_common.cpp \
   src/render_target_gl.cpp \
   src/render_utils_gl.cpp \
@@ -40,6 +47,7 @@ FPLBASE_COMMON_SRC_FILES := \
   src/renderer_hmd_gl.cpp \
   src/shader_common.cpp \
   src/shader_gl.cpp \
+  src/texture_cache.cpp \
   src/texture_common.cpp \
   src/texture_gl.cpp \
   src/type_conversions_gl.cpp \
@@ -73,9 +81,12 @@ FPLBASE_SCHEMA_DIR := $(FPLBASE_DIR)/schemas
 FPLBASE_SCHEMA_INCLUDE_DIRS :=
 
 FPLBASE_SCHEMA_FILES := \
+  $(FPLBASE_SCHEMA_DIR)/asset_batch.fbs \
+  $(FPLBASE_SCHEMA_DIR)/asset_pack.fbs \
   $(FPLBASE_SCHEMA_DIR)/common.fbs \
   $(FPLBASE_SCHEMA_DIR)/materials.fbs \
   $(FPLBASE_SCHEMA_DIR)/mesh.fbs \
+  $(FPLBASE_SCHEMA_DIR)/prefetch_manifest.fbs \
   $(FPLBASE_SCHEMA_DIR)/shader.fbs \
   $(FPLBASE_SCHEMA_DIR)/texture_atlas.fbs
 
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "common_generated.h"
+#include "fplbase/file_system.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/utilities.h"
 #include "shader_generated.h"
@@ -43,38 +44,33 @@ static std::string ApplyVersion(const std::string& source,
   return versioned_source;
 }
 
-int RunShaderPipeline(const ShaderPipelineArgs& args) {
-  // Store the current load file function which we'll restore later.
-  fplbase::LoadFileFunction load_fn = fplbase::SetLoadFileFunction(nullptr);
-
-  // Provide a custom loader that will search include paths for files.  This
-  // loader will use the previous file loader for the actual loading operation.
-  fplbase::SetLoadFileFunction([&load_fn, &args](const char* filename,
-                                                 std::string* dest) {
-    // First try to load the file at the given path.
-    if (load_fn(filename, dest)) {
-      return true;
-    }
+// Mounted last, so that it's searched before the include dirs.
+static const char kWorkingDirectory[] = ".";
+
+// Whether `filename` is only found in the include dirs, which only #included
+// files are read from.
+static bool IsOnlyInIncludeDirs(const std::string& filename) {
+  const std::string path = fplbase::ResolveMountedPath(filename.c_str());
+  return path != filename &&
+         path != std::string(kWorkingDirectory) + "/" + filename;
+}
 
-    // Otherwise, try to load from each of the include dirs (but only for
-    // #included files).
-    if (args.vertex_shader.compare(filename) != 0 &&
-        args.fragment_shader.compare(filename) != 0) {
-      std::string path;
-      for (const auto& dir : args.include_dirs) {
-        path = dir;
-        if (path.back() != '/' && path.back() != '\\') {
-          path += '/';
-        }
-        path += filename;
-        if (load_fn(path.c_str(), dest)) {
-          return true;
-        }
+int RunShaderPipeline(const ShaderPipelineArgs& args) {
+  // Lets #included files be found in the include dirs, searched in order,
+  // after the working directory. The dirs are listed once, so looking for a
+  // file in one that doesn't have it doesn't touch the disk.
+  const bool mounted = !args.include_dirs.empty();
+  if (mounted) {
+    for (auto it = args.include_dirs.rbegin(); it != args.include_dirs.rend();
+         ++it) {
+      if (!fplbase::MountDirectory(*it)) {
+        printf("Unable to read include dir: %s\n", *it);
       }
     }
-
-    return false;
-  });
+    if (!fplbase::MountDirectory(kWorkingDirectory)) {
+      printf("Unable to read the working directory\n");
+    }
+  }
 
   // Read
   int status = 0;
@@ -82,7 +78,17 @@ int RunShaderPipeline(const ShaderPipelineArgs& args) {
   std::string fsh;
   std::string error_message;
   const char* const* defines = args.defines.data();
-  if (!fplbase::LoadFileWithDirectives(args.vertex_shader.c_str(), &vsh,
+  for (const std::string* shader : {&args.vertex_shader,
+                                     &args.fragment_shader}) {
+    if (!status && mounted && IsOnlyInIncludeDirs(*shader)) {
+      printf("Unable to load file: %s \nOnly #included files are read from "
+             "include dirs.\n", shader->c_str());
+      status = 1;
+    }
+  }
+
+  if (!status &&
+      !fplbase::LoadFileWithDirectives(args.vertex_shader.c_str(), &vsh,
                                        defines, &error_message)) {
     printf("Unable to load file: %s \n%s\n", args.vertex_shader.c_str(),
            error_message.c_str());
@@ -97,8 +103,13 @@ int RunShaderPipeline(const ShaderPipelineArgs& args) {
     status = 1;
   }
 
-  // Restore the previous load file function.
-  fplbase::SetLoadFileFunction(load_fn);
+  if (mounted) {
+    fplbase::Unmount(kWorkingDirectory);
+    for (auto it = args.include_dirs.begin(); it != args.include_dirs.end();
+         ++it) {
+      fplbase::Unmount(*it);
+    }
+  }
 
   if (status != 0) {
     return status;
@@ -13,12 +13,17 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include <unordered_set>
+#include "asset_batch_generated.h"
 #include "common_generated.h"
 #include "fplbase/asset_manager.h"
+#include "fplbase/asset_pack.h"
+#include "fplbase/file_system.h"
 #include "fplbase/texture.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/utilities.h"
 #include "mesh_generated.h"
+#include "prefetch_manifest_generated.h"
 
 using mathfu::mat4;
 using mathfu::vec2;
@@ -45,37 +50,119 @@ bool FileAsset::Finalize() {
 
 bool FileAsset::IsValid() { return true; }
 
-template <typename T>
-T FindInMap(const std::map<std::string, T> &map, const char *name) {
-  auto it = map.find(name);
+template <typename M>
+typename M::mapped_type FindInMap(const M &map, AssetId id) {
+  auto it = map.find(id);
   return it != map.end() ? it->second : 0;
 }
 
-template <typename T>
-void DestructAssetsInMap(std::map<std::string, T> &map) {
+template <typename M>
+void DestructAssetsInMap(M &map) {
   for (auto it = map.begin(); it != map.end(); ++it) {
     delete it->second;
   }
   map.clear();
 }
 
+template <typename M>
+AssetMemoryUsage SumMemoryUsage(const M &map) {
+  AssetMemoryUsage usage;
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    usage += it->second->MemoryUsage();
+  }
+  return usage;
+}
+
+static std::string AssetName(const AsyncAsset *asset) {
+  return asset->filename();
+}
+static std::string AssetName(const Asset *) { return std::string(); }
+
+static const char *const kAssetTypeNames[] = {
+    "shaders", "textures", "materials", "meshes", "texture atlases", "files",
+};
+static_assert(sizeof(kAssetTypeNames) / sizeof(kAssetTypeNames[0]) ==
+                  kAssetTypeCount,
+              "kAssetTypeNames doesn't match AssetType");
+
+static_assert(
+    kAssetTypeShader == static_cast<AssetType>(batchdef::AssetType_Shader) &&
+        kAssetTypeTexture ==
+            static_cast<AssetType>(batchdef::AssetType_Texture) &&
+        kAssetTypeMaterial ==
+            static_cast<AssetType>(batchdef::AssetType_Material) &&
+        kAssetTypeMesh == static_cast<AssetType>(batchdef::AssetType_Mesh),
+    "batchdef::AssetType doesn't match AssetType");
+
+static_assert(
+    kAssetTypeShader ==
+            static_cast<AssetType>(prefetchdef::AssetType_Shader) &&
+        kAssetTypeTexture ==
+            static_cast<AssetType>(prefetchdef::AssetType_Texture) &&
+        kAssetTypeMesh == static_cast<AssetType>(prefetchdef::AssetType_Mesh),
+    "prefetchdef::AssetType doesn't match AssetType");
+
 AssetManager::AssetManager(Renderer &renderer)
-    : renderer_(renderer), texture_scale_(mathfu::kOnes2f) {
+    : renderer_(renderer),
+      material_mutex_(fplutil::Mutex::kModeRecursive),
+      texture_scale_(mathfu::kOnes2f),
+      texture_deduplication_(false),
+      num_frames_(0),
+      recording_loads_(false),
+      recording_start_frame_(0),
+      prefetching_(false),
+      batch_(nullptr),
+      has_memory_budget_(false),
+      use_clock_(0) {
+  for (int i = 0; i < kAssetTypeCount; ++i) {
+    memory_budgets_[i] = kNoMemoryBudget;
+  }
   // Empty material for default case.
-  material_map_[""] = new Material();
+  material_map_[IdOf("")] = new Material();
+}
+
+AssetId AssetManager::IdOf(const char *name) {
+  const AssetId id = AssetId::FromName(name);
+#ifndef NDEBUG
+  fplutil::MutexLock lock(material_mutex_);
+  auto it = asset_names_.insert(std::make_pair(id, std::string(name))).first;
+  if (it->second != name) {
+    LogError("Asset names \"%s\" and \"%s\" have the same AssetId.",
+             it->second.c_str(), name);
+    assert(false);
+  }
+#endif
+  return id;
 }
 
 void AssetManager::ClearAllAssets() {
+  fplutil::MutexLock lock(material_mutex_);
+  // Stops listening to the assets, which are about to go away.
+  pending_batches_.clear();
+  ReadMostlyMutex::WriteLock map_lock(map_mutex_);
   DestructAssetsInMap(material_map_);
   DestructAssetsInMap(texture_atlas_map_);
   DestructAssetsInMap(mesh_map_);
   DestructAssetsInMap(shader_map_);
   DestructAssetsInMap(texture_map_);
   DestructAssetsInMap(file_map_);
+  // Unloaded textures that lived on for the textures sharing them.
+  fplutil::MutexLock sharing_lock(texture_sharing_mutex_);
+  for (auto it = texture_sharing_.begin(); it != texture_sharing_.end();
+       ++it) {
+    if (it->second.unloaded) delete it->first;
+  }
+  texture_sharing_.clear();
+  texture_contents_.clear();
+  prefetched_ids_.clear();
 }
 
 Shader *AssetManager::FindShader(const char *basename) {
-  return FindInMap(shader_map_, basename);
+  return FindShader(AssetId::FromName(basename));
+}
+
+Shader *AssetManager::FindShader(AssetId id) {
+  return FindAsset(shader_map_, id);
 }
 
 Shader *AssetManager::LoadShaderHelper(
@@ -87,7 +174,21 @@ Shader *AssetManager::LoadShaderHelper(
     shader = new Shader(basename, local_defines, &renderer_);
   }
   shader->UpdateGlobalDefines(defines_to_add_, defines_to_omit_);
-  return found ? shader : LoadOrQueue(shader, shader_map_, async, alias);
+  // Only plain shaders can be prefetched by name.
+  if (local_defines.empty() && alias == nullptr) {
+    NoteRequest(kAssetTypeShader, basename, shader, !found);
+  }
+  if (!found) {
+    if (file_watcher_) {
+      fplutil::MutexLock lock(material_mutex_);
+      unwatched_shaders_.push_back(
+          AssetId::FromName(alias != nullptr ? alias : basename));
+    }
+    return LoadOrQueue(shader, shader_map_, async, alias);
+  }
+  // Requested async earlier, but needed now: don't load it twice.
+  if (!async && !shader->IsFinalized()) loader_.LoadJobNow(shader);
+  return shader;
 }
 
 Shader *AssetManager::LoadShader(const char *basename,
@@ -131,83 +232,972 @@ Shader *AssetManager::LoadShaderDef(const char *filename) {
   if (shader) return shader;
   shader = Shader::LoadFromShaderDef(filename);
   if (!shader) return nullptr;
-  shader_map_[filename] = shader;
+  InsertAsset(shader_map_, IdOf(filename), shader);
   return shader;
 }
 
 void AssetManager::UnloadShader(const char *filename) {
   auto shader = FindShader(filename);
   if (!shader || shader->DecreaseRefCount()) return;
-  loader_.AbortJob(shader);
-  shader_map_.erase(filename);
-  delete shader;
+  EraseAsset(shader_map_, AssetId::FromName(filename));
+  // Doesn't wait for a load in progress, the loader deletes it when done.
+  loader_.AbortJobAndDelete(shader);
 }
 
 Texture *AssetManager::FindTexture(const char *filename) {
-  return FindInMap(texture_map_, filename);
+  return FindTexture(AssetId::FromName(filename));
+}
+
+Texture *AssetManager::FindTexture(AssetId id) {
+  return FindAsset(texture_map_, id);
 }
 
 Texture *AssetManager::LoadTexture(const char *filename, TextureFormat format,
                                    TextureFlags flags) {
-  auto tex = FindTexture(filename);
-  if (tex) return tex;
-  tex = new Texture(filename, format, flags);
-  return LoadOrQueue(tex, texture_map_, (flags & kTextureFlagsLoadAsync) != 0,
-                     nullptr /* alias */);
+  std::vector<Texture *> load_now;
+  Texture *tex = LoadTexture(filename, format, flags, &load_now);
+  for (auto it = load_now.begin(); it != load_now.end(); ++it) {
+    loader_.LoadJobNow(*it);
+  }
+  return tex;
+}
+
+Texture *AssetManager::LoadTexture(const char *filename, TextureFormat format,
+                                   TextureFlags flags,
+                                   std::vector<Texture *> *load_now) {
+  const bool async = (flags & kTextureFlagsLoadAsync) != 0;
+  Texture *tex;
+  {
+    fplutil::MutexLock lock(material_mutex_);
+    tex = FindTexture(filename);
+    if (!tex) {
+      tex = new Texture(filename, format, flags);
+      if (texture_deduplication_) {
+        tex->set_dedup_fn([this](uint64_t content_hash, Texture *texture) {
+          return ShareTexture(content_hash, texture);
+        });
+      }
+      if (texture_cache_) tex->set_cache(texture_cache_);
+      NoteRequest(kAssetTypeTexture, filename, tex, true, format, flags);
+      if (file_watcher_) {
+        WatchFile(filename, kAssetTypeTexture, AssetId::FromName(filename));
+      }
+      LoadOrQueue(tex, texture_map_, async, nullptr /* alias */);
+      if (async || !texture_deduplication_ || !tex->content_hash() ||
+          tex->original() || !tex->IsValid()) {
+        return tex;
+      }
+      // Only now that it is finalized may other textures share it.
+      fplutil::MutexLock sharing_lock(texture_sharing_mutex_);
+      if (texture_contents_.insert(std::make_pair(tex->content_hash(), tex))
+              .second) {
+        TextureSharing sharing = {tex->content_hash(), nullptr, 0, false};
+        texture_sharing_[tex] = sharing;
+      }
+      return tex;
+    }
+    NoteRequest(kAssetTypeTexture, filename, tex, false, format, flags);
+  }
+  // Requested async earlier, but needed now: don't load it twice.
+  if (!async && !tex->IsFinalized()) load_now->push_back(tex);
+  return tex;
+}
+
+void AssetManager::SetTextureCache(const char *directory) {
+  // Textures ask this on loader threads, which can't look up the device
+  // on Android, so make sure it is known by then.
+  MipmapGeneration16bppSupported();
+  fplutil::MutexLock lock(material_mutex_);
+  texture_cache_.reset(directory ? new TextureCache(directory) : nullptr);
+}
+
+Texture *AssetManager::ShareTexture(uint64_t content_hash, Texture *tex) {
+  fplutil::MutexLock lock(texture_sharing_mutex_);
+  // Textures that are reloaded, see ReloadTexture(), don't share.
+  if (tex->IsLoadCancelled() || tex->IsFinalized()) return tex;
+  const bool async = (tex->flags() & kTextureFlagsLoadAsync) != 0;
+  auto it = texture_contents_.find(content_hash);
+  if (it == texture_contents_.end()) {
+    // Textures loaded synchronously are added by LoadTexture() once
+    // finalized.
+    if (async) {
+      texture_contents_[content_hash] = tex;
+      TextureSharing sharing = {content_hash, nullptr, 0, false};
+      texture_sharing_[tex] = sharing;
+    }
+    return tex;
+  }
+  Texture *original = it->second;
+  if (async) {
+    // Makes sure the original is finalized first.
+    loader_.AddDependency(tex, original);
+  } else if (!original->IsFinalized()) {
+    // Synchronous loads run on the main thread, which finalizes all others.
+    return tex;
+  }
+  ++texture_sharing_[original].num_sharers;
+  TextureSharing sharing = {content_hash, original, 0, false};
+  texture_sharing_[tex] = sharing;
+  return original;
+}
+
+bool AssetManager::IsTextureShared(Texture *tex) {
+  fplutil::MutexLock lock(texture_sharing_mutex_);
+  auto it = texture_sharing_.find(tex);
+  return it != texture_sharing_.end() && it->second.num_sharers > 0;
+}
+
+void AssetManager::DestroyTexture(Texture *tex) {
+  Texture *unloaded_original = nullptr;
+  {
+    fplutil::MutexLock lock(texture_sharing_mutex_);
+    auto it = texture_sharing_.find(tex);
+    if (it != texture_sharing_.end()) {
+      if (it->second.num_sharers > 0) {
+        it->second.unloaded = true;
+        return;
+      }
+      Texture *original = it->second.original;
+      if (original) {
+        TextureSharing &shared = texture_sharing_[original];
+        if (--shared.num_sharers == 0 && shared.unloaded) {
+          unloaded_original = original;
+        }
+      } else {
+        texture_contents_.erase(it->second.content_hash);
+      }
+      texture_sharing_.erase(it);
+    }
+  }
+  // Doesn't wait for a load in progress, the loader deletes it when done.
+  loader_.AbortJobAndDelete(tex);
+  if (unloaded_original) DestroyTexture(unloaded_original);
 }
 
 void AssetManager::StartLoadingTextures() { loader_.StartLoading(); }
 
 void AssetManager::StopLoadingTextures() { loader_.PauseLoading(); }
 
-bool AssetManager::TryFinalize() { return loader_.TryFinalize(); }
+bool AssetManager::TryFinalize() {
+  ++num_frames_;
+  ++use_clock_;
+  ReloadChangedAssets();
+  const bool done = loader_.TryFinalize();
+  ForgetFinishedBatches();
+  EvictUnusedAssets();
+  return done;
+}
+
+bool AssetManager::TryFinalize(const FinalizeBudget &budget,
+                               FinalizeStatus *status) {
+  ++num_frames_;
+  ++use_clock_;
+  ReloadChangedAssets();
+  const bool done = loader_.TryFinalize(budget, status);
+  ForgetFinishedBatches();
+  EvictUnusedAssets();
+  return done;
+}
+
+void AssetManager::SetMemoryBudget(AssetType type, size_t bytes) {
+  assert(type >= 0 && type < kAssetTypeCount);
+  memory_budgets_[type] = bytes;
+  has_memory_budget_ = false;
+  for (int i = 0; i < kAssetTypeCount; ++i) {
+    if (memory_budgets_[i] != kNoMemoryBudget) has_memory_budget_ = true;
+  }
+}
+
+template <typename T>
+size_t AssetManager::EvictLeastRecentlyUsed(
+    AssetMap<T> &asset_map, size_t budget,
+    const std::function<bool(T *)> &can_evict,
+    const std::function<void(T *)> &destroy) {
+  if (budget == kNoMemoryBudget) return 0;
+  size_t usage = 0;
+  std::vector<std::pair<uint64_t, AssetId>> candidates;
+  for (auto it = asset_map.begin(); it != asset_map.end(); ++it) {
+    T *asset = it->second;
+    usage += asset->MemoryUsage().total();
+    // Owners that called IncreaseRefCount() unload the asset themselves.
+    if (asset->handle_count() == 0 && asset->refcount_ == 1 &&
+        can_evict(asset)) {
+      candidates.push_back(
+          std::make_pair(asset->last_used_.load(), it->first));
+    }
+  }
+  if (usage <= budget) return 0;
+  std::sort(candidates.begin(), candidates.end());
+  size_t freed = 0;
+  for (auto it = candidates.begin(); it != candidates.end() && usage > budget;
+       ++it) {
+    T *asset = asset_map.find(it->second)->second;
+    const size_t bytes = asset->MemoryUsage().total();
+    EraseAsset(asset_map, it->second);
+    destroy(asset);
+    usage -= bytes;
+    freed += bytes;
+  }
+  return freed;
+}
+
+size_t AssetManager::EvictUnusedAssets() {
+  if (!has_memory_budget_) return 0;
+  fplutil::MutexLock lock(material_mutex_);
+  size_t freed = 0;
+
+  // Materials a mesh created from its own definitions aren't in
+  // material_map_, so are deleted with the mesh.
+  std::unordered_set<Material *> shared_materials;
+  bool meshes_loading = false;
+  for (auto it = material_map_.begin(); it != material_map_.end(); ++it) {
+    shared_materials.insert(it->second);
+  }
+  for (auto it = mesh_map_.begin(); it != mesh_map_.end(); ++it) {
+    if (!it->second->IsFinalized()) meshes_loading = true;
+  }
+  freed += EvictLeastRecentlyUsed<Mesh>(
+      mesh_map_, memory_budgets_[kAssetTypeMesh],
+      [](Mesh *mesh) { return mesh->IsFinalized(); },
+      [this, &shared_materials](Mesh *mesh) {
+        for (size_t i = 0; i < mesh->num_index_arrays(); ++i) {
+          Material *mat = mesh->GetMaterial(static_cast<int>(i));
+          if (shared_materials.count(mat) == 0) delete mat;
+        }
+        loader_.AbortJobAndDelete(mesh);
+      });
+
+  freed += EvictLeastRecentlyUsed<Shader>(
+      shader_map_, memory_budgets_[kAssetTypeShader],
+      [](Shader *shader) { return shader->IsFinalized(); },
+      [this](Shader *shader) { loader_.AbortJobAndDelete(shader); });
+  freed += EvictLeastRecentlyUsed<FileAsset>(
+      file_map_, memory_budgets_[kAssetTypeFile],
+      [](FileAsset *file) { return file->IsFinalized(); },
+      [this](FileAsset *file) { loader_.AbortJobAndDelete(file); });
+
+  // A mesh that is still loading may be creating materials and textures that
+  // nothing refers to yet, so leave those alone until it is done.
+  if (meshes_loading) return freed;
+
+  std::unordered_set<const Asset *> used;
+  for (auto it = mesh_map_.begin(); it != mesh_map_.end(); ++it) {
+    Mesh *mesh = it->second;
+    for (size_t i = 0; i < mesh->num_index_arrays(); ++i) {
+      used.insert(mesh->GetMaterial(static_cast<int>(i)));
+    }
+  }
+  freed += EvictLeastRecentlyUsed<Material>(
+      material_map_, memory_budgets_[kAssetTypeMaterial],
+      [&used](Material *mat) { return used.count(mat) == 0; },
+      [](Material *mat) { delete mat; });
+  freed += EvictLeastRecentlyUsed<TextureAtlas>(
+      texture_atlas_map_, memory_budgets_[kAssetTypeTextureAtlas],
+      [](TextureAtlas *) { return true; },
+      [](TextureAtlas *atlas) {
+        // The texture stays in texture_map_, and is evicted separately.
+        atlas->set_atlas_texture(nullptr);
+        delete atlas;
+      });
+
+  used.clear();
+  auto use_textures = [&used](const Material *mat) {
+    if (!mat) return;
+    used.insert(mat->textures().begin(), mat->textures().end());
+  };
+  for (auto it = material_map_.begin(); it != material_map_.end(); ++it) {
+    use_textures(it->second);
+  }
+  for (auto it = mesh_map_.begin(); it != mesh_map_.end(); ++it) {
+    Mesh *mesh = it->second;
+    for (size_t i = 0; i < mesh->num_index_arrays(); ++i) {
+      use_textures(mesh->GetMaterial(static_cast<int>(i)));
+    }
+  }
+  for (auto it = texture_atlas_map_.begin(); it != texture_atlas_map_.end();
+       ++it) {
+    used.insert(it->second->atlas_texture());
+  }
+  freed += EvictLeastRecentlyUsed<Texture>(
+      texture_map_, memory_budgets_[kAssetTypeTexture],
+      [this, &used](Texture *tex) {
+        return tex->IsFinalized() && used.count(tex) == 0 &&
+               !IsTextureShared(tex);
+      },
+      [this](Texture *tex) { DestroyTexture(tex); });
+  return freed;
+}
+
+AssetMemoryUsage AssetManager::GetMemoryUsage(AssetType type) {
+  fplutil::MutexLock lock(material_mutex_);
+  switch (type) {
+    case kAssetTypeShader:
+      return SumMemoryUsage(shader_map_);
+    case kAssetTypeTexture:
+      return SumMemoryUsage(texture_map_);
+    case kAssetTypeMaterial:
+      return SumMemoryUsage(material_map_);
+    case kAssetTypeMesh:
+      return SumMemoryUsage(mesh_map_);
+    case kAssetTypeTextureAtlas:
+      return SumMemoryUsage(texture_atlas_map_);
+    case kAssetTypeFile:
+      return SumMemoryUsage(file_map_);
+    case kAssetTypeCount:
+      break;
+  }
+  assert(false);
+  return AssetMemoryUsage();
+}
+
+template <typename T>
+void AssetManager::GetMemoryRecords(const AssetMap<T> &asset_map,
+                                    AssetType type,
+                                    std::vector<AssetMemoryRecord> *records) {
+  for (auto it = asset_map.begin(); it != asset_map.end(); ++it) {
+    AssetMemoryRecord record;
+    record.type = type;
+    record.id = it->first;
+    record.name = AssetName(it->second);
+#ifndef NDEBUG
+    if (record.name.empty()) {
+      auto name = asset_names_.find(it->first);
+      if (name != asset_names_.end()) record.name = name->second;
+    }
+#endif
+    record.asset = it->second;
+    record.usage = it->second->MemoryUsage();
+    records->push_back(record);
+  }
+}
+
+std::vector<AssetMemoryRecord> AssetManager::GetLargestAssets(size_t count) {
+  std::vector<AssetMemoryRecord> records;
+  {
+    fplutil::MutexLock lock(material_mutex_);
+    GetMemoryRecords(shader_map_, kAssetTypeShader, &records);
+    GetMemoryRecords(texture_map_, kAssetTypeTexture, &records);
+    GetMemoryRecords(material_map_, kAssetTypeMaterial, &records);
+    GetMemoryRecords(mesh_map_, kAssetTypeMesh, &records);
+    GetMemoryRecords(texture_atlas_map_, kAssetTypeTextureAtlas, &records);
+    GetMemoryRecords(file_map_, kAssetTypeFile, &records);
+  }
+  count = std::min(count, records.size());
+  std::partial_sort(records.begin(), records.begin() + count, records.end(),
+                    [](const AssetMemoryRecord &a, const AssetMemoryRecord &b) {
+                      return a.usage.total() > b.usage.total();
+                    });
+  records.resize(count);
+  return records;
+}
+
+void AssetManager::LogMemoryUsage(size_t count) {
+  const double kKiB = 1024.0;
+  AssetMemoryUsage total;
+  for (int i = 0; i < kAssetTypeCount; ++i) {
+    const AssetMemoryUsage usage = GetMemoryUsage(static_cast<AssetType>(i));
+    LogInfo("%-16s gpu %10.1f KiB  cpu %10.1f KiB", kAssetTypeNames[i],
+            usage.gpu_bytes / kKiB, usage.cpu_bytes / kKiB);
+    total += usage;
+  }
+  LogInfo("%-16s gpu %10.1f KiB  cpu %10.1f KiB", "total",
+          total.gpu_bytes / kKiB, total.cpu_bytes / kKiB);
+  const std::vector<AssetMemoryRecord> largest = GetLargestAssets(count);
+  for (auto it = largest.begin(); it != largest.end(); ++it) {
+    LogInfo("%10.1f KiB (gpu %.1f KiB) %s %s", it->usage.total() / kKiB,
+            it->usage.gpu_bytes / kKiB, kAssetTypeNames[it->type],
+            it->name.empty() ? "(unnamed)" : it->name.c_str());
+  }
+}
+
+void AssetManager::NoteRequest(AssetType type, const char *name,
+                               AsyncAsset *asset, bool created,
+                               TextureFormat format, TextureFlags flags) {
+  fplutil::MutexLock lock(material_mutex_);
+  const AssetId id = AssetId::FromName(name);
+  auto prefetched = prefetched_ids_.find(id);
+  if (prefetched != prefetched_ids_.end()) {
+    if (created) {
+      // Either PrefetchAssets() is creating it, or it was evicted, or
+      // unloaded, before the app got to it.
+      if (prefetching_) return;
+    } else {
+      ++prefetch_stats_.num_requested;
+      // What the app asks for goes before the rest of the prefetch.
+      if (prefetched->second < kLoadPriorityNormal) {
+        loader_.SetJobPriority(asset, kLoadPriorityNormal);
+      }
+    }
+    prefetched_ids_.erase(prefetched);
+  }
+  if (!recording_loads_ || !recorded_ids_.insert(id).second) return;
+  RecordedLoad load = {
+      type, name, format,
+      static_cast<TextureFlags>(flags & ~kTextureFlagsLoadAsync),
+      num_frames_ - recording_start_frame_};
+  recorded_loads_.push_back(load);
+}
+
+void AssetManager::StartRecordingLoads() {
+  fplutil::MutexLock lock(material_mutex_);
+  recorded_loads_.clear();
+  recorded_ids_.clear();
+  recording_start_frame_ = num_frames_;
+  recording_loads_ = true;
+}
+
+void AssetManager::StopRecordingLoads() {
+  fplutil::MutexLock lock(material_mutex_);
+  recording_loads_ = false;
+}
+
+// The size of the files `name` loads from, or 0 if they can't be found.
+static uint64_t AssetFileSize(AssetType type, const std::string &name) {
+  static const char *const kShaderExtensions[] = {".glslv", ".glslf"};
+  uint64_t size = 0;
+  FileView view;
+  if (type == kAssetTypeShader) {
+    for (size_t i = 0; i < 2; ++i) {
+      if (LoadFileView((name + kShaderExtensions[i]).c_str(), &view)) {
+        size += view.size();
+      }
+    }
+  } else if (LoadFileView(name.c_str(), &view)) {
+    size = view.size();
+  }
+  return size;
+}
+
+bool AssetManager::SaveLoadRecording(const char *filename) {
+  std::vector<RecordedLoad> loads;
+  {
+    fplutil::MutexLock lock(material_mutex_);
+    loads = recorded_loads_;
+  }
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<flatbuffers::Offset<prefetchdef::PrefetchEntry>> entries;
+  for (auto it = loads.begin(); it != loads.end(); ++it) {
+    entries.push_back(prefetchdef::CreatePrefetchEntry(
+        fbb, static_cast<prefetchdef::AssetType>(it->type),
+        fbb.CreateString(it->name), it->format, it->flags,
+        AssetFileSize(it->type, it->name), it->frame));
+  }
+  auto manifest =
+      prefetchdef::CreatePrefetchManifest(fbb, fbb.CreateVector(entries));
+  prefetchdef::FinishPrefetchManifestBuffer(fbb, manifest);
+  return SaveFile(filename, fbb.GetBufferPointer(), fbb.GetSize());
+}
+
+bool AssetManager::PrefetchAssets(const char *filename, uint32_t max_frame,
+                                  size_t max_bytes, LoadPriority priority) {
+  FileView view;
+  if (!LoadFileView(filename, &view)) return false;
+  flatbuffers::Verifier verifier(view.data(), view.size());
+  if (!prefetchdef::VerifyPrefetchManifestBuffer(verifier)) {
+    LogError("Corrupt prefetch manifest: %s", filename);
+    return false;
+  }
+  auto entries = prefetchdef::GetPrefetchManifest(view.data())->entries();
+  if (!entries) return true;
+  size_t bytes = 0;
+  for (auto it = entries->begin(); it != entries->end(); ++it) {
+    if (it->first_use_frame() > max_frame) continue;
+    if (!it->name()) continue;
+    const char *name = it->name()->c_str();
+    const AssetType type = static_cast<AssetType>(it->type());
+    AsyncAsset *existing = nullptr;
+    switch (type) {
+      case kAssetTypeShader:
+        existing = FindShader(name);
+        break;
+      case kAssetTypeTexture:
+        existing = FindTexture(name);
+        break;
+      case kAssetTypeMesh:
+        existing = FindMesh(name);
+        break;
+      default:
+        // Written by a newer version.
+        continue;
+    }
+    if (existing) continue;
+    const size_t size = static_cast<size_t>(it->file_size());
+    if (size > max_bytes - bytes) break;
+    bytes += size;
+
+    {
+      fplutil::MutexLock lock(material_mutex_);
+      prefetched_ids_[AssetId::FromName(name)] = priority;
+      prefetching_ = true;
+      ++prefetch_stats_.num_prefetched;
+      prefetch_stats_.bytes_prefetched += size;
+    }
+    AsyncAsset *asset = nullptr;
+    switch (type) {
+      case kAssetTypeShader:
+        asset = LoadShader(name, true /* async */);
+        break;
+      case kAssetTypeTexture:
+        asset = LoadTexture(
+            name, static_cast<TextureFormat>(it->texture_format()),
+            static_cast<TextureFlags>(it->texture_flags() |
+                                      kTextureFlagsLoadAsync));
+        break;
+      default:
+        asset = LoadMesh(name, true /* async */);
+        break;
+    }
+    loader_.SetJobPriority(asset, priority);
+    fplutil::MutexLock lock(material_mutex_);
+    prefetching_ = false;
+  }
+  return true;
+}
+
+PrefetchStats AssetManager::prefetch_stats() {
+  fplutil::MutexLock lock(material_mutex_);
+  return prefetch_stats_;
+}
+
+// Where the file of an asset is stored, to read files in order.
+struct FileLocation {
+  // The mounted asset pack holding the file, if any, and where in it.
+  std::string pack;
+  const uint8_t *data;
+  std::string file;
+
+  bool operator<(const FileLocation &other) const {
+    // Packed files first, since reading them is cheapest.
+    if (pack.empty() != other.pack.empty()) return other.pack.empty();
+    if (pack != other.pack) return pack < other.pack;
+    if (data != other.data) return data < other.data;
+    return file < other.file;
+  }
+};
+
+// Shaders are named without an extension, so they're only found by path.
+static FileLocation LocateFile(const AsyncAsset *asset) {
+  FileLocation location;
+  location.file = asset->filename();
+  std::shared_ptr<const AssetPack> pack;
+  size_t size = 0;
+  location.data = FindInAssetPacks(location.file.c_str(), &size, &pack);
+  if (pack) location.pack = pack->filename();
+  return location;
+}
+
+bool AssetManager::LoadBatch(const char *filename,
+                             const BatchCallback &callback,
+                             LoadPriority priority) {
+  FileView view;
+  if (!LoadFileView(filename, &view)) return false;
+  flatbuffers::Verifier verifier(view.data(), view.size());
+  if (!batchdef::VerifyAssetBatchBuffer(verifier)) {
+    LogError("Corrupt asset batch: %s", filename);
+    return false;
+  }
+  auto entries = batchdef::GetAssetBatch(view.data())->entries();
+  std::unique_ptr<PendingBatch> batch(new PendingBatch());
+  batch->callback = callback;
+  std::vector<AsyncAsset *> queued;
+  {
+    fplutil::MutexLock lock(material_mutex_);
+    batch_ = &queued;
+    for (flatbuffers::uoffset_t i = 0; entries && i < entries->size(); ++i) {
+      const batchdef::BatchEntry *entry = entries->Get(i);
+      const char *name = entry->name()->c_str();
+      ++batch->progress.num_assets;
+      Asset *asset = nullptr;
+      switch (entry->type()) {
+        case batchdef::AssetType_Shader:
+          batch->assets.push_back(LoadShader(name, true /* async */));
+          asset = batch->assets.back();
+          break;
+        case batchdef::AssetType_Texture:
+          batch->assets.push_back(LoadTexture(
+              name, static_cast<TextureFormat>(entry->texture_format()),
+              static_cast<TextureFlags>(entry->texture_flags() |
+                                        kTextureFlagsLoadAsync)));
+          asset = batch->assets.back();
+          break;
+        case batchdef::AssetType_Material:
+          if (Material *mat = LoadMaterial(name, true /* async */)) {
+            batch->materials.push_back(mat);
+            asset = mat;
+          } else {
+            ++batch->progress.num_failed;
+          }
+          break;
+        case batchdef::AssetType_Mesh:
+          batch->assets.push_back(LoadMesh(name, true /* async */));
+          asset = batch->assets.back();
+          break;
+        default:
+          // Written by a newer version.
+          ++batch->progress.num_failed;
+          break;
+      }
+      // Kept until the callback was called, so that neither eviction nor
+      // unloading deletes it while the group listens to it.
+      if (asset) {
+        asset->IncreaseRefCount();
+        batch->pinned.push_back(
+            std::make_pair(static_cast<AssetType>(entry->type()), name));
+      }
+    }
+    batch_ = nullptr;
+  }
+
+  // Queued in the order their files are stored, so they're read
+  // sequentially.
+  std::vector<std::pair<FileLocation, AsyncAsset *>> locations;
+  for (auto it = queued.begin(); it != queued.end(); ++it) {
+    locations.push_back(std::make_pair(LocateFile(*it), *it));
+  }
+  std::stable_sort(
+      locations.begin(), locations.end(),
+      [](const std::pair<FileLocation, AsyncAsset *> &a,
+         const std::pair<FileLocation, AsyncAsset *> &b) {
+        return a.first < b.first;
+      });
+  for (size_t i = 0; i < locations.size(); ++i) {
+    queued[i] = locations[i].second;
+  }
+  loader_.QueueJobs(queued, priority);
+  batch->progress.num_queued = static_cast<int>(queued.size());
+
+  // Waits for the listed assets, and the textures of the materials, once
+  // each.
+  std::vector<AsyncAsset *> waited_for(batch->assets);
+  for (auto mat = batch->materials.begin(); mat != batch->materials.end();
+       ++mat) {
+    const std::vector<Texture *> &textures = (*mat)->textures();
+    waited_for.insert(waited_for.end(), textures.begin(), textures.end());
+  }
+  std::sort(waited_for.begin(), waited_for.end());
+  waited_for.erase(std::unique(waited_for.begin(), waited_for.end()),
+                   waited_for.end());
+  batch->group.reset(new WhenAll(waited_for));
+  pending_batches_.push_back(std::move(batch));
+  PendingBatch *pending = pending_batches_.back().get();
+  pending->group->Then(pending);
+  return true;
+}
+
+void AssetManager::PendingBatch::OnFinalized() {
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    if ((*it)->IsValid()) {
+      ++progress.num_loaded;
+    } else {
+      ++progress.num_failed;
+    }
+  }
+  for (auto mat = materials.begin(); mat != materials.end(); ++mat) {
+    const std::vector<Texture *> &textures = (*mat)->textures();
+    bool valid = true;
+    for (auto tex = textures.begin(); tex != textures.end(); ++tex) {
+      valid = valid && (*tex)->IsValid();
+    }
+    if (valid) {
+      ++progress.num_loaded;
+    } else {
+      ++progress.num_failed;
+    }
+  }
+  done = true;
+  if (callback) callback(progress);
+}
+
+void AssetManager::ForgetFinishedBatches() {
+  for (auto it = pending_batches_.begin(); it != pending_batches_.end();
+       ++it) {
+    if (!(*it)->done) continue;
+    // Unloads what was unloaded while the batch loaded.
+    const std::vector<std::pair<AssetType, std::string>> &pinned =
+        (*it)->pinned;
+    for (auto pin = pinned.begin(); pin != pinned.end(); ++pin) {
+      const char *name = pin->second.c_str();
+      switch (pin->first) {
+        case kAssetTypeShader:
+          UnloadShader(name);
+          break;
+        case kAssetTypeTexture:
+          UnloadTexture(name);
+          break;
+        case kAssetTypeMaterial:
+          UnloadMaterial(name);
+          break;
+        case kAssetTypeMesh:
+          UnloadMesh(name);
+          break;
+        default:
+          assert(false);
+          break;
+      }
+    }
+  }
+  pending_batches_.erase(
+      std::remove_if(pending_batches_.begin(), pending_batches_.end(),
+                     [](const std::unique_ptr<PendingBatch> &batch) {
+                       return batch->done;
+                     }),
+      pending_batches_.end());
+}
+
+bool AssetManager::SetHotReload(bool enable) {
+  fplutil::MutexLock lock(material_mutex_);
+  file_watcher_.reset();
+  watched_files_.clear();
+  watched_paths_.clear();
+  unwatched_shaders_.clear();
+  pending_reloads_.clear();
+  if (!enable) return true;
+  if (!FileWatcher::IsSupported()) return false;
+  file_watcher_.reset(new FileWatcher());
+  // Materials don't know their file names, so only the ones loaded from now
+  // on are watched.
+  for (auto it = texture_map_.begin(); it != texture_map_.end(); ++it) {
+    WatchFile(it->second->filename(), kAssetTypeTexture, it->first);
+  }
+  for (auto it = shader_map_.begin(); it != shader_map_.end(); ++it) {
+    unwatched_shaders_.push_back(it->first);
+  }
+  return true;
+}
+
+void AssetManager::WatchFile(const std::string &file, AssetType type,
+                             AssetId id) {
+  const std::string path = ResolveMountedPath(file.c_str());
+  if (path.empty() || !file_watcher_->Watch(path.c_str())) return;
+  watched_paths_[path] = file;
+  std::vector<AssetKey> &assets = watched_files_[file];
+  const AssetKey key(type, id);
+  if (std::find(assets.begin(), assets.end(), key) == assets.end()) {
+    assets.push_back(key);
+  }
+}
+
+int AssetManager::ReloadChangedAssets() {
+  if (!file_watcher_) return 0;
+  fplutil::MutexLock lock(material_mutex_);
+  // Which files a shader #includes is only known once it is loaded.
+  for (size_t i = 0; i < unwatched_shaders_.size();) {
+    const AssetId id = unwatched_shaders_[i];
+    Shader *shader = FindInMap(shader_map_, id);
+    if (shader && !shader->IsFinalized()) {
+      ++i;
+      continue;
+    }
+    if (shader) {
+      const std::set<std::string> &files = shader->source_files();
+      for (auto it = files.begin(); it != files.end(); ++it) {
+        WatchFile(*it, kAssetTypeShader, id);
+      }
+    }
+    unwatched_shaders_[i] = unwatched_shaders_.back();
+    unwatched_shaders_.pop_back();
+  }
+
+  int num_reloaded = 0;
+  std::vector<std::string> changed;
+  file_watcher_->Poll(&changed);
+  // E.g. a shader may now #include a file that was missing before.
+  if (!changed.empty()) ForgetMissingFiles();
+  for (auto path = changed.begin(); path != changed.end(); ++path) {
+    auto watched_path = watched_paths_.find(*path);
+    if (watched_path == watched_paths_.end()) continue;
+    const std::string &file = watched_path->second;
+    auto watched = watched_files_.find(file);
+    if (watched == watched_files_.end()) continue;
+    const std::vector<AssetKey> &assets = watched->second;
+    for (auto key = assets.begin(); key != assets.end(); ++key) {
+      if (key->first == kAssetTypeMaterial) {
+        // Never busy, so reloaded right away.
+        Material *mat = FindInMap(material_map_, key->second);
+        if (mat) {
+          ReloadMaterial(mat, file.c_str());
+          ++num_reloaded;
+        }
+      } else if (std::find(pending_reloads_.begin(), pending_reloads_.end(),
+                           *key) == pending_reloads_.end()) {
+        pending_reloads_.push_back(*key);
+      }
+    }
+  }
+
+  // Assets that are still loading are reloaded once they're done.
+  std::vector<AssetKey> still_loading;
+  for (auto key = pending_reloads_.begin(); key != pending_reloads_.end();
+       ++key) {
+    bool reloaded = true;
+    if (key->first == kAssetTypeShader) {
+      Shader *shader = FindInMap(shader_map_, key->second);
+      if (!shader) continue;
+      // Files it started to #include since it was last changed.
+      const std::set<std::string> &files = shader->source_files();
+      for (auto it = files.begin(); it != files.end(); ++it) {
+        WatchFile(*it, kAssetTypeShader, key->second);
+      }
+      reloaded = loader_.ReloadJob(shader);
+    } else {
+      Texture *tex = FindInMap(texture_map_, key->second);
+      if (!tex) continue;
+      reloaded = ReloadTexture(tex);
+    }
+    if (reloaded) {
+      ++num_reloaded;
+    } else {
+      still_loading.push_back(*key);
+    }
+  }
+  pending_reloads_.swap(still_loading);
+  if (num_reloaded) LogInfo("Reloading %d changed assets.", num_reloaded);
+  return num_reloaded;
+}
+
+bool AssetManager::ReloadTexture(Texture *tex) {
+  Texture *unloaded_original = nullptr;
+  {
+    fplutil::MutexLock lock(texture_sharing_mutex_);
+    auto it = texture_sharing_.find(tex);
+    std::vector<Texture *> sharers;
+    if (it != texture_sharing_.end() && it->second.num_sharers > 0) {
+      for (auto s = texture_sharing_.begin(); s != texture_sharing_.end();
+           ++s) {
+        if (s->second.original != tex) continue;
+        // They'd finalize with the GPU texture that is about to go away.
+        if (!s->first->IsFinalized()) return false;
+        sharers.push_back(s->first);
+      }
+    }
+    if (!loader_.ReloadJob(tex)) return false;
+    // The texture no longer has the contents it was shared for, so the ones
+    // sharing it load their own files again (see ShareTexture()), and are
+    // finalized before it deletes its GPU texture.
+    for (auto s = sharers.begin(); s != sharers.end(); ++s) {
+      loader_.ReloadJob(*s);
+      loader_.AddDependency(tex, *s);
+      texture_sharing_.erase(*s);
+    }
+    if (it != texture_sharing_.end()) {
+      Texture *original = it->second.original;
+      if (original) {
+        TextureSharing &shared = texture_sharing_[original];
+        if (--shared.num_sharers == 0 && shared.unloaded) {
+          unloaded_original = original;
+        }
+      } else {
+        texture_contents_.erase(it->second.content_hash);
+      }
+      texture_sharing_.erase(it);
+    }
+  }
+  if (unloaded_original) DestroyTexture(unloaded_original);
+  return true;
+}
+
+void AssetManager::ReloadMaterial(Material *mat, const char *filename) {
+  Material *loaded = Material::LoadFromMaterialDef(
+      filename, [&](const char *filename, TextureFormat format,
+                    TextureFlags flags) -> Texture * {
+        auto tex = LoadTexture(filename, format,
+                               flags | kTextureFlagsLoadAsync);
+        tex->set_scale(texture_scale_);
+        return tex;
+      });
+  // Keeps the old definition if the new one doesn't parse, e.g. because it
+  // was saved half way.
+  if (!loaded) return;
+  mat->textures() = loaded->textures();
+  mat->set_blend_mode(static_cast<BlendMode>(loaded->blend_mode()));
+  delete loaded;
+}
 
 void AssetManager::UnloadTexture(const char *filename) {
+  fplutil::MutexLock lock(material_mutex_);
   auto tex = FindTexture(filename);
   if (!tex || tex->DecreaseRefCount()) return;
-  loader_.AbortJob(tex);
-  texture_map_.erase(filename);
-  delete tex;
+  EraseAsset(texture_map_, AssetId::FromName(filename));
+  DestroyTexture(tex);
 }
 
 Material *AssetManager::FindMaterial(const char *filename) {
-  return FindInMap(material_map_, filename);
+  return FindMaterial(AssetId::FromName(filename));
+}
+
+Material *AssetManager::FindMaterial(AssetId id) {
+  return FindAsset(material_map_, id);
 }
 
 Material *AssetManager::LoadMaterial(const char *filename,
                                      bool async_resources) {
-  auto mat = FindMaterial(filename);
-  if (mat) return mat;
-  mat = Material::LoadFromMaterialDef(filename,
-    [&](const char *filename, TextureFormat format,
-        TextureFlags flags) -> Texture* {
-      auto tex = LoadTexture(filename, format, flags |
-        (async_resources ? kTextureFlagsLoadAsync : kTextureFlagsNone));
-      tex->set_scale(texture_scale_);
-      return tex;
-    });
-  if (!mat) return nullptr;
-  material_map_[filename] = mat;
+  std::vector<Texture *> load_now;
+  Material *mat;
+  {
+    fplutil::MutexLock lock(material_mutex_);
+    mat = FindMaterial(filename);
+    if (mat) return mat;
+    mat = Material::LoadFromMaterialDef(filename,
+      [&](const char *filename, TextureFormat format,
+          TextureFlags flags) -> Texture* {
+        auto tex = LoadTexture(filename, format, flags |
+          (async_resources ? kTextureFlagsLoadAsync : kTextureFlagsNone),
+          &load_now);
+        tex->set_scale(texture_scale_);
+        return tex;
+      });
+    if (!mat) return nullptr;
+    InsertAsset(material_map_, IdOf(filename), mat);
+    if (file_watcher_) {
+      WatchFile(filename, kAssetTypeMaterial, AssetId::FromName(filename));
+    }
+  }
+  // Outside of material_mutex_, since a mesh loading on a loader thread may
+  // need it while these load.
+  for (auto it = load_now.begin(); it != load_now.end(); ++it) {
+    loader_.LoadJobNow(*it);
+  }
   return mat;
 }
 
 void AssetManager::UnloadMaterial(const char *filename) {
+  fplutil::MutexLock lock(material_mutex_);
   auto mat = FindMaterial(filename);
   if (!mat || mat->DecreaseRefCount()) return;
-  mat->DeleteTextures();
-  material_map_.erase(filename);
+  EraseAsset(material_map_, AssetId::FromName(filename));
   for (auto it = mat->textures().begin(); it != mat->textures().end(); ++it) {
-    texture_map_.erase((*it)->filename());
+    Texture *tex = *it;
+    EraseAsset(texture_map_, AssetId(tex->filename()));
+    bool sharing;
+    {
+      fplutil::MutexLock sharing_lock(texture_sharing_mutex_);
+      sharing = texture_sharing_.count(tex) != 0;
+    }
+    // Other textures may use the GPU texture of a deduplicated one.
+    if (sharing) {
+      DestroyTexture(tex);
+    } else {
+      tex->Delete();
+    }
   }
 }
 
 Mesh *AssetManager::FindMesh(const char *filename) {
-  return FindInMap(mesh_map_, filename);
+  return FindMesh(AssetId::FromName(filename));
+}
+
+Mesh *AssetManager::FindMesh(AssetId id) {
+  return FindAsset(mesh_map_, id);
 }
 
 Mesh *AssetManager::LoadMesh(const char *filename, bool async) {
   auto mesh = FindMesh(filename);
-  if (mesh) return mesh;
+  if (mesh) {
+    NoteRequest(kAssetTypeMesh, filename, mesh, false);
+    // Requested async earlier, but needed now: don't load it twice.
+    if (!async && !mesh->IsFinalized()) loader_.LoadJobNow(mesh);
+    return mesh;
+  }
 
   auto async_flags = (async ? kTextureFlagsLoadAsync : kTextureFlagsNone);
   auto load_texture_fn = [this, async_flags](const char *filename,
@@ -227,19 +1217,26 @@ Mesh *AssetManager::LoadMesh(const char *filename, bool async) {
           return LoadMaterial(filename, async);
         }
       });
+  // Discover the materials while loading, so their textures load in parallel.
+  mesh->set_create_materials_in_load(async);
+  NoteRequest(kAssetTypeMesh, filename, mesh, true);
   return LoadOrQueue(mesh, mesh_map_, async, nullptr /* alias */);
 }
 
 void AssetManager::UnloadMesh(const char *filename) {
   auto mesh = FindMesh(filename);
   if (!mesh || mesh->DecreaseRefCount()) return;
-  loader_.AbortJob(mesh);
-  mesh_map_.erase(filename);
-  delete mesh;
+  EraseAsset(mesh_map_, AssetId::FromName(filename));
+  // Doesn't wait for a load in progress, the loader deletes it when done.
+  loader_.AbortJobAndDelete(mesh);
 }
 
 TextureAtlas *AssetManager::FindTextureAtlas(const char *filename) {
-  return FindInMap(texture_atlas_map_, filename);
+  return FindTextureAtlas(AssetId::FromName(filename));
+}
+
+TextureAtlas *AssetManager::FindTextureAtlas(AssetId id) {
+  return FindAsset(texture_atlas_map_, id);
 }
 
 TextureAtlas *AssetManager::LoadTextureAtlas(const char *filename,
@@ -252,19 +1249,23 @@ TextureAtlas *AssetManager::LoadTextureAtlas(const char *filename,
       return LoadTexture(filename, format, flags);
     });
   if (!atlas) return nullptr;
-  texture_atlas_map_[filename] = atlas;
+  InsertAsset(texture_atlas_map_, IdOf(filename), atlas);
   return atlas;
 }
 
 void AssetManager::UnloadTextureAtlas(const char *filename) {
   auto atlas = FindTextureAtlas(filename);
   if (!atlas || atlas->DecreaseRefCount()) return;
-  texture_atlas_map_.erase(filename);
+  EraseAsset(texture_atlas_map_, AssetId::FromName(filename));
   delete atlas;
 }
 
 FileAsset *AssetManager::FindFileAsset(const char *filename) {
-  return FindInMap(file_map_, filename);
+  return FindFileAsset(AssetId::FromName(filename));
+}
+
+FileAsset *AssetManager::FindFileAsset(AssetId id) {
+  return FindAsset(file_map_, id);
 }
 
 FileAsset *AssetManager::LoadFileAsset(const char *filename) {
@@ -272,7 +1273,7 @@ FileAsset *AssetManager::LoadFileAsset(const char *filename) {
   if (file) return file;
   file = new FileAsset();
   if (LoadFile(filename, &file->contents)) {
-    file_map_[filename] = file;
+    InsertAsset(file_map_, IdOf(filename), file);
     return file;
   }
   delete file;
@@ -282,7 +1283,7 @@ FileAsset *AssetManager::LoadFileAsset(const char *filename) {
 void AssetManager::UnloadFileAsset(const char *filename) {
   auto file = FindFileAsset(filename);
   if (!file || file->DecreaseRefCount()) return;
-  file_map_.erase(filename);
+  EraseAsset(file_map_, AssetId::FromName(filename));
   delete file;
 }
 
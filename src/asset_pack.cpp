@@ -0,0 +1,164 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/asset_pack.h"
+#include "fplbase/utilities.h"
+#include "asset_pack_generated.h"
+
+namespace fplbase {
+
+static size_t AlignPackOffset(size_t offset) {
+  return (offset + kAssetPackAlignment - 1) & ~(kAssetPackAlignment - 1);
+}
+
+AssetPack::AssetPack()
+    : mapped_(nullptr),
+      mapped_size_(0),
+      toc_(nullptr),
+      data_(nullptr),
+      data_size_(0) {}
+
+AssetPack::~AssetPack() { Close(); }
+
+bool AssetPack::Open(const char *filename) {
+  Close();
+  const uint8_t *file = nullptr;
+  size_t file_size = 0;
+#ifndef _WIN32
+  int32_t mapped_size = 0;
+  mapped_ = MapFile(filename, 0, &mapped_size);
+  if (mapped_) {
+    mapped_size_ = mapped_size;
+    file = static_cast<const uint8_t *>(mapped_);
+    file_size = static_cast<size_t>(mapped_size);
+  }
+#endif  // _WIN32
+  // Files that can't be mapped (e.g. inside an APK) are read instead.
+  if (!file) {
+    if (!LoadFileRaw(filename, &contents_)) return false;
+    file = reinterpret_cast<const uint8_t *>(contents_.data());
+    file_size = contents_.size();
+  }
+
+  if (file_size < kAssetPackHeaderSize ||
+      memcmp(file, kAssetPackMagic, sizeof(kAssetPackMagic)) != 0) {
+    LogError(kError, "Not a pack file: %s", filename);
+    Close();
+    return false;
+  }
+  const size_t toc_size = flatbuffers::ReadScalar<uint32_t>(file + 4);
+  const size_t data_start = AlignPackOffset(kAssetPackHeaderSize + toc_size);
+  const uint8_t *toc = file + kAssetPackHeaderSize;
+  flatbuffers::Verifier verifier(toc, toc_size);
+  if (data_start > file_size || !packdef::VerifyAssetPackBuffer(verifier)) {
+    LogError(kError, "Corrupt pack file: %s", filename);
+    Close();
+    return false;
+  }
+  toc_ = packdef::GetAssetPack(toc);
+  data_ = file + data_start;
+  data_size_ = file_size - data_start;
+  filename_ = filename;
+  return true;
+}
+
+void AssetPack::Close() {
+  if (mapped_) UnmapFile(mapped_, mapped_size_);
+  mapped_ = nullptr;
+  mapped_size_ = 0;
+  std::string().swap(contents_);
+  toc_ = nullptr;
+  data_ = nullptr;
+  data_size_ = 0;
+  filename_.clear();
+}
+
+const uint8_t *AssetPack::FindEntry(const char *name, size_t *size) const {
+  if (!toc_ || !toc_->entries()) return nullptr;
+  const packdef::PackEntry *entry = toc_->entries()->LookupByKey(name);
+  if (!entry) return nullptr;
+  if (entry->offset() > data_size_ ||
+      entry->size() > data_size_ - entry->offset()) {
+    LogError(kError, "Entry %s is outside of pack file %s", name,
+             filename_.c_str());
+    return nullptr;
+  }
+  if (size) *size = static_cast<size_t>(entry->size());
+  return data_ + entry->offset();
+}
+
+bool AssetPack::LoadEntry(const char *name, std::string *dest) const {
+  size_t size = 0;
+  const uint8_t *data = FindEntry(name, &size);
+  if (!data) return false;
+  dest->assign(reinterpret_cast<const char *>(data), size);
+  return true;
+}
+
+size_t AssetPack::num_entries() const {
+  return toc_ && toc_->entries() ? toc_->entries()->size() : 0;
+}
+
+bool AssetPack::Save(
+    const char *filename,
+    const std::vector<std::pair<std::string, std::string>> &entries) {
+  // Store the contents in name order, which keeps the files of a directory
+  // together.
+  typedef const std::pair<std::string, std::string> *Entry;
+  std::vector<Entry> sorted;
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    sorted.push_back(&*it);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](Entry a, Entry b) { return a->first < b->first; });
+
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<flatbuffers::Offset<packdef::PackEntry>> toc_entries;
+  size_t offset = 0;
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    if (i > 0 && sorted[i]->first == sorted[i - 1]->first) {
+      LogError(kError, "%s is in pack %s more than once",
+               sorted[i]->first.c_str(), filename);
+      return false;
+    }
+    toc_entries.push_back(packdef::CreatePackEntry(
+        fbb, fbb.CreateString(sorted[i]->first), offset,
+        sorted[i]->second.size()));
+    offset = AlignPackOffset(offset + sorted[i]->second.size());
+  }
+  auto toc = packdef::CreateAssetPack(
+      fbb, fbb.CreateVectorOfSortedTables(&toc_entries));
+  packdef::FinishAssetPackBuffer(fbb, toc);
+
+  std::string file(kAssetPackMagic, sizeof(kAssetPackMagic));
+  const uint32_t toc_size =
+      flatbuffers::EndianScalar(static_cast<uint32_t>(fbb.GetSize()));
+  file.append(reinterpret_cast<const char *>(&toc_size), sizeof(toc_size));
+  file.append(reinterpret_cast<const char *>(fbb.GetBufferPointer()),
+              fbb.GetSize());
+  file.resize(AlignPackOffset(file.size()), 0);
+  const size_t data_start = file.size();
+  file.reserve(data_start + offset);
+  for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+    file.append((*it)->second);
+    file.resize(data_start + AlignPackOffset(file.size() - data_start), 0);
+  }
+  return SaveFile(filename, file);
+}
+
+// MountAssetPack() and the functions that search the mounted packs are in
+// file_system.cpp.
+
+}  // namespace fplbase
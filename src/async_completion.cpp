@@ -0,0 +1,59 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/async_completion.h"
+
+namespace fplbase {
+
+WhenAll::WhenAll(const std::vector<AsyncAsset *> &assets) {
+  Init(assets.empty() ? nullptr : &assets[0], assets.size());
+}
+
+WhenAll::WhenAll(AsyncAsset *const *assets, size_t count) {
+  Init(assets, count);
+}
+
+void WhenAll::Init(AsyncAsset *const *assets, size_t count) {
+  asset_listeners_.reset(new AssetListener[count]);
+  num_assets_ = count;
+  num_pending_ = 0;
+  for (size_t i = 0; i < count; ++i) {
+    AssetListener &listener = asset_listeners_[i];
+    listener.group = this;
+    if (assets[i]->AddFinalizeListener(&listener)) {
+      listener.asset = assets[i];
+      ++num_pending_;
+    }
+  }
+}
+
+WhenAll::~WhenAll() {
+  for (size_t i = 0; i < num_assets_; ++i) {
+    AssetListener &listener = asset_listeners_[i];
+    if (listener.asset) listener.asset->RemoveFinalizeListener(&listener);
+  }
+}
+
+void WhenAll::Then(FinalizeListener *listener) {
+  listeners_.Add(listener);
+  if (IsReady()) listeners_.Notify();
+}
+
+void WhenAll::AssetListener::OnFinalized() {
+  asset = nullptr;
+  if (--group->num_pending_ == 0) group->listeners_.Notify();
+}
+
+}  // namespace fplbase
@@ -0,0 +1,957 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <chrono>
+#include <sstream>
+
+#include "fplbase/async_loader.h"
+#include "fplbase/file_system.h"
+#include "fplbase/utilities.h"
+
+namespace fplbase {
+
+void AsyncLoader::SetNumWorkers(int num_workers) {
+  assert(num_workers > 0 && !IsLoading());
+  Lock([this, num_workers]() {
+    std::vector<Worker> workers(num_workers);
+    for (int i = 0; i < num_workers; ++i) {
+      workers[i].loader = this;
+      workers[i].index = i;
+    }
+    // Keep jobs that were already queued, in order, on the first worker. The
+    // other workers will steal them from there.
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+      for (int p = 0; p < kLoadPriorityCount; ++p) {
+        for (auto job = it->queues[p].begin(); job != it->queues[p].end();
+             ++job) {
+          (*job)->loader_worker_ = 0;
+        }
+        workers[0].queues[p].splice(workers[0].queues[p].end(), it->queues[p]);
+      }
+    }
+    workers_.swap(workers);
+    next_worker_ = 0;
+  });
+}
+
+void AsyncLoader::SetNumIoWorkers(int num_io_workers) {
+  assert(num_io_workers >= 0 && !IsLoading());
+  Lock([this, num_io_workers]() {
+    io_workers_.resize(num_io_workers);
+    for (int i = 0; i < num_io_workers; ++i) {
+      io_workers_[i].loader = this;
+      io_workers_[i].index = i;
+      io_workers_[i].io = true;
+    }
+    if (num_io_workers > 0) return;
+    // Without I/O workers, the regular workers load these in one go.
+    for (int p = 0; p < kLoadPriorityCount; ++p) {
+      for (auto job = io_queues_[p].begin(); job != io_queues_[p].end();
+           ++job) {
+        (*job)->loader_worker_ = 0;
+      }
+      workers_[0].queues[p].splice(workers_[0].queues[p].end(), io_queues_[p]);
+    }
+  });
+}
+
+void AsyncLoader::SetMaxStagedBytes(size_t max_staged_bytes) {
+  assert(max_staged_bytes > 0);
+  Lock([this, max_staged_bytes]() { max_staged_bytes_ = max_staged_bytes; });
+  ScheduleWorkers();
+}
+
+void AsyncLoader::SetReadAheadDepth(int depth) {
+  assert(depth >= 0);
+  Lock([this, depth]() { read_ahead_depth_ = depth; });
+}
+
+ReadAheadStats AsyncLoader::GetReadAheadStats() {
+  return LockReturn<ReadAheadStats>([this]() { return read_ahead_stats_; });
+}
+
+void AsyncLoader::ResetReadAheadStats() {
+  Lock([this]() { read_ahead_stats_ = ReadAheadStats(); });
+}
+
+void AsyncLoader::SetExecutor(AsyncExecutor *executor) {
+  assert(!IsLoading());
+  executor_ = executor;
+}
+
+void AsyncLoader::Stop() {
+  StopLoadingWhenComplete();
+  Lock([this]() {
+    WaitForWorkers();
+    stop_mode_ = kStopNow;
+  });
+  default_executor_.reset();
+  CollectCompletedJobs();
+}
+
+void AsyncLoader::QueueJob(AsyncAsset *res, LoadPriority priority) {
+  assert(0 <= priority && priority < kLoadPriorityCount);
+  Lock([this, res, priority]() { QueueJobLocked(res, priority); });
+  ScheduleWorkers();
+}
+
+void AsyncLoader::QueueJobs(const std::vector<AsyncAsset *> &jobs,
+                            LoadPriority priority) {
+  assert(0 <= priority && priority < kLoadPriorityCount);
+  if (jobs.empty()) return;
+  Lock([this, &jobs, priority]() {
+    for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+      QueueJobLocked(*it, priority);
+    }
+  });
+  ScheduleWorkers();
+}
+
+void AsyncLoader::QueueJobLocked(AsyncAsset *res, LoadPriority priority) {
+  assert(res->loader_state_ == AsyncAsset::kNotQueued ||
+         res->loader_state_ == AsyncAsset::kFinalized);
+  // Spread jobs that can run anywhere over all workers, so they all start
+  // out with some work.
+  assert(res->SupportsConcurrentLoad() || !res->SupportsStagedLoad());
+  int index = res->SupportsConcurrentLoad()
+                  ? static_cast<int>(next_worker_++ % workers_.size())
+                  : 0;
+  if (res->SupportsStagedLoad() && !io_workers_.empty()) index = kIoQueue;
+  auto &queue = QueuesOf(index)[priority];
+  res->loader_ = this;
+  res->load_priority_ = priority;
+  res->loader_state_ = AsyncAsset::kQueued;
+  res->loader_worker_ = index;
+  res->loader_position_ = queue.insert(queue.end(), res);
+  res->load_cancelled_ = false;
+  res->delete_when_loaded_ = false;
+  res->read_ahead_ = false;
+  res->load_record_ = AssetLoadRecord();
+  res->load_record_.queued = TelemetryTime();
+  ++num_pending_requests_;
+}
+
+bool AsyncLoader::ReloadJob(AsyncAsset *res, LoadPriority priority) {
+  assert(0 <= priority && priority < kLoadPriorityCount);
+  const bool queued = LockReturn<bool>([this, res, priority]() {
+    if (res->loader_state_ != AsyncAsset::kFinalized &&
+        (res->loader_state_ != AsyncAsset::kNotQueued ||
+         !res->IsFinalized())) {
+      return false;
+    }
+    QueueJobLocked(res, priority);
+    return true;
+  });
+  if (queued) ScheduleWorkers();
+  return queued;
+}
+
+bool AsyncLoader::SetJobPriority(AsyncAsset *res, LoadPriority priority) {
+  assert(0 <= priority && priority < kLoadPriorityCount);
+  return LockReturn<bool>([this, res, priority]() {
+    if (res->loader_state_ != AsyncAsset::kQueued) return false;
+    SetJobPriorityLocked(res, priority);
+    return true;
+  });
+}
+
+void AsyncLoader::SetJobPriorityLocked(AsyncAsset *res, LoadPriority priority) {
+  JobList *queues = QueuesOf(res->loader_worker_);
+  queues[priority].splice(queues[priority].end(), queues[res->load_priority_],
+                          res->loader_position_);
+  res->load_priority_ = priority;
+}
+
+AsyncLoader::JobList *AsyncLoader::QueuesOf(int worker) {
+  return worker == kIoQueue ? io_queues_ : workers_[worker].queues;
+}
+
+void AsyncLoader::AddDependency(AsyncAsset *res, AsyncAsset *dependency) {
+  assert(res != dependency);
+  Lock([this, res, dependency]() {
+    if (res->load_cancelled_ || res->loader_state_ == AsyncAsset::kNotQueued ||
+        res->loader_state_ == AsyncAsset::kFinalized) {
+      return;
+    }
+    switch (dependency->loader_state_) {
+      case AsyncAsset::kNotQueued:
+        // Assets that were loaded synchronously are never queued.
+        if (dependency->IsFinalized()) return;
+        QueueJobLocked(dependency, res->load_priority_);
+        break;
+      case AsyncAsset::kQueued:
+        if (dependency->load_priority_ < res->load_priority_) {
+          SetJobPriorityLocked(dependency, res->load_priority_);
+        }
+        break;
+      case AsyncAsset::kFinalized:
+        return;
+      default:
+        break;
+    }
+    if (std::find(res->dependencies_.begin(), res->dependencies_.end(),
+                  dependency) != res->dependencies_.end()) {
+      return;
+    }
+    res->dependencies_.push_back(dependency);
+    dependency->dependents_.push_back(res);
+    if (res->loader_state_ == AsyncAsset::kLoaded) {
+      RemoveLoadedJob(res);
+      res->loader_state_ = AsyncAsset::kWaitingForDependencies;
+    }
+  });
+  ScheduleWorkers();
+}
+
+void AsyncLoader::JobLoaded(AsyncAsset *res) {
+  if (res->dependencies_.empty()) {
+    res->loader_state_ = AsyncAsset::kLoaded;
+    res->loader_position_ = done_.insert(done_.end(), res);
+    ++num_done_;
+  } else {
+    res->loader_state_ = AsyncAsset::kWaitingForDependencies;
+  }
+}
+
+void AsyncLoader::RemoveLoadedJob(AsyncAsset *res) {
+  done_.erase(res->loader_position_);
+  --num_done_;
+}
+
+void AsyncLoader::ReleaseDependencies(AsyncAsset *res) {
+  for (auto it = res->dependents_.begin(); it != res->dependents_.end();
+       ++it) {
+    AsyncAsset *dependent = *it;
+    auto &deps = dependent->dependencies_;
+    deps.erase(std::find(deps.begin(), deps.end(), res));
+    if (deps.empty() &&
+        dependent->loader_state_ == AsyncAsset::kWaitingForDependencies) {
+      JobLoaded(dependent);
+    }
+  }
+  res->dependents_.clear();
+  for (auto it = res->dependencies_.begin(); it != res->dependencies_.end();
+       ++it) {
+    auto &dependents = (*it)->dependents_;
+    dependents.erase(std::find(dependents.begin(), dependents.end(), res));
+  }
+  res->dependencies_.clear();
+}
+
+bool AsyncLoader::AbortJobLocked(AsyncAsset *res) {
+  // Whatever waits for res shouldn't wait forever.
+  ReleaseDependencies(res);
+  switch (res->loader_state_) {
+    case AsyncAsset::kQueued:
+      QueuesOf(res->loader_worker_)[res->load_priority_].erase(
+          res->loader_position_);
+      if (res->read_ahead_) ++read_ahead_stats_.num_wasted_hints;
+      break;
+    case AsyncAsset::kRead:
+      read_queues_[res->load_priority_].erase(res->loader_position_);
+      staged_bytes_ -= res->staged_bytes_;
+      break;
+    case AsyncAsset::kLoaded:
+      RemoveLoadedJob(res);
+      break;
+    case AsyncAsset::kWaitingForDependencies:
+      break;
+    case AsyncAsset::kLoading:
+      // The result is discarded once Load() returns, see
+      // CollectCompletedJobs().
+      if (!res->load_cancelled_) {
+        res->load_cancelled_ = true;
+        --num_pending_requests_;
+      }
+      return false;
+    case AsyncAsset::kNotQueued:
+    case AsyncAsset::kFinalized:
+      return true;
+  }
+  res->loader_state_ = AsyncAsset::kNotQueued;
+  --num_pending_requests_;
+  return true;
+}
+
+bool AsyncLoader::AbortJob(AsyncAsset *res) {
+  const bool unused =
+      LockReturn<bool>([this, res]() { return AbortJobLocked(res); });
+  // I/O workers may be waiting for staged_bytes_ to go down.
+  ScheduleWorkers();
+  return unused;
+}
+
+void AsyncLoader::AbortJobAndDelete(AsyncAsset *res) {
+  const bool unused = LockReturn<bool>([this, res]() {
+    if (AbortJobLocked(res)) return true;
+    res->delete_when_loaded_ = true;
+    return false;
+  });
+  if (unused) delete res;
+  ScheduleWorkers();
+}
+
+bool AsyncLoader::LoadJobNow(AsyncAsset *res) {
+  // What to do with res, depending on where it is in the loader.
+  enum Action { kNothing, kRun, kWait, kSchedule, kFinalize };
+  ++num_job_waiters_;
+  Action action = kWait;
+  Stage stage = kStageLoad;
+  bool promoted = false;
+  while (action == kWait) {
+    CollectCompletedJobs();
+    action = LockReturn<Action>([this, res, &stage, &promoted]() {
+      switch (res->loader_state_) {
+        case AsyncAsset::kQueued: {
+          JobList *queues = QueuesOf(res->loader_worker_);
+          if (!res->SupportsConcurrentLoad() && stop_mode_ != kStopNow) {
+            // Only the first worker may load res, so have it do that next.
+            if (promoted) {
+              if (completed_.load() == nullptr) Wait();
+              return kWait;
+            }
+            JobList &queue = queues[kLoadPriorityHighest];
+            queues[res->load_priority_].erase(res->loader_position_);
+            res->load_priority_ = kLoadPriorityHighest;
+            res->loader_position_ = queue.insert(queue.begin(), res);
+            promoted = true;
+            return kSchedule;
+          }
+          queues[res->load_priority_].erase(res->loader_position_);
+          stage = kStageLoad;
+          CountReadAhead(res);
+          break;
+        }
+        case AsyncAsset::kRead:
+          read_queues_[res->load_priority_].erase(res->loader_position_);
+          staged_bytes_ -= res->staged_bytes_;
+          stage = kStageDecode;
+          break;
+        case AsyncAsset::kLoading:
+          if (res->load_cancelled_) return kNothing;
+          // Workers push res before they Notify(), so only wait if nothing
+          // was pushed since CollectCompletedJobs().
+          if (completed_.load() == nullptr) Wait();
+          return kWait;
+        case AsyncAsset::kLoaded:
+          RemoveLoadedJob(res);
+          // Keeps ReleaseDependencies() from moving res back to done_.
+          res->loader_state_ = AsyncAsset::kLoading;
+          return kFinalize;
+        case AsyncAsset::kWaitingForDependencies:
+          res->loader_state_ = AsyncAsset::kLoading;
+          return kFinalize;
+        case AsyncAsset::kNotQueued:
+        case AsyncAsset::kFinalized:
+          return kNothing;
+      }
+      res->loader_state_ = AsyncAsset::kLoading;
+      res->load_record_.priority = res->load_priority_;
+      return kRun;
+    });
+    if (action == kSchedule) {
+      ScheduleWorkers();
+      action = kWait;
+    }
+  }
+  --num_job_waiters_;
+  if (action == kNothing) return false;
+
+  if (action == kRun) {
+    // Decoding frees up staged memory, which I/O workers may be waiting for.
+    if (stage == kStageDecode) ScheduleWorkers();
+    res->finalize_cost_ = RunJob(res, stage);
+  }
+  // Finalize what res depends on first, which may have been added by its
+  // Load(). Finalizing a dependency takes it off res->dependencies_.
+  for (;;) {
+    AsyncAsset *dependency = LockReturn<AsyncAsset *>([res]() {
+      return res->dependencies_.empty() ? nullptr : res->dependencies_.front();
+    });
+    if (!dependency || !LoadJobNow(dependency)) break;
+  }
+  Lock([this, res]() {
+    res->loader_state_ = AsyncAsset::kFinalized;
+    ReleaseDependencies(res);
+  });
+  FinalizeJob(res);
+  return true;
+}
+
+void AsyncLoader::PushCompletedJob(AsyncAsset *res) {
+  // Only the main thread pops, and it takes the whole stack at once, so
+  // there is no ABA problem here.
+  AsyncAsset *head = completed_.load(std::memory_order_relaxed);
+  do {
+    res->next_completed_ = head;
+  } while (!completed_.compare_exchange_weak(
+      head, res, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void AsyncLoader::CollectCompletedJobs() {
+  AsyncAsset *res = completed_.exchange(nullptr, std::memory_order_acquire);
+  if (!res) return;
+  // Reverse the stack, so jobs are finalized in the order they completed.
+  AsyncAsset *completed = nullptr;
+  while (res) {
+    AsyncAsset *next = res->next_completed_;
+    res->next_completed_ = completed;
+    completed = res;
+    res = next;
+  }
+
+  std::vector<AsyncAsset *> aborted;
+  Lock([this, completed, &aborted]() {
+    for (AsyncAsset *res = completed; res; res = res->next_completed_) {
+      if (res->load_cancelled_) {
+        // Aborted while loading: AbortJob() already stopped counting it.
+        ReleaseDependencies(res);
+        res->loader_state_ = AsyncAsset::kNotQueued;
+        if (res->delete_when_loaded_) aborted.push_back(res);
+      } else {
+        JobLoaded(res);
+      }
+    }
+  });
+  for (auto it = aborted.begin(); it != aborted.end(); ++it) {
+    delete *it;
+  }
+}
+
+void AsyncLoader::StartLoading() {
+  if (!executor_ && !default_executor_) {
+    default_executor_.reset(new ThreadPoolExecutor(
+        static_cast<int>(workers_.size() + io_workers_.size())));
+  }
+  Lock([this]() { stop_mode_ = kKeepRunning; });
+  ScheduleWorkers();
+}
+
+void AsyncLoader::PauseLoading() {
+  Lock([this]() {
+    stop_mode_ = kStopNow;
+    WaitForWorkers();
+  });
+  default_executor_.reset();
+}
+
+void AsyncLoader::StopLoadingWhenComplete() {
+  Lock([this]() {
+    if (stop_mode_ == kKeepRunning) stop_mode_ = kStopWhenComplete;
+  });
+}
+
+bool AsyncLoader::IsLoading() {
+  return LockReturn<bool>(
+      [this]() { return stop_mode_ != kStopNow || num_running_ > 0; });
+}
+
+void AsyncLoader::WaitForWorkers() {
+  while (num_running_ > 0) Wait();
+}
+
+void AsyncLoader::ScheduleWorkers() {
+  std::vector<Worker *> idle;
+  Lock([this, &idle]() {
+    if (stop_mode_ == kStopNow) return;
+    auto schedule = [this, &idle](std::vector<Worker> &workers) {
+      for (auto it = workers.begin(); it != workers.end(); ++it) {
+        if (!it->running && HasWork(*it)) {
+          it->running = true;
+          ++num_running_;
+          idle.push_back(&*it);
+        }
+      }
+    };
+    schedule(workers_);
+    schedule(io_workers_);
+  });
+  // Outside the lock, in case the executor runs tasks right away.
+  AsyncExecutor *executor = executor_ ? executor_ : default_executor_.get();
+  for (auto it = idle.begin(); it != idle.end(); ++it) {
+    Worker *worker = *it;
+    executor->Execute([worker]() { worker->loader->RunWorker(worker); });
+  }
+}
+
+bool AsyncLoader::TryFinalize() { return TryFinalize(FinalizeBudget()); }
+
+bool AsyncLoader::TryFinalize(const FinalizeBudget &budget,
+                              FinalizeStatus *status) {
+  typedef std::chrono::steady_clock Clock;
+  typedef std::chrono::duration<double> Seconds;
+  const Clock::time_point start = Clock::now();
+  CollectCompletedJobs();
+  // Most frames, nothing finished loading since the last call. Don't take the
+  // lock for that.
+  if (num_done_ == 0) {
+    if (telemetry_enabled_) SampleQueueDepth();
+    const int num_pending = num_pending_requests_;
+    if (status) {
+      *status = FinalizeStatus();
+      status->seconds = Seconds(Clock::now() - start).count();
+      status->num_pending = num_pending;
+    }
+    return num_pending == 0;
+  }
+
+  int num_finalized = 0;
+  size_t bytes_finalized = 0;
+  for (;;) {
+    const double seconds_spent = Seconds(Clock::now() - start).count();
+    if (num_finalized > 0 && budget.max_seconds > 0.0 &&
+        seconds_spent >= budget.max_seconds) {
+      break;
+    }
+    // Take the oldest resource that fits in what remains of the budget out of
+    // done_, so that it's no longer ours once Finalize() returns: it may be
+    // destroyed during its finalize callbacks.
+    auto res = LockReturn<AsyncAsset *>(
+        [this, &budget, num_finalized, seconds_spent, bytes_finalized]() {
+          for (auto it = done_.begin(); it != done_.end(); ++it) {
+            AsyncAsset *res = *it;
+            if (num_finalized == 0 ||
+                FitsBudget(res, budget, seconds_spent, bytes_finalized)) {
+              RemoveLoadedJob(res);
+              res->loader_state_ = AsyncAsset::kFinalized;
+              // Finalize() happens before that of anything waiting for res,
+              // since those can only be finalized after this one.
+              ReleaseDependencies(res);
+              return res;
+            }
+          }
+          return static_cast<AsyncAsset *>(nullptr);
+        });
+    if (!res) break;
+
+    bytes_finalized += FinalizeJob(res);
+    ++num_finalized;
+  }
+
+  if (telemetry_enabled_) SampleQueueDepth();
+  if (status) {
+    Lock([&]() {
+      status->num_finalized = num_finalized;
+      status->bytes_finalized = bytes_finalized;
+      status->seconds = Seconds(Clock::now() - start).count();
+      status->num_ready = static_cast<int>(done_.size());
+      status->bytes_ready = 0;
+      for (auto it = done_.begin(); it != done_.end(); ++it) {
+        status->bytes_ready += (*it)->finalize_cost_;
+      }
+      status->num_pending = num_pending_requests_;
+    });
+  }
+  return num_pending_requests_ == 0;
+}
+
+size_t AsyncLoader::FinalizeJob(AsyncAsset *res) {
+  typedef std::chrono::steady_clock Clock;
+  typedef std::chrono::duration<double> Seconds;
+  const size_t cost = res->finalize_cost_;
+  // Copy what we need from res, since Finalize() may destroy it.
+  AssetLoadRecord record;
+  if (telemetry_enabled_) {
+    record = res->load_record_;
+    record.filename = res->filename_;
+    record.finalize_start = TelemetryTime();
+  }
+  const Clock::time_point finalize_start = Clock::now();
+  bool ok = res->Finalize();
+  if (!ok) {
+    // Can't do much here, since res is already constructed. Caller has to
+    // check IsValid() to know if resource can be used.
+  }
+  if (telemetry_enabled_) {
+    record.finalize_end = TelemetryTime();
+    load_records_.push_back(record);
+  }
+  if (cost > 0) {
+    const double seconds_per_byte =
+        Seconds(Clock::now() - finalize_start).count() / cost;
+    finalize_seconds_per_byte_ =
+        finalize_seconds_per_byte_ == 0.0
+            ? seconds_per_byte
+            : 0.75 * finalize_seconds_per_byte_ + 0.25 * seconds_per_byte;
+  }
+  --num_pending_requests_;
+  return cost;
+}
+
+double AsyncLoader::TelemetryTime() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start_time_)
+      .count();
+}
+
+void AsyncLoader::SampleQueueDepth() {
+  QueueDepthSample sample;
+  Lock([this, &sample]() {
+    for (int p = 0; p < kLoadPriorityCount; ++p) {
+      for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+        sample.num_queued += static_cast<int>(it->queues[p].size());
+      }
+      sample.num_queued += static_cast<int>(io_queues_[p].size());
+      sample.num_staged += static_cast<int>(read_queues_[p].size());
+    }
+    sample.num_ready = static_cast<int>(done_.size());
+    sample.num_pending = num_pending_requests_;
+  });
+  if (!queue_depth_samples_.empty()) {
+    const QueueDepthSample &last = queue_depth_samples_.back();
+    if (last.num_queued == sample.num_queued &&
+        last.num_staged == sample.num_staged &&
+        last.num_ready == sample.num_ready &&
+        last.num_pending == sample.num_pending) {
+      return;
+    }
+  }
+  sample.time = TelemetryTime();
+  queue_depth_samples_.push_back(sample);
+}
+
+void AsyncLoader::ClearTelemetry() {
+  load_records_.clear();
+  queue_depth_samples_.clear();
+}
+
+namespace {
+
+// Writes `str` as a JSON string, quotes included.
+void WriteJsonString(const std::string &str, std::ostringstream *os) {
+  *os << '"';
+  for (auto it = str.begin(); it != str.end(); ++it) {
+    const unsigned char c = static_cast<unsigned char>(*it);
+    if (c == '"' || c == '\\') {
+      *os << '\\' << c;
+    } else if (c < 0x20) {
+      static const char kHex[] = "0123456789abcdef";
+      *os << "\\u00" << kHex[c >> 4] << kHex[c & 0xf];
+    } else {
+      *os << c;
+    }
+  }
+  *os << '"';
+}
+
+}  // namespace
+
+std::string AsyncLoader::TelemetryToJson() const {
+  std::ostringstream os;
+  os.precision(9);
+  os << "{\n  \"assets\": [";
+  for (auto it = load_records_.begin(); it != load_records_.end(); ++it) {
+    os << (it == load_records_.begin() ? "\n" : ",\n") << "    {\"filename\": ";
+    WriteJsonString(it->filename, &os);
+    os << ", \"priority\": " << it->priority
+       << ", \"queued\": " << it->queued
+       << ", \"load_start\": " << it->load_start
+       << ", \"read_end\": " << it->read_end
+       << ", \"decode_start\": " << it->decode_start
+       << ", \"load_end\": " << it->load_end
+       << ", \"finalize_start\": " << it->finalize_start
+       << ", \"finalize_end\": " << it->finalize_end
+       << ", \"bytes_read\": " << it->bytes_read
+       << ", \"decoded_bytes\": " << it->decoded_bytes << "}";
+  }
+  os << "\n  ],\n  \"queue_depth\": [";
+  for (auto it = queue_depth_samples_.begin(); it != queue_depth_samples_.end();
+       ++it) {
+    os << (it == queue_depth_samples_.begin() ? "\n" : ",\n")
+       << "    {\"time\": " << it->time
+       << ", \"num_queued\": " << it->num_queued
+       << ", \"num_staged\": " << it->num_staged
+       << ", \"num_ready\": " << it->num_ready
+       << ", \"num_pending\": " << it->num_pending << "}";
+  }
+  os << "\n  ]\n}\n";
+  return os.str();
+}
+
+bool AsyncLoader::SaveTelemetry(const char *filename) const {
+  return SaveFile(filename, TelemetryToJson());
+}
+
+bool AsyncLoader::FitsBudget(const AsyncAsset *res,
+                             const FinalizeBudget &budget,
+                             double seconds_spent, size_t bytes_spent) const {
+  const size_t cost = res->finalize_cost_;
+  if (budget.max_bytes > 0 && bytes_spent + cost > budget.max_bytes) {
+    return false;
+  }
+  if (budget.max_seconds > 0.0 &&
+      seconds_spent + cost * finalize_seconds_per_byte_ > budget.max_seconds) {
+    return false;
+  }
+  return true;
+}
+
+AsyncAsset *AsyncLoader::PopJob(Worker *worker, Stage *stage) {
+  if (worker->io) return PopIoJob(stage);
+  const size_t num_workers = workers_.size();
+  for (int p = kLoadPriorityCount - 1; p >= 0; --p) {
+    // Files that were already read come first, to free up their memory.
+    auto &read_queue = read_queues_[p];
+    if (!read_queue.empty()) {
+      AsyncAsset *res = read_queue.front();
+      read_queue.pop_front();
+      staged_bytes_ -= res->staged_bytes_;
+      res->loader_state_ = AsyncAsset::kLoading;
+      *stage = kStageDecode;
+      return res;
+    }
+
+    // Then our own queue, oldest job first.
+    *stage = kStageLoad;
+    auto &queue = worker->queues[p];
+    if (!queue.empty()) {
+      AsyncAsset *res = queue.front();
+      queue.pop_front();
+      res->loader_state_ = AsyncAsset::kLoading;
+      return res;
+    }
+
+    // Otherwise steal the newest job of this priority from another worker,
+    // skipping jobs that must stay on the first worker.
+    for (size_t i = 1; i < num_workers; ++i) {
+      auto &victim = workers_[(worker->index + i) % num_workers].queues[p];
+      for (auto it = victim.rbegin(); it != victim.rend(); ++it) {
+        AsyncAsset *res = *it;
+        if (res->SupportsConcurrentLoad()) {
+          victim.erase(res->loader_position_);
+          res->loader_state_ = AsyncAsset::kLoading;
+          return res;
+        }
+      }
+    }
+  }
+  return nullptr;
+}
+
+AsyncAsset *AsyncLoader::PopIoJob(Stage *stage) {
+  // Backpressure: don't read more while enough is waiting to be decoded.
+  if (staged_bytes_ > 0 && staged_bytes_ >= max_staged_bytes_) return nullptr;
+  for (int p = kLoadPriorityCount - 1; p >= 0; --p) {
+    auto &queue = io_queues_[p];
+    if (!queue.empty()) {
+      AsyncAsset *res = queue.front();
+      queue.pop_front();
+      res->loader_state_ = AsyncAsset::kLoading;
+      *stage = kStageRead;
+      return res;
+    }
+  }
+  return nullptr;
+}
+
+void AsyncLoader::CountReadAhead(AsyncAsset *res) {
+  if (res->read_ahead_) {
+    ++read_ahead_stats_.num_hinted_loads;
+    read_ahead_stats_.total_lead_seconds +=
+        TelemetryTime() - res->read_ahead_time_;
+  } else {
+    ++read_ahead_stats_.num_unhinted_loads;
+  }
+}
+
+void AsyncLoader::SelectReadAhead(std::vector<std::string> *filenames) {
+  // Roughly the order PopJob() and PopIoJob() take jobs in. Jobs that were
+  // read ahead already still count towards the depth.
+  int num_left = read_ahead_depth_;
+  auto select = [this, filenames, &num_left](const JobList &queue) {
+    for (auto it = queue.begin(); it != queue.end() && num_left > 0; ++it) {
+      AsyncAsset *res = *it;
+      --num_left;
+      if (res->read_ahead_) continue;
+      res->read_ahead_ = true;
+      res->read_ahead_time_ = TelemetryTime();
+      filenames->push_back(res->filename_);
+      ++read_ahead_stats_.num_hints;
+    }
+  };
+  for (int p = kLoadPriorityCount - 1; p >= 0 && num_left > 0; --p) {
+    select(io_queues_[p]);
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+      select(it->queues[p]);
+    }
+  }
+}
+
+void AsyncLoader::ReadAhead(const std::vector<std::string> &filenames) {
+  int num_failed = 0;
+  for (auto it = filenames.begin(); it != filenames.end(); ++it) {
+    if (!ReadAheadFile(it->c_str())) ++num_failed;
+  }
+  if (num_failed > 0) {
+    Lock([this, num_failed]() {
+      read_ahead_stats_.num_failed_hints += num_failed;
+    });
+  }
+}
+
+bool AsyncLoader::HasWork(const Worker &worker) const {
+  if (worker.io) {
+    if (staged_bytes_ > 0 && staged_bytes_ >= max_staged_bytes_) return false;
+    for (int p = 0; p < kLoadPriorityCount; ++p) {
+      if (!io_queues_[p].empty()) return true;
+    }
+    return false;
+  }
+  // May be wrong about jobs that can't be stolen, in which case the worker
+  // just finds nothing to do.
+  for (int p = 0; p < kLoadPriorityCount; ++p) {
+    if (!read_queues_[p].empty()) return true;
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+      if (!it->queues[p].empty()) return true;
+    }
+  }
+  return false;
+}
+
+size_t AsyncLoader::RunJob(AsyncAsset *res, Stage stage) {
+  // The size of the file data for reads, the finalize cost otherwise.
+  size_t bytes = 0;
+  AssetLoadRecord &record = res->load_record_;
+  switch (stage) {
+    case kStageLoad:
+      LogInfo(kApplication, "async load: %s", res->filename_.c_str());
+      record.load_start = TelemetryTime();
+      if (res->SupportsStagedLoad()) {
+        // Same as Load(), but tells reading and decoding apart.
+        res->LoadFileData();
+        record.bytes_read = res->FileDataSize();
+        record.read_end = record.decode_start = TelemetryTime();
+        res->DecodeFileData();
+      } else {
+        res->Load();
+      }
+      break;
+    case kStageRead:
+      LogInfo(kApplication, "async read: %s", res->filename_.c_str());
+      record.load_start = TelemetryTime();
+      res->LoadFileData();
+      bytes = record.bytes_read = res->FileDataSize();
+      record.read_end = TelemetryTime();
+      break;
+    case kStageDecode:
+      record.decode_start = TelemetryTime();
+      res->DecodeFileData();
+      break;
+  }
+  if (stage != kStageRead) {
+    record.load_end = TelemetryTime();
+    if (!res->IsLoadCancelled()) bytes = res->EstimateFinalizeCost();
+    record.decoded_bytes = bytes;
+  }
+  return bytes;
+}
+
+void AsyncLoader::RunWorker(Worker *worker) {
+  std::vector<std::string> read_ahead;
+  for (;;) {
+    AsyncAsset *res = nullptr;
+    Stage stage = kStageLoad;
+    Lock([this, worker, &res, &stage, &read_ahead]() {
+      if (stop_mode_ != kStopNow) res = PopJob(worker, &stage);
+      if (res) {
+        res->load_record_.priority = res->load_priority_;
+        // Decoding doesn't read the file.
+        if (stage != kStageDecode) CountReadAhead(res);
+        if (read_ahead_depth_ > 0) SelectReadAhead(&read_ahead);
+      } else {
+        // ScheduleWorkers() runs this worker again once there's more to do.
+        worker->running = false;
+        --num_running_;
+        Notify();
+      }
+    });
+    if (!res) return;
+    // Decoding frees up staged memory, which I/O workers may be waiting for.
+    if (stage == kStageDecode) ScheduleWorkers();
+    if (!read_ahead.empty()) {
+      ReadAhead(read_ahead);
+      read_ahead.clear();
+    }
+    const size_t bytes = RunJob(res, stage);
+
+    if (stage == kStageRead) {
+      const bool staged = LockReturn<bool>([this, res, bytes]() {
+        if (res->load_cancelled_) return false;
+        auto &queue = read_queues_[res->load_priority_];
+        res->staged_bytes_ = bytes;
+        staged_bytes_ += bytes;
+        res->loader_state_ = AsyncAsset::kRead;
+        res->loader_position_ = queue.insert(queue.end(), res);
+        return true;
+      });
+      if (staged) {
+        // Get a worker to decode what we read.
+        ScheduleWorkers();
+        continue;
+      }
+    }
+
+    // The main thread sorts out finished and cancelled jobs alike.
+    res->finalize_cost_ = bytes;
+    PushCompletedJob(res);
+    // LoadJobNow() may be waiting for res. Pairs with its check of
+    // completed_, so that either it sees res, or this sees it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_job_waiters_ > 0) Lock([this]() { Notify(); });
+  }
+}
+
+void FinalizeListenerList::Add(FinalizeListener *listener) {
+  assert(listener->next_ == nullptr && listener != tail_);
+  if (tail_) {
+    tail_->next_ = listener;
+  } else {
+    head_ = listener;
+  }
+  tail_ = listener;
+}
+
+bool FinalizeListenerList::Remove(FinalizeListener *listener) {
+  FinalizeListener *previous = nullptr;
+  for (FinalizeListener *it = head_; it; previous = it, it = it->next_) {
+    if (it != listener) continue;
+    if (previous) {
+      previous->next_ = it->next_;
+    } else {
+      head_ = it->next_;
+    }
+    if (tail_ == it) tail_ = previous;
+    it->next_ = nullptr;
+    return true;
+  }
+  return false;
+}
+
+void FinalizeListenerList::Notify() {
+  // Listeners may modify this list, or delete themselves.
+  while (head_) {
+    FinalizeListener *listener = head_;
+    head_ = listener->next_;
+    if (!head_) tail_ = nullptr;
+    listener->next_ = nullptr;
+    listener->OnFinalized();
+  }
+}
+
+void AsyncAsset::AddDependency(AsyncAsset *dependency) {
+  if (loader_) loader_->AddDependency(this, dependency);
+}
+
+}  // namespace fplbase
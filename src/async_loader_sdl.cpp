@@ -18,154 +18,111 @@
 
 namespace fplbase {
 
-// Push this to signal the worker thread that it's time to quit.
-class BookendAsyncResource : public AsyncAsset {
-  static const char *kBookendFileName;
-
- public:
-  BookendAsyncResource() : AsyncAsset(kBookendFileName) {}
-  virtual ~BookendAsyncResource() {}
-  virtual void Load() {}
-  virtual bool Finalize() { return true; }
-  virtual bool IsValid() { return true; }
-  static bool IsBookend(const AsyncAsset &res) {
-    return res.filename() == kBookendFileName;
-  }
-};
-
-// static
-const char *BookendAsyncResource::kBookendFileName = "bookend";
-
 AsyncLoader::AsyncLoader()
-    : loading_(nullptr), num_pending_requests_(0), worker_thread_(nullptr) {
+    : staged_bytes_(0),
+      max_staged_bytes_(64 * 1024 * 1024),
+      read_ahead_depth_(0),
+      completed_(nullptr),
+      num_done_(0),
+      next_worker_(0),
+      num_running_(0),
+      num_job_waiters_(0),
+      num_pending_requests_(0),
+      stop_mode_(kStopNow),
+      finalize_seconds_per_byte_(0.0),
+      start_time_(std::chrono::steady_clock::now()),
+      telemetry_enabled_(false),
+      executor_(nullptr) {
   mutex_ = SDL_CreateMutex();
-  job_semaphore_ = SDL_CreateSemaphore(0);
-  assert(mutex_ && job_semaphore_);
+  idle_cv_ = SDL_CreateCond();
+  assert(mutex_ && idle_cv_);
+  SetNumWorkers(1);
 }
 
 AsyncLoader::~AsyncLoader() {
   Stop();
-}
 
-void AsyncLoader::Stop() {
-  if (worker_thread_) {
-    StopLoadingWhenComplete();
-    SDL_WaitThread(static_cast<SDL_Thread *>(worker_thread_), nullptr);
-    worker_thread_ = nullptr;
-
-    if (mutex_) {
-      SDL_DestroyMutex(static_cast<SDL_mutex *>(mutex_));
-      mutex_ = nullptr;
-    }
-    if (job_semaphore_) {
-      SDL_DestroySemaphore(static_cast<SDL_semaphore *>(job_semaphore_));
-      job_semaphore_ = nullptr;
-    }
+  if (mutex_) {
+    SDL_DestroyMutex(static_cast<SDL_mutex *>(mutex_));
+    mutex_ = nullptr;
+  }
+  if (idle_cv_) {
+    SDL_DestroyCond(static_cast<SDL_cond *>(idle_cv_));
+    idle_cv_ = nullptr;
   }
 }
 
-void AsyncLoader::QueueJob(AsyncAsset *res) {
-  Lock([this, res]() {
-    queue_.push_back(res);
-    ++num_pending_requests_;
-  });
-  SDL_SemPost(static_cast<SDL_semaphore *>(job_semaphore_));
+void AsyncLoader::Lock(const std::function<void()> &body) {
+  auto err = SDL_LockMutex(static_cast<SDL_mutex *>(mutex_));
+  (void)err;
+  assert(err == 0);
+  body();
+  SDL_UnlockMutex(static_cast<SDL_mutex *>(mutex_));
 }
 
-void AsyncLoader::AbortJob(AsyncAsset *res) {
-  const bool was_loading =
-      LockReturn<bool>([this, res]() { return loading_ == res; });
-
-  if (was_loading) {
-    PauseLoading();
-  }
-
-  Lock([this, res]() {
-    auto iter = std::find(queue_.begin(), queue_.end(), res);
-    if (iter != queue_.end()) {
-      queue_.erase(iter);
-      --num_pending_requests_;
-    }
-
-    iter = std::find(done_.begin(), done_.end(), res);
-    if (iter != done_.end()) {
-      done_.erase(iter);
-      --num_pending_requests_;
-    }
-  });
-
-  if (was_loading) {
-    StartLoading();
-  }
+void AsyncLoader::Wait() {
+  SDL_CondWait(static_cast<SDL_cond *>(idle_cv_),
+               static_cast<SDL_mutex *>(mutex_));
 }
 
-void AsyncLoader::LoaderWorker() {
-  for (;;) {
-    Lock([this]() { loading_ = queue_.empty() ? nullptr : queue_.front(); });
-    if (!loading_) {
-      SDL_SemWait(static_cast<SDL_semaphore *>(job_semaphore_));
-      continue;
-    }
-    // Stop loading once we reach the bookend enqueued by
-    // StopLoadingWhenComplete(). To start loading again, call StartLoading().
-    if (BookendAsyncResource::IsBookend(*loading_)) break;
-    LogInfo(kApplication, "async load: %s", loading_->filename_.c_str());
-    loading_->Load();
-    Lock([this]() {
-      queue_.pop_front();
-      done_.push_back(loading_);
-      loading_ = nullptr;
-    });
-  }
+void AsyncLoader::Notify() {
+  SDL_CondBroadcast(static_cast<SDL_cond *>(idle_cv_));
 }
 
-int AsyncLoader::LoaderThread(void *user_data) {
-  reinterpret_cast<AsyncLoader *>(user_data)->LoaderWorker();
-  return 0;
+ThreadPoolExecutor::ThreadPoolExecutor(int num_threads) : stopping_(false) {
+  assert(num_threads > 0);
+  mutex_ = SDL_CreateMutex();
+  task_cv_ = SDL_CreateCond();
+  assert(mutex_ && task_cv_);
+  for (int i = 0; i < num_threads; ++i) {
+    Thread thread = SDL_CreateThread(ThreadPoolExecutor::PoolThread,
+                                     "FPL Loader Thread", this);
+    assert(thread);
+    threads_.push_back(thread);
+  }
 }
 
-void AsyncLoader::StartLoading() {
-  worker_thread_ =
-      SDL_CreateThread(AsyncLoader::LoaderThread, "FPL Loader Thread", this);
-  assert(worker_thread_);
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+  SDL_LockMutex(static_cast<SDL_mutex *>(mutex_));
+  stopping_ = true;
+  SDL_CondBroadcast(static_cast<SDL_cond *>(task_cv_));
+  SDL_UnlockMutex(static_cast<SDL_mutex *>(mutex_));
+  for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+    SDL_WaitThread(static_cast<SDL_Thread *>(*it), nullptr);
+  }
+  SDL_DestroyMutex(static_cast<SDL_mutex *>(mutex_));
+  SDL_DestroyCond(static_cast<SDL_cond *>(task_cv_));
 }
 
-void AsyncLoader::PauseLoading() { assert(false); }
-
-void AsyncLoader::StopLoadingWhenComplete() {
-  // When the loader thread hits the bookend, it will exit.
-  static BookendAsyncResource bookend;
-  QueueJob(&bookend);
+void ThreadPoolExecutor::Execute(const std::function<void()> &task) {
+  SDL_LockMutex(static_cast<SDL_mutex *>(mutex_));
+  tasks_.push_back(task);
+  SDL_CondSignal(static_cast<SDL_cond *>(task_cv_));
+  SDL_UnlockMutex(static_cast<SDL_mutex *>(mutex_));
 }
 
-bool AsyncLoader::TryFinalize() {
+void ThreadPoolExecutor::RunTasks() {
   for (;;) {
-    auto res = LockReturn<AsyncAsset *>(
-        [this]() { return done_.empty() ? nullptr : done_.front(); });
-    if (!res) break;
-    bool ok = res->Finalize();
-    if (!ok) {
-      // Can't do much here, since res is already constructed. Caller has to
-      // check IsValid() to know if resource can be used.
+    std::function<void()> task;
+    SDL_LockMutex(static_cast<SDL_mutex *>(mutex_));
+    while (tasks_.empty() && !stopping_) {
+      SDL_CondWait(static_cast<SDL_cond *>(task_cv_),
+                   static_cast<SDL_mutex *>(mutex_));
+    }
+    if (!tasks_.empty()) {
+      task.swap(tasks_.front());
+      tasks_.pop_front();
     }
-    Lock([this, res]() {
-      // It's possible that the resource was destroyed during its finalize
-      // callbacks, so ensure that it's still the first item in done_.
-      if (done_.size() > 0 && done_.front() == res) {
-        done_.pop_front();
-      }
-      --num_pending_requests_;
-    });
+    SDL_UnlockMutex(static_cast<SDL_mutex *>(mutex_));
+    if (!task) return;
+    task();
   }
-  return LockReturn<bool>([this]() { return num_pending_requests_ == 0; });
 }
 
-void AsyncLoader::Lock(const std::function<void()> &body) {
-  auto err = SDL_LockMutex(static_cast<SDL_mutex *>(mutex_));
-  (void)err;
-  assert(err == 0);
-  body();
-  SDL_UnlockMutex(static_cast<SDL_mutex *>(mutex_));
+// static
+int ThreadPoolExecutor::PoolThread(void *user_data) {
+  static_cast<ThreadPoolExecutor *>(user_data)->RunTasks();
+  return 0;
 }
 
 }  // namespace fplbase
@@ -18,137 +18,90 @@
 
 namespace fplbase {
 
-AsyncLoader::AsyncLoader() : loading_(nullptr), num_pending_requests_(0) {
+AsyncLoader::AsyncLoader()
+    : staged_bytes_(0),
+      max_staged_bytes_(64 * 1024 * 1024),
+      read_ahead_depth_(0),
+      completed_(nullptr),
+      num_done_(0),
+      next_worker_(0),
+      num_running_(0),
+      num_job_waiters_(0),
+      num_pending_requests_(0),
+      stop_mode_(kStopNow),
+      finalize_seconds_per_byte_(0.0),
+      start_time_(std::chrono::steady_clock::now()),
+      telemetry_enabled_(false),
+      executor_(nullptr) {
+  SetNumWorkers(1);
 }
 
 AsyncLoader::~AsyncLoader() {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    queue_.clear();
-  }
+  Lock([this]() {
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+      for (int p = 0; p < kLoadPriorityCount; ++p) it->queues[p].clear();
+    }
+    for (int p = 0; p < kLoadPriorityCount; ++p) io_queues_[p].clear();
+  });
   Stop();
 }
 
-void AsyncLoader::Stop() {
-  if (worker_thread_.joinable()) {
-    StopLoadingWhenComplete();
-    worker_thread_.join();
-  }
+void AsyncLoader::Lock(const std::function<void()> &body) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  body();
 }
 
-void AsyncLoader::QueueJob(AsyncAsset *res) {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push_back(res);
-    ++num_pending_requests_;
-  }
-  job_cv_.notify_one();
+void AsyncLoader::Wait() {
+  // Called with mutex_ held; condition_variable_any releases it while waiting.
+  idle_cv_.wait(mutex_);
 }
 
-void AsyncLoader::AbortJob(AsyncAsset *res) {
-  bool was_loading = false;
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    was_loading = loading_ == res;
-  }
+void AsyncLoader::Notify() { idle_cv_.notify_all(); }
 
-  if (was_loading) {
-    PauseLoading();
+ThreadPoolExecutor::ThreadPoolExecutor(int num_threads) : stopping_(false) {
+  assert(num_threads > 0);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(std::thread(ThreadPoolExecutor::PoolThread, this));
   }
+}
 
+ThreadPoolExecutor::~ThreadPoolExecutor() {
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    auto iter = std::find(queue_.begin(), queue_.end(), res);
-    if (iter != queue_.end()) {
-      queue_.erase(iter);
-      --num_pending_requests_;
-    }
-
-    iter = std::find(done_.begin(), done_.end(), res);
-    if (iter != done_.end()) {
-      done_.erase(iter);
-      --num_pending_requests_;
-    }
+    stopping_ = true;
   }
-
-  if (was_loading) {
-    StartLoading();
-  }
-}
-
-void AsyncLoader::StartLoading() {
-  if (!worker_thread_.joinable()) {
-    worker_thread_ = std::thread(AsyncLoader::LoaderThread, this);
+  task_cv_.notify_all();
+  for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+    it->join();
   }
 }
 
-void AsyncLoader::PauseLoading() {
+void ThreadPoolExecutor::Execute(const std::function<void()> &task) {
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push_front(nullptr);
+    tasks_.push_back(task);
   }
-  job_cv_.notify_one();
-  worker_thread_.join();
+  task_cv_.notify_one();
 }
 
-void AsyncLoader::StopLoadingWhenComplete() { QueueJob(nullptr); }
-
-bool AsyncLoader::TryFinalize() {
-  for (;;) {
-    AsyncAsset *resource = nullptr;
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (done_.size() > 0) resource = done_[0];
-    }
-
-    if (!resource) break;
-    bool ok = resource->Finalize();
-    if (!ok) {
-      // Can't do much here, since res is already constructed. Caller has to
-      // check IsValid() to know if resource can be used.
-    }
-
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      // It's possible that the resource was destroyed during its finalize
-      // callbacks, so ensure that it's still the first item in done_.
-      if (done_.size() > 0 && done_.front() == resource) {
-        done_.pop_front();
-      }
-      --num_pending_requests_;
-    }
-  }
-  bool finished;
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    finished = num_pending_requests_ == 0;
-  }
-  return finished;
-}
-
-void AsyncLoader::LoaderWorker() {
+void ThreadPoolExecutor::RunTasks() {
   for (;;) {
+    std::function<void()> task;
     {
       std::unique_lock<std::mutex> lock(mutex_);
-      job_cv_.wait(lock, [this]() { return queue_.size() > 0; });
-      loading_ = queue_.front();
-      queue_.pop_front();
+      while (tasks_.empty() && !stopping_) task_cv_.wait(lock);
+      if (tasks_.empty()) return;
+      task.swap(tasks_.front());
+      tasks_.pop_front();
     }
-
-    if (!loading_) {
-      break;
-    }
-
-    loading_->Load();
-    std::lock_guard<std::mutex> lock(mutex_);
-    done_.push_back(loading_);
-    loading_ = nullptr;
+    task();
   }
 }
 
 // static
-int AsyncLoader::LoaderThread(void *user_data) {
-  reinterpret_cast<AsyncLoader *>(user_data)->LoaderWorker();
+int ThreadPoolExecutor::PoolThread(void *user_data) {
+  static_cast<ThreadPoolExecutor *>(user_data)->RunTasks();
   return 0;
 }
+
 }  // namespace fplbase
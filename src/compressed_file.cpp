@@ -0,0 +1,220 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/compressed_file.h"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+
+#include "flatbuffers/flatbuffers.h"
+#include "fplbase/utilities.h"
+
+// Disable warnings in STB_image and STB_image_write.
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4100)  // unused reference
+#pragma warning(disable : 4244)  // conversion possible loss of data
+#pragma warning(disable : 4189)  // local variable not referenced
+#pragma warning(disable : 4505)  // unreferenced local function
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif /* _MSC_VER */
+
+// stb_image is implemented in texture_common.cpp, only its zlib decoder is
+// used here.
+#undef STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+// Only its zlib compressor is used, which nothing else needs.
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// Pop warning status.
+#ifdef _MSC_VER
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic pop
+#endif
+
+namespace fplbase {
+
+// Limits blocks to what stb's zlib functions can take, and what a corrupt
+// header can make DecompressFileData() allocate per block.
+static const size_t kMaxBlockSize = 64 * 1024 * 1024;
+// Files are only split across threads when each gets at least this much to
+// decompress, since starting a thread costs about as much as decompressing
+// a few KB.
+static const size_t kMinBytesPerThread = 1024 * 1024;
+static const int kMaxDefaultDecompressionThreads = 4;
+// Deflate can't shrink data to less than this fraction of its size, so
+// blocks that claim to have, are corrupt.
+static const size_t kMaxCompressionRatio = 1032;
+// The level stbi_zlib_compress() compresses with, which is at least 5.
+static const int kCompressionQuality = 8;
+
+static int DefaultDecompressionThreads() {
+  const int num_cores = static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(1, std::min(num_cores, kMaxDefaultDecompressionThreads));
+}
+
+static std::atomic<int> g_max_decompression_threads(
+    DefaultDecompressionThreads());
+
+void SetMaxDecompressionThreads(int max_threads) {
+  g_max_decompression_threads = std::max(1, max_threads);
+}
+
+int MaxDecompressionThreads() { return g_max_decompression_threads; }
+
+bool IsCompressedFileData(const void *data, size_t size) {
+  return size >= kCompressedFileHeaderSize &&
+         memcmp(data, kCompressedFileMagic, sizeof(kCompressedFileMagic)) == 0;
+}
+
+bool CompressFileData(const std::string &src, size_t block_size,
+                      std::string *dest) {
+  if (block_size == 0 || block_size > kMaxBlockSize) return false;
+  const size_t num_blocks = (src.size() + block_size - 1) / block_size;
+  std::string header(kCompressedFileHeaderSize + num_blocks * 4, 0);
+  memcpy(&header[0], kCompressedFileMagic, sizeof(kCompressedFileMagic));
+  flatbuffers::WriteScalar(&header[4], static_cast<uint32_t>(block_size));
+  flatbuffers::WriteScalar(&header[8], static_cast<uint64_t>(src.size()));
+
+  std::string blocks;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const size_t offset = i * block_size;
+    const size_t raw_size = std::min(block_size, src.size() - offset);
+    // stbi_zlib_compress() doesn't change its input, despite the signature.
+    unsigned char *raw = reinterpret_cast<unsigned char *>(
+        const_cast<char *>(src.data() + offset));
+    int compressed_size = 0;
+    unsigned char *compressed =
+        stbi_zlib_compress(raw, static_cast<int>(raw_size), &compressed_size,
+                           kCompressionQuality);
+    if (compressed && static_cast<size_t>(compressed_size) < raw_size) {
+      blocks.append(reinterpret_cast<const char *>(compressed),
+                    compressed_size);
+    } else {
+      compressed_size = static_cast<int>(raw_size);
+      blocks.append(src, offset, raw_size);
+    }
+    free(compressed);
+    flatbuffers::WriteScalar(&header[kCompressedFileHeaderSize + i * 4],
+                             static_cast<uint32_t>(compressed_size));
+  }
+  dest->swap(header);
+  dest->append(blocks);
+  return true;
+}
+
+namespace {
+
+// Where one block is in the compressed file, and where it goes.
+struct Block {
+  const char *data;
+  size_t size;
+  size_t raw_offset;
+  size_t raw_size;
+};
+
+}  // namespace
+
+static bool DecompressBlock(const Block &block, char *dest) {
+  if (block.size == block.raw_size) {
+    memcpy(dest, block.data, block.size);
+    return true;
+  }
+  const int size = stbi_zlib_decode_buffer(
+      dest, static_cast<int>(block.raw_size), block.data,
+      static_cast<int>(block.size));
+  return size >= 0 && static_cast<size_t>(size) == block.raw_size;
+}
+
+bool DecompressFileData(const void *data, size_t size, std::string *dest) {
+  const char *file = static_cast<const char *>(data);
+  if (!IsCompressedFileData(data, size)) {
+    LogError(kError, "Not a compressed file");
+    return false;
+  }
+  const size_t block_size = flatbuffers::ReadScalar<uint32_t>(file + 4);
+  const uint64_t raw_size = flatbuffers::ReadScalar<uint64_t>(file + 8);
+  // Checked against the size of the file before allocating anything, since
+  // every block takes at least 5 bytes: its size, and one of data.
+  const uint64_t num_blocks =
+      block_size ? raw_size / block_size + (raw_size % block_size != 0) : 0;
+  if (block_size == 0 || block_size > kMaxBlockSize ||
+      raw_size > std::numeric_limits<size_t>::max() ||
+      num_blocks > (size - kCompressedFileHeaderSize) / 5) {
+    LogError(kError, "Corrupt compressed file header");
+    return false;
+  }
+
+  std::vector<Block> blocks(static_cast<size_t>(num_blocks));
+  size_t offset = kCompressedFileHeaderSize + blocks.size() * 4;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    Block &block = blocks[i];
+    block.size = flatbuffers::ReadScalar<uint32_t>(
+        file + kCompressedFileHeaderSize + i * 4);
+    block.data = file + offset;
+    block.raw_offset = i * block_size;
+    block.raw_size = std::min(block_size,
+                              static_cast<size_t>(raw_size) - block.raw_offset);
+    if (block.size > size - offset) {
+      LogError(kError, "Truncated compressed file");
+      return false;
+    }
+    if (block.size == 0 || block.size > block.raw_size ||
+        block.raw_size / kMaxCompressionRatio > block.size) {
+      LogError(kError, "Corrupt compressed file block size");
+      return false;
+    }
+    offset += block.size;
+  }
+
+  dest->assign(static_cast<size_t>(raw_size), 0);
+  char *raw = dest->empty() ? nullptr : &(*dest)[0];
+  const int num_threads = static_cast<int>(std::min<uint64_t>(
+      std::min<uint64_t>(MaxDecompressionThreads(), blocks.size()),
+      std::max<uint64_t>(1, raw_size / kMinBytesPerThread)));
+
+  // Each thread, including this one, takes the next block until there are
+  // none left, so threads that get easy blocks do more of them.
+  std::atomic<size_t> next_block(0);
+  std::atomic<bool> ok(true);
+  auto decompress_blocks = [&]() {
+    for (size_t i = next_block++; i < blocks.size() && ok; i = next_block++) {
+      if (!DecompressBlock(blocks[i], raw + blocks[i].raw_offset)) ok = false;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.push_back(std::thread(decompress_blocks));
+  }
+  decompress_blocks();
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+
+  if (!ok) {
+    LogError(kError, "Corrupt compressed file block");
+    dest->clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,603 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/file_system.h"
+#include "fplbase/asset_pack.h"
+#include "fplbase/compressed_file.h"
+#include "fplbase/read_mostly_mutex.h"
+#include "fplbase/utilities.h"
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
+namespace fplbase {
+
+namespace {
+
+struct Mount {
+  Mount(MountType type, const std::string &name)
+      : type(type),
+        name(name),
+        indexed(false),
+        num_hits(0),
+        num_misses(0),
+        num_bytes(0) {}
+
+  MountType type;
+  std::string name;
+  // kMountAssetPack: the pack.
+  std::shared_ptr<const AssetPack> pack;
+  // kMountMemory: the contents of each file, by name.
+  std::unordered_map<std::string, std::string> files;
+  // kMountDirectory: the directory, with a trailing '/', and the files below
+  // it, relative to it, if it could be listed.
+  std::string prefix;
+  bool indexed;
+  std::unordered_set<std::string> index;
+
+  mutable std::atomic<int> num_hits;
+  mutable std::atomic<int> num_misses;
+  mutable std::atomic<uint64_t> num_bytes;
+
+  void CountHit(size_t size) const {
+    ++num_hits;
+    num_bytes += size;
+  }
+};
+
+// The mounts, most recently mounted first. Never changed once published in
+// g_mounts, so readers can search it without holding a lock.
+typedef std::vector<std::shared_ptr<const Mount>> MountTable;
+
+// What LoadFile() and LoadFileView() need, taken together under one lock.
+struct FileSystemState {
+  std::shared_ptr<const MountTable> mounts;
+  LoadFileFunction load_file_function;
+  bool load_file_function_is_raw;
+  unsigned generation;
+};
+
+}  // namespace
+
+// Guards g_mounts through g_generation.
+static ReadMostlyMutex g_file_system_mutex;
+static std::shared_ptr<const MountTable> g_mounts(new MountTable());
+// Function called by LoadFile() for files no mount has.
+static LoadFileFunction g_load_file_function = LoadFileRaw;
+// Whether g_load_file_function is LoadFileRaw, which reads the same files
+// LoadFileView() maps.
+static bool g_load_file_function_is_raw = true;
+// The files found in no mount, and not by LoadFileRaw() either.
+static std::unordered_set<std::string> g_missing_files;
+// Incremented whenever files may have appeared, so that a search that was
+// started before isn't added to g_missing_files.
+static unsigned g_generation = 0;
+
+// The statistics of g_load_file_function, and of g_missing_files.
+static Mount g_load_file_function_stats(kMountLoadFileFunction,
+                                        "LoadFileFunction");
+static std::atomic<int> g_num_cached_misses(0);
+
+// Gets the state to search for `filename` with. Returns false if it's known
+// to be missing.
+static bool GetFileSystemState(const char *filename, FileSystemState *state) {
+  const std::string name(filename);
+  ReadMostlyMutex::ReadLock lock(g_file_system_mutex);
+  if (!g_missing_files.empty() && g_missing_files.count(name)) {
+    ++g_num_cached_misses;
+    return false;
+  }
+  state->mounts = g_mounts;
+  state->load_file_function = g_load_file_function;
+  state->load_file_function_is_raw = g_load_file_function_is_raw;
+  state->generation = g_generation;
+  return true;
+}
+
+static std::shared_ptr<const MountTable> GetMounts() {
+  ReadMostlyMutex::ReadLock lock(g_file_system_mutex);
+  return g_mounts;
+}
+
+// Remembers that `filename` is missing, unless an app's load file function
+// was asked for it, which may yet produce it, e.g. once it's downloaded.
+static void NoteMissingFile(const char *filename,
+                            const FileSystemState &state) {
+  ++g_load_file_function_stats.num_misses;
+  if (!state.load_file_function_is_raw) return;
+  ReadMostlyMutex::WriteLock lock(g_file_system_mutex);
+  if (state.generation == g_generation) g_missing_files.insert(filename);
+}
+
+// Replaces the mount named `name` (if any) with `mount` (if not null).
+static bool ChangeMounts(const char *name,
+                         const std::shared_ptr<const Mount> &mount) {
+  std::shared_ptr<MountTable> mounts(new MountTable());
+  bool found = false;
+  ReadMostlyMutex::WriteLock lock(g_file_system_mutex);
+  if (mount) mounts->push_back(mount);
+  for (auto it = g_mounts->begin(); it != g_mounts->end(); ++it) {
+    if ((*it)->name == name && !found) {
+      found = true;
+    } else {
+      mounts->push_back(*it);
+    }
+  }
+  g_mounts = mounts;
+  g_missing_files.clear();
+  ++g_generation;
+  return found;
+}
+
+// Whether a directory mount may have `filename`.
+static bool MayHaveFile(const Mount &mount, const char *filename) {
+  return !mount.indexed || mount.index.count(filename) != 0;
+}
+
+// Finds a file that a pack or memory mount holds, without copying it.
+static const uint8_t *FindInMount(const Mount &mount, const char *filename,
+                                  size_t *size) {
+  if (mount.type == kMountAssetPack) {
+    return mount.pack->FindEntry(filename, size);
+  } else if (mount.type == kMountMemory) {
+    auto it = mount.files.find(filename);
+    if (it == mount.files.end()) return nullptr;
+    *size = it->second.size();
+    return reinterpret_cast<const uint8_t *>(it->second.data());
+  }
+  return nullptr;
+}
+
+// Reads a file of a directory mount. Unlike LoadFileRaw(), doesn't log
+// anything when the file is missing, since the next mount is tried then.
+static bool ReadFile(const std::string &path, std::string *dest) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+  bool ok = fseek(file, 0, SEEK_END) == 0;
+  const long size = ok ? ftell(file) : -1;
+  ok = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+  if (ok) {
+    dest->assign(static_cast<size_t>(size), 0);
+    ok = fread(&(*dest)[0], 1, dest->size(), file) == dest->size();
+  }
+  fclose(file);
+  return ok;
+}
+
+// Maps a whole file into memory. Returns nullptr, without logging anything,
+// if it can't.
+static void *MapWholeFile(const char *filename, size_t *size) {
+#if !defined(_WIN32)
+  const int fd = open(filename, O_RDONLY);
+  if (fd == -1) return nullptr;
+  struct stat sb;
+  void *p = MAP_FAILED;
+  // Empty files can't be mapped, and LoadFile() rejects them anyway.
+  if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+    p = mmap(0, static_cast<size_t>(sb.st_size), PROT_READ, MAP_PRIVATE, fd,
+             0);
+  }
+  close(fd);
+  if (p == MAP_FAILED) return nullptr;
+  *size = static_cast<size_t>(sb.st_size);
+  return p;
+#else
+  (void)filename;
+  (void)size;
+  return nullptr;
+#endif  // !defined(_WIN32)
+}
+
+// Asks the OS to start reading a file into its cache. Returns false if it
+// can't.
+static bool AdviseFileWillNeed(const char *filename) {
+#if defined(__linux__) || defined(__APPLE__)
+  const int fd = open(filename, O_RDONLY);
+  if (fd == -1) return false;
+#if defined(__linux__)
+  const bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0;
+#else
+  struct stat sb;
+  bool ok = fstat(fd, &sb) == 0;
+  if (ok) {
+    struct radvisory advice;
+    advice.ra_offset = 0;
+    advice.ra_count = static_cast<int>(sb.st_size);
+    ok = fcntl(fd, F_RDADVISE, &advice) != -1;
+  }
+#endif  // defined(__linux__)
+  // The cache keeps what is read after the file is closed.
+  close(fd);
+  return ok;
+#else
+  (void)filename;
+  return false;
+#endif  // defined(__linux__) || defined(__APPLE__)
+}
+
+// Asks the OS to start paging in mapped memory. Returns false if it can't.
+static bool AdviseMemoryWillNeed(const uint8_t *data, size_t size) {
+#if !defined(_WIN32)
+  const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t start =
+      reinterpret_cast<uintptr_t>(data) & ~(page_size - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(data) + size;
+  return madvise(reinterpret_cast<void *>(start), end - start,
+                 MADV_WILLNEED) == 0;
+#else
+  (void)data;
+  (void)size;
+  return false;
+#endif  // !defined(_WIN32)
+}
+
+#if !defined(_WIN32)
+// The directories being listed, by device and inode.
+typedef std::set<std::pair<dev_t, ino_t>> DirectoryIds;
+
+// Adds the files in `directory` and below to `index`, prefixed with
+// `relative`. Links to directories are followed, except to those in
+// `parents`, which would list them again and again.
+static bool ListDirectory(const std::string &directory,
+                          const std::string &relative, DirectoryIds *parents,
+                          std::unordered_set<std::string> *index) {
+  DIR *dir = opendir(directory.c_str());
+  if (!dir) return false;
+  struct stat dir_sb;
+  if (fstat(dirfd(dir), &dir_sb) != 0 ||
+      !parents->insert(std::make_pair(dir_sb.st_dev, dir_sb.st_ino)).second) {
+    closedir(dir);
+    return false;
+  }
+  for (struct dirent *entry = readdir(dir); entry; entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name == "." || name == "..") continue;
+    const std::string path = directory + "/" + name;
+    bool is_dir = entry->d_type == DT_DIR;
+    bool is_file = entry->d_type == DT_REG;
+    // Follows links, and asks file systems that don't report the type.
+    if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+      struct stat sb;
+      if (stat(path.c_str(), &sb) != 0) continue;
+      is_dir = S_ISDIR(sb.st_mode);
+      is_file = S_ISREG(sb.st_mode);
+    }
+    if (is_dir) {
+      ListDirectory(path, relative + name + "/", parents, index);
+    } else if (is_file) {
+      index->insert(relative + name);
+    }
+  }
+  parents->erase(std::make_pair(dir_sb.st_dev, dir_sb.st_ino));
+  closedir(dir);
+  return true;
+}
+#endif  // !defined(_WIN32)
+
+bool MountDirectory(const char *directory) {
+  std::shared_ptr<Mount> mount(new Mount(kMountDirectory, directory));
+  mount->prefix = directory;
+  if (!mount->prefix.empty() && mount->prefix.back() != '/') {
+    mount->prefix += '/';
+  }
+#if !defined(_WIN32)
+  DirectoryIds parents;
+  if (!ListDirectory(directory, "", &parents, &mount->index)) {
+    LogError(kError, "Can't mount directory %s", directory);
+    return false;
+  }
+  mount->indexed = true;
+#endif  // !defined(_WIN32)
+  ChangeMounts(directory, mount);
+  return true;
+}
+
+void MountMemoryFiles(
+    const char *name,
+    const std::vector<std::pair<std::string, std::string>> &files) {
+  std::shared_ptr<Mount> mount(new Mount(kMountMemory, name));
+  mount->files.insert(files.begin(), files.end());
+  ChangeMounts(name, mount);
+}
+
+bool MountAssetPack(const char *filename) {
+  std::shared_ptr<AssetPack> pack(new AssetPack());
+  if (!pack->Open(filename)) return false;
+  std::shared_ptr<Mount> mount(new Mount(kMountAssetPack, filename));
+  mount->pack = pack;
+  ChangeMounts(filename, mount);
+  return true;
+}
+
+bool Unmount(const char *name) {
+  return ChangeMounts(name, std::shared_ptr<const Mount>());
+}
+
+bool UnmountAssetPack(const char *filename) { return Unmount(filename); }
+
+bool ReadAheadFile(const char *filename) {
+  std::shared_ptr<const MountTable> mounts;
+  bool load_file_function_is_raw;
+  {
+    // Not GetFileSystemState(), since a hint isn't a miss.
+    ReadMostlyMutex::ReadLock lock(g_file_system_mutex);
+    if (!g_missing_files.empty() && g_missing_files.count(filename)) {
+      return false;
+    }
+    mounts = g_mounts;
+    load_file_function_is_raw = g_load_file_function_is_raw;
+  }
+  for (auto it = mounts->begin(); it != mounts->end(); ++it) {
+    const Mount &mount = **it;
+    if (mount.type == kMountDirectory) {
+      if (MayHaveFile(mount, filename) &&
+          AdviseFileWillNeed((mount.prefix + filename).c_str())) {
+        return true;
+      }
+    } else {
+      size_t size = 0;
+      const uint8_t *data = FindInMount(mount, filename, &size);
+      // Files in memory need no reading.
+      if (data) {
+        return mount.type == kMountAssetPack &&
+               AdviseMemoryWillNeed(data, size);
+      }
+    }
+  }
+// On Android, LoadFileRaw() reads from the APK, which can't be hinted.
+#if !defined(__ANDROID__)
+  if (load_file_function_is_raw) return AdviseFileWillNeed(filename);
+#else
+  (void)load_file_function_is_raw;
+#endif  // !defined(__ANDROID__)
+  return false;
+}
+
+std::string ResolveMountedPath(const char *filename) {
+  const std::shared_ptr<const MountTable> mounts = GetMounts();
+  for (auto it = mounts->begin(); it != mounts->end(); ++it) {
+    const Mount &mount = **it;
+    if (mount.type == kMountDirectory) {
+      if (!MayHaveFile(mount, filename)) continue;
+      const std::string path = mount.prefix + filename;
+      // Directories that couldn't be listed must be asked.
+      if (mount.indexed) return path;
+      FILE *file = fopen(path.c_str(), "rb");
+      if (!file) continue;
+      fclose(file);
+      return path;
+    }
+    size_t size = 0;
+    if (FindInMount(mount, filename, &size)) return std::string();
+  }
+  return filename;
+}
+
+void ForgetMissingFiles() {
+  ReadMostlyMutex::WriteLock lock(g_file_system_mutex);
+  g_missing_files.clear();
+  ++g_generation;
+}
+
+LoadFileFunction SetLoadFileFunction(LoadFileFunction load_file_function) {
+  ReadMostlyMutex::WriteLock lock(g_file_system_mutex);
+  LoadFileFunction previous_function = g_load_file_function;
+  if (load_file_function) {
+    g_load_file_function = load_file_function;
+    g_load_file_function_is_raw = false;
+  } else {
+    g_load_file_function = LoadFileRaw;
+    g_load_file_function_is_raw = true;
+  }
+  g_missing_files.clear();
+  ++g_generation;
+  return previous_function;
+}
+
+const uint8_t *FindInAssetPacks(const char *filename, size_t *size,
+                                std::shared_ptr<const AssetPack> *pack) {
+  const std::shared_ptr<const MountTable> mounts = GetMounts();
+  for (auto it = mounts->begin(); it != mounts->end(); ++it) {
+    if ((*it)->type != kMountAssetPack) continue;
+    const uint8_t *data = (*it)->pack->FindEntry(filename, size);
+    if (data) {
+      *pack = (*it)->pack;
+      return data;
+    }
+  }
+  return nullptr;
+}
+
+bool LoadFileFromAssetPacks(const char *filename, std::string *dest) {
+  std::shared_ptr<const AssetPack> pack;
+  size_t size = 0;
+  const uint8_t *data = FindInAssetPacks(filename, &size, &pack);
+  if (!data) return false;
+  // Copied without holding the pack's mount, since this may page it in.
+  dest->assign(reinterpret_cast<const char *>(data), size);
+  return true;
+}
+
+// Searches the mounts and the load file function for a file, like
+// LoadFile(), but without decompressing it.
+static bool LoadStoredFile(const char *filename, std::string *dest) {
+  FileSystemState state;
+  if (!GetFileSystemState(filename, &state)) return false;
+  for (auto it = state.mounts->begin(); it != state.mounts->end(); ++it) {
+    const Mount &mount = **it;
+    if (mount.type == kMountDirectory) {
+      if (MayHaveFile(mount, filename) &&
+          ReadFile(mount.prefix + filename, dest)) {
+        mount.CountHit(dest->size());
+        return true;
+      }
+    } else {
+      size_t size = 0;
+      const uint8_t *data = FindInMount(mount, filename, &size);
+      if (data) {
+        dest->assign(reinterpret_cast<const char *>(data), size);
+        mount.CountHit(size);
+        return true;
+      }
+    }
+    ++mount.num_misses;
+  }
+  assert(state.load_file_function);
+  if (state.load_file_function(filename, dest)) {
+    g_load_file_function_stats.CountHit(dest->size());
+    return true;
+  }
+  NoteMissingFile(filename, state);
+  return false;
+}
+
+// Replaces a compressed file by its contents. Leaves other files alone.
+static bool DecompressIfCompressed(const char *filename, const void *data,
+                                   size_t size, std::string *dest) {
+  if (!IsCompressedFileData(data, size)) return true;
+  std::string contents;
+  if (!DecompressFileData(data, size, &contents)) {
+    LogError(kError, "Can't decompress %s", filename);
+    return false;
+  }
+  dest->swap(contents);
+  return true;
+}
+
+bool LoadFile(const char *filename, std::string *dest) {
+  if (!LoadStoredFile(filename, dest)) return false;
+  if (!DecompressIfCompressed(filename, dest->data(), dest->size(), dest)) {
+    dest->clear();
+    return false;
+  }
+  return true;
+}
+
+bool LoadFileView(const char *filename, FileView *view) {
+  view->Reset();
+  FileSystemState state;
+  if (!GetFileSystemState(filename, &state)) return false;
+  bool found = false;
+  for (auto it = state.mounts->begin(); it != state.mounts->end() && !found;
+       ++it) {
+    const Mount &mount = **it;
+    if (mount.type == kMountDirectory) {
+      if (MayHaveFile(mount, filename)) {
+        const std::string path = mount.prefix + filename;
+        view->mapped_ = MapWholeFile(path.c_str(), &view->mapped_size_);
+        if (view->mapped_) {
+          view->data_ = static_cast<const uint8_t *>(view->mapped_);
+          view->size_ = view->mapped_size_;
+          found = true;
+        } else {
+          found = ReadFile(path, &view->contents_);
+        }
+      }
+    } else {
+      view->data_ = FindInMount(mount, filename, &view->size_);
+      if (view->data_) {
+        // Keeps the pack mapped, or the files in memory, while in use.
+        view->owner_ = *it;
+        found = true;
+      }
+    }
+    if (found) {
+      mount.CountHit(view->size());
+    } else {
+      ++mount.num_misses;
+    }
+  }
+
+// On Android, LoadFileRaw() reads from the APK, which can't be mapped.
+#if !defined(__ANDROID__)
+  if (!found && state.load_file_function_is_raw) {
+    view->mapped_ = MapWholeFile(filename, &view->mapped_size_);
+    if (view->mapped_) {
+      view->data_ = static_cast<const uint8_t *>(view->mapped_);
+      view->size_ = view->mapped_size_;
+      g_load_file_function_stats.CountHit(view->size_);
+      found = true;
+    }
+  }
+#endif  // !defined(__ANDROID__)
+  if (!found) {
+    assert(state.load_file_function);
+    if (!state.load_file_function(filename, &view->contents_)) {
+      NoteMissingFile(filename, state);
+      return false;
+    }
+    g_load_file_function_stats.CountHit(view->contents_.size());
+  }
+
+  if (!IsCompressedFileData(view->data(), view->size())) return true;
+  // Decompressed while the compressed file is still mapped, then released.
+  std::string contents;
+  const bool ok = DecompressIfCompressed(filename, view->data(), view->size(),
+                                         &contents);
+  view->Reset();
+  view->contents_.swap(contents);
+  return ok;
+}
+
+static void AddMountStats(const Mount &mount, std::vector<MountStats> *stats) {
+  MountStats mount_stats;
+  mount_stats.name = mount.name;
+  mount_stats.type = mount.type;
+  mount_stats.num_hits = mount.num_hits;
+  mount_stats.num_misses = mount.num_misses;
+  mount_stats.num_bytes = mount.num_bytes;
+  stats->push_back(mount_stats);
+}
+
+void GetMountStats(std::vector<MountStats> *stats) {
+  const std::shared_ptr<const MountTable> mounts = GetMounts();
+  stats->clear();
+  for (auto it = mounts->begin(); it != mounts->end(); ++it) {
+    AddMountStats(**it, stats);
+  }
+  AddMountStats(g_load_file_function_stats, stats);
+}
+
+int NumCachedMisses() { return g_num_cached_misses; }
+
+static void ResetStats(const Mount &mount) {
+  mount.num_hits = 0;
+  mount.num_misses = 0;
+  mount.num_bytes = 0;
+}
+
+void ResetMountStats() {
+  const std::shared_ptr<const MountTable> mounts = GetMounts();
+  for (auto it = mounts->begin(); it != mounts->end(); ++it) {
+    ResetStats(**it);
+  }
+  ResetStats(g_load_file_function_stats);
+  g_num_cached_misses = 0;
+}
+
+}  // namespace fplbase
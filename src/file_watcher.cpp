@@ -0,0 +1,101 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/file_watcher.h"
+#include "fplbase/utilities.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#define FPLBASE_FILE_WATCHER_INOTIFY
+#include <errno.h>
+#include <sys/inotify.h>
+#endif
+
+namespace fplbase {
+
+#if defined(FPLBASE_FILE_WATCHER_INOTIFY)
+
+// Written by editors that save in place, and those that rename a new file
+// over the old one.
+static const uint32_t kWatchedEvents = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+FileWatcher::FileWatcher()
+    : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+  if (fd_ < 0) LogError(kError, "inotify_init1 failed: %d", errno);
+}
+
+FileWatcher::~FileWatcher() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool FileWatcher::IsSupported() { return true; }
+
+bool FileWatcher::Watch(const char *filename) {
+  if (fd_ < 0) return false;
+  const std::string name(filename);
+  if (files_.count(name)) return true;
+  const size_t slash = name.rfind('/');
+  const std::string prefix =
+      slash == std::string::npos ? std::string() : name.substr(0, slash + 1);
+  if (dir_watches_.count(prefix) == 0) {
+    const int wd = inotify_add_watch(
+        fd_, prefix.empty() ? "." : prefix.c_str(), kWatchedEvents);
+    if (wd < 0) return false;
+    dir_watches_[prefix] = wd;
+    dirs_[wd] = prefix;
+  }
+  files_.insert(name);
+  return true;
+}
+
+void FileWatcher::Poll(std::vector<std::string> *changed) {
+  if (fd_ < 0) return;
+  std::unordered_set<std::string> reported;
+  // Aligned like the inotify_events in it.
+  alignas(struct inotify_event) char buffer[4096];
+  for (;;) {
+    const ssize_t size = read(fd_, buffer, sizeof(buffer));
+    if (size <= 0) break;
+    for (ssize_t i = 0; i < size;) {
+      const struct inotify_event *event =
+          reinterpret_cast<const struct inotify_event *>(buffer + i);
+      i += sizeof(struct inotify_event) + event->len;
+      auto dir = dirs_.find(event->wd);
+      if (event->len == 0 || dir == dirs_.end()) continue;
+      const std::string name = dir->second + event->name;
+      if (files_.count(name) && reported.insert(name).second) {
+        changed->push_back(name);
+      }
+    }
+  }
+}
+
+#else
+
+FileWatcher::FileWatcher() : fd_(-1) {}
+
+FileWatcher::~FileWatcher() {}
+
+bool FileWatcher::IsSupported() { return false; }
+
+bool FileWatcher::Watch(const char *filename) {
+  (void)filename;
+  return false;
+}
+
+void FileWatcher::Poll(std::vector<std::string> *changed) { (void)changed; }
+
+#endif  // defined(FPLBASE_FILE_WATCHER_INOTIFY)
+
+}  // namespace fplbase
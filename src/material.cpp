@@ -99,12 +99,11 @@ Material *Material::LoadFromMaterialDef(const matdef::Material *matdef,
 Material *Material::LoadFromMaterialDef(const char *filename,
                                         const TextureLoaderFn &tlf) {
   const matdef::Material *def = nullptr;
-  std::string flatbuf;
-  if (LoadFile(filename, &flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf.c_str()), flatbuf.length());
+  FileView flatbuf;
+  if (LoadFileView(filename, &flatbuf)) {
+    flatbuffers::Verifier verifier(flatbuf.data(), flatbuf.size());
     assert(matdef::VerifyMaterialBuffer(verifier));
-    def = matdef::GetMaterial(flatbuf.c_str());
+    def = matdef::GetMaterial(flatbuf.data());
   }
   Material *mat = LoadFromMaterialDef(def, tlf);
   if (!mat) {
@@ -14,6 +14,7 @@
 
 #include "precompiled.h"
 
+#include <memory>
 #include <utility>
 
 #include "fplbase/flatbuffer_utils.h"
@@ -63,6 +64,32 @@ void CopyAttribute(const T *attr, uint8_t *&buf) {
 
 }  // namespace
 
+struct Mesh::Staging {
+  Staging()
+      : meshdef(nullptr),
+        min_position(mathfu::kZeros3f),
+        max_position(mathfu::kZeros3f),
+        upload_size(0) {}
+
+  // The mesh file read by Load(), which `meshdef` points into. Empty when
+  // staged by InitFromMeshDef(), which is passed the buffer instead.
+  FileView file;
+  const meshdef::Mesh *meshdef;
+  // Points into `meshdef` if the file was interleaved already.
+  InterleavedVertexData vertices;
+  vec3 min_position;
+  vec3 max_position;
+  // Only set for skinned meshes.
+  std::unique_ptr<mathfu::AffineTransform[]> bone_transform_inverses;
+  std::vector<uint8_t> bone_parents;
+  std::vector<std::string> bone_names;
+  std::vector<uint8_t> shader_bone_indices;
+  // The size of the vertex and index buffers.
+  size_t upload_size;
+
+  MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
+};
+
 Mesh::Mesh(const char *filename, MaterialCreateFn material_create_fn,
            Primitive primitive)
     : AsyncAsset(filename ? filename : ""),
@@ -73,7 +100,8 @@ Mesh::Mesh(const char *filename, MaterialCreateFn material_create_fn,
       min_position_(mathfu::kZeros3f),
       max_position_(mathfu::kZeros3f),
       default_bone_transform_inverses_(nullptr),
-      material_create_fn_(std::move(material_create_fn)) {}
+      material_create_fn_(std::move(material_create_fn)),
+      create_materials_in_load_(false) {}
 
 Mesh::Mesh(const void *vertex_data, size_t count, size_t vertex_size,
            const Attribute *format, vec3 *max_position, vec3 *min_position,
@@ -84,7 +112,8 @@ Mesh::Mesh(const void *vertex_data, size_t count, size_t vertex_size,
       num_vertices_(0),
       min_position_(mathfu::kZeros3f),
       max_position_(mathfu::kZeros3f),
-      default_bone_transform_inverses_(nullptr) {
+      default_bone_transform_inverses_(nullptr),
+      create_materials_in_load_(false) {
   LoadFromMemory(vertex_data, count, vertex_size, format, max_position,
                  min_position);
 }
@@ -157,23 +186,47 @@ size_t Mesh::VertexSize(const Attribute *attributes) {
 }
 
 void Mesh::Load() {
-  std::string *flatbuf = new std::string();
-  if (LoadFile(filename_.c_str(), flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf->c_str()), flatbuf->length());
-    assert(meshdef::VerifyMeshBuffer(verifier));
-    data_ = reinterpret_cast<const uint8_t *>(flatbuf);
-  } else {
+  Staging *staging = new Staging();
+  data_ = nullptr;
+  if (!LoadFileView(filename_.c_str(), &staging->file)) {
     LogError(kError, "Couldn\'t load: %s", filename_.c_str());
-    data_ = nullptr;
+    delete staging;
+    return;
+  }
+  if (IsLoadCancelled()) {
+    // Nobody wants the result anymore, so don't bother parsing it.
+    delete staging;
+    return;
+  }
+  flatbuffers::Verifier verifier(staging->file.data(), staging->file.size());
+  assert(meshdef::VerifyMeshBuffer(verifier));
+  if (!Stage(staging->file.data(), staging)) {
+    delete staging;
+    return;
+  }
+  data_ = reinterpret_cast<const uint8_t *>(staging);
+  if (create_materials_in_load_ && material_create_fn_) {
+    // Start loading the textures now, rather than once we're finalized.
+    auto surfaces = staging->meshdef->surfaces();
+    for (flatbuffers::uoffset_t i = 0; i < surfaces->size(); i++) {
+      auto surface = surfaces->Get(i);
+      auto mat = material_create_fn_(surface->material()->c_str(),
+                                     surface->material_info());
+      loaded_materials_.push_back(mat);
+      if (!mat) continue;
+      for (auto it = mat->textures().begin(); it != mat->textures().end();
+           ++it) {
+        AddDependency(*it);
+      }
+    }
   }
 }
 
 bool Mesh::Finalize() {
   if (data_) {
-    const std::string *flatbuf = reinterpret_cast<const std::string *>(data_);
-    bool ok = InitFromMeshDef(flatbuf->c_str());
-    delete flatbuf;
+    auto staging = reinterpret_cast<Staging *>(const_cast<uint8_t *>(data_));
+    bool ok = Upload(staging);
+    delete staging;
     data_ = nullptr;
     if (!ok) Clear();
   }
@@ -181,6 +234,26 @@ bool Mesh::Finalize() {
   return IsValid();
 }
 
+size_t Mesh::EstimateFinalizeCost() const {
+  return data_ ? reinterpret_cast<const Staging *>(data_)->upload_size : 0;
+}
+
+size_t Mesh::StagedBytes() const {
+  if (!data_) return 0;
+  auto staging = reinterpret_cast<const Staging *>(data_);
+  size_t bytes = sizeof(*staging) + staging->file.size() +
+                 staging->vertices.owned_vertex_data.capacity() +
+                 staging->bone_parents.size() *
+                     sizeof(staging->bone_transform_inverses[0]) +
+                 staging->bone_parents.capacity() +
+                 staging->shader_bone_indices.capacity();
+  for (auto it = staging->bone_names.begin(); it != staging->bone_names.end();
+       ++it) {
+    bytes += sizeof(*it) + it->capacity();
+  }
+  return bytes;
+}
+
 void Mesh::ParseInterleavedVertexData(const void *meshdef_buffer,
                                       InterleavedVertexData *ivd) {
   auto meshdef = meshdef::GetMesh(meshdef_buffer);
@@ -256,6 +329,11 @@ void Mesh::ParseInterleavedVertexData(const void *meshdef_buffer,
 }
 
 bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
+  Staging staging;
+  return Stage(meshdef_buffer, &staging) && Upload(&staging);
+}
+
+bool Mesh::Stage(const void *meshdef_buffer, Staging *staging) {
   auto meshdef = meshdef::GetMesh(meshdef_buffer);
   // Ensure the data version matches the runtime version, or that it was not
   // tied to a specific version to begin with (e.g. it's legacy or it's
@@ -265,17 +343,66 @@ bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
     LogError(kError, "Mesh file is stale: %s", filename_.c_str());
     return false;
   }
+  staging->meshdef = meshdef;
+
+  InterleavedVertexData &ivd = staging->vertices;
+  ParseInterleavedVertexData(meshdef_buffer, &ivd);
+  staging->upload_size = ivd.count * ivd.vertex_size;
+  for (flatbuffers::uoffset_t i = 0; i < meshdef->surfaces()->size(); i++) {
+    auto surface = meshdef->surfaces()->Get(i);
+    staging->upload_size +=
+        surface->indices() ? surface->indices()->Length() * sizeof(uint16_t)
+                           : surface->indices32()->Length() * sizeof(uint32_t);
+  }
+
+  if (meshdef->max_position() && meshdef->min_position()) {
+    staging->max_position = LoadVec3(meshdef->max_position());
+    staging->min_position = LoadVec3(meshdef->min_position());
+  } else if (ivd.count > 0) {
+    CalculateBounds(ivd.vertex_data, ivd.count, ivd.vertex_size,
+                    ivd.format.data(), &staging->min_position,
+                    &staging->max_position);
+  }
+
+  // Load the bone information.
+  if (ivd.has_skinning) {
+    const size_t num_bones = meshdef->bone_parents()->Length();
+    assert(meshdef->bone_transforms()->Length() == num_bones);
+    staging->bone_transform_inverses.reset(
+        new mathfu::AffineTransform[num_bones]);
+    staging->bone_names.resize(num_bones);
+    for (size_t i = 0; i < num_bones; ++i) {
+      flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
+      staging->bone_transform_inverses[i] =
+          LoadAffine(meshdef->bone_transforms()->Get(index));
+      staging->bone_names[i] = meshdef->bone_names()->Get(index)->c_str();
+    }
+    const uint8_t *bone_parents = meshdef->bone_parents()->data();
+    staging->bone_parents.assign(bone_parents, bone_parents + num_bones);
+    auto shader_bones = meshdef->shader_to_mesh_bones();
+    staging->shader_bone_indices.assign(
+        shader_bones->Data(), shader_bones->Data() + shader_bones->Length());
+  }
+  return true;
+}
+
+bool Mesh::Upload(Staging *staging) {
+  auto meshdef = staging->meshdef;
 
   // Load materials, return error if there is any material that is failed to
   // load.
   assert(material_create_fn_ != nullptr || meshdef->surfaces()->size() == 0);
   typedef std::pair<const meshdef::Surface *, Material *> SurfaceMaterialPair;
   std::vector<SurfaceMaterialPair> indices_data;
+  std::vector<Material *> loaded_materials;
+  loaded_materials.swap(loaded_materials_);
   for (size_t i = 0; i < meshdef->surfaces()->size(); i++) {
     flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
     auto surface = meshdef->surfaces()->Get(index);
-    auto mat = material_create_fn_(surface->material()->c_str(),
-                                   surface->material_info());
+    auto mat = i < loaded_materials.size()
+                   ? loaded_materials[i]
+                   : material_create_fn_(surface->material()->c_str(),
+                                         surface->material_info());
     if (!mat) {
       LogError(kError, "Invalid material file: ", surface->material()->c_str());
       return false;
@@ -294,36 +421,38 @@ bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
                mat, !surface->indices());
   }
 
-  InterleavedVertexData ivd;
-  ParseInterleavedVertexData(meshdef_buffer, &ivd);
-  vec3 max = meshdef->max_position() ? LoadVec3(meshdef->max_position())
-                                     : mathfu::kZeros3f;
-  vec3 min = meshdef->min_position() ? LoadVec3(meshdef->min_position())
-                                     : mathfu::kZeros3f;
+  const InterleavedVertexData &ivd = staging->vertices;
   LoadFromMemory(ivd.vertex_data, ivd.count, ivd.vertex_size, ivd.format.data(),
-                 meshdef->max_position() ? &max : nullptr,
-                 meshdef->min_position() ? &min : nullptr);
-  // Load the bone information.
-  if (ivd.has_skinning) {
-    const size_t num_bones = meshdef->bone_parents()->Length();
-    assert(meshdef->bone_transforms()->Length() == num_bones);
-    std::unique_ptr<mathfu::AffineTransform[]> bone_transforms(
-        new mathfu::AffineTransform[num_bones]);
-    std::vector<const char *> bone_names(num_bones);
-    for (size_t i = 0; i < num_bones; ++i) {
-      flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
-      bone_transforms[i] = LoadAffine(meshdef->bone_transforms()->Get(index));
-      bone_names[i] = meshdef->bone_names()->Get(index)->c_str();
-    }
-    const uint8_t *bone_parents = meshdef->bone_parents()->data();
-    SetBones(&bone_transforms[0], bone_parents, &bone_names[0], num_bones,
-             meshdef->shader_to_mesh_bones()->Data(),
-             meshdef->shader_to_mesh_bones()->Length());
+                 &staging->max_position, &staging->min_position);
+
+  // Take the bones, rather than copying them with SetBones().
+  if (staging->bone_transform_inverses) {
+    delete[] default_bone_transform_inverses_;
+    default_bone_transform_inverses_ =
+        staging->bone_transform_inverses.release();
+    bone_parents_.swap(staging->bone_parents);
+    bone_names_.swap(staging->bone_names);
+    shader_bone_indices_.swap(staging->shader_bone_indices);
   }
-
   return true;
 }
 
+void Mesh::CalculateBounds(const void *vertex_data, size_t count,
+                           size_t vertex_size, const Attribute *format,
+                           vec3 *min_position, vec3 *max_position) {
+  assert(count > 0);
+  auto data = static_cast<const float *>(vertex_data);
+  data += AttributeOffset(format, kPosition3f) / sizeof(float);
+  const size_t step = vertex_size / sizeof(float);
+  *min_position = vec3(data);
+  *max_position = *min_position;
+  for (size_t vertex = 1; vertex < count; vertex++) {
+    data += step;
+    *min_position = vec3::Min(*min_position, vec3(data));
+    *max_position = vec3::Max(*max_position, vec3(data));
+  }
+}
+
 void Mesh::set_format(const Attribute *format) {
   assert(IsValidFormat(format));
 
@@ -389,7 +518,7 @@ void Mesh::Clear() {
   shader_bone_indices_.clear();
 
   if (data_ != nullptr) {
-    delete reinterpret_cast<const std::string *>(data_);
+    delete reinterpret_cast<const Staging *>(data_);
     data_ = nullptr;
   }
 }
@@ -44,6 +44,27 @@ void Mesh::DestroyMeshImpl(MeshImpl *impl) { delete impl; }
 
 bool Mesh::IsValid() { return ValidBufferHandle(impl_->vbo); }
 
+AssetMemoryUsage Mesh::MemoryUsage() const {
+  AssetMemoryUsage usage(0, sizeof(*this));
+  if (ValidBufferHandle(impl_->vbo)) {
+    usage.gpu_bytes += vertex_size_ * num_vertices_;
+  }
+  for (auto it = indices_.begin(); it != indices_.end(); ++it) {
+    usage.gpu_bytes +=
+        it->count * (it->index_type == GL_UNSIGNED_INT ? sizeof(uint32_t)
+                                                       : sizeof(uint16_t));
+  }
+  usage.cpu_bytes += indices_.capacity() * sizeof(indices_[0]);
+  usage.cpu_bytes += num_bones() * sizeof(default_bone_transform_inverses_[0]);
+  usage.cpu_bytes += bone_parents_.capacity() + shader_bone_indices_.capacity();
+  for (auto it = bone_names_.begin(); it != bone_names_.end(); ++it) {
+    usage.cpu_bytes += sizeof(*it) + it->capacity();
+  }
+  // The parsed mesh file, while loaded but not yet finalized.
+  usage.cpu_bytes += StagedBytes();
+  return usage;
+}
+
 void Mesh::ClearPlatformDependent() {
   if (ValidBufferHandle(impl_->vbo)) {
     auto vbo = GlBufferHandle(impl_->vbo);
@@ -93,17 +114,8 @@ void Mesh::LoadFromMemory(const void *vertex_data, size_t count,
     max_position_ = *max_position;
     min_position_ = *min_position;
   } else {
-    auto data = static_cast<const float *>(vertex_data);
-    const Attribute *attribute = format;
-    data += AttributeOffset(attribute, kPosition3f) / sizeof(float);
-    const size_t step = vertex_size / sizeof(float);
-    min_position_ = vec3(data);
-    max_position_ = min_position_;
-    for (size_t vertex = 1; vertex < count; vertex++) {
-      data += step;
-      min_position_ = vec3::Min(min_position_, vec3(data));
-      max_position_ = vec3::Max(max_position_, vec3(data));
-    }
+    CalculateBounds(vertex_data, count, vertex_size, format, &min_position_,
+                    &max_position_);
   }
 }
 
@@ -263,6 +263,15 @@ bool LoadFileWithDirectives(const char *filename, std::string *dest,
                                       &all_includes, defines);
 }
 
+bool LoadFileWithDirectives(const char *filename, std::string *dest,
+                            const std::set<std::string> &defines,
+                            std::string *error_message,
+                            std::set<std::string> *files) {
+  files->clear();
+  return LoadFileWithDirectivesHelper(filename, dest, error_message, files,
+                                      defines);
+}
+
 bool LoadFileWithDirectives(const char *filename, std::string *dest,
                             std::string *error_message) {
   return LoadFileWithDirectives(filename, dest, kEmptySet, error_message);
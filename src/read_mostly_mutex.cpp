@@ -0,0 +1,48 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/read_mostly_mutex.h"
+
+namespace fplbase {
+
+void ReadMostlyMutex::LockWrite() {
+  writer_mutex_.Acquire();
+  // Readers that come in from now on wait in WaitForWriter(). Those already
+  // in are short, so spinning for them beats sleeping.
+  writing_.store(true);
+  for (int i = 0; i < kNumSlots; ++i) {
+    while (slots_[i].readers.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void ReadMostlyMutex::UnlockWrite() {
+  writing_.store(false, std::memory_order_release);
+  writer_mutex_.Release();
+}
+
+void ReadMostlyMutex::WaitForWriter(std::atomic<int> &readers) {
+  for (;;) {
+    while (writing_.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    readers.fetch_add(1);
+    if (!writing_.load()) return;
+    readers.fetch_sub(1);
+  }
+}
+
+}  // namespace fplbase
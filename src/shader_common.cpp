@@ -19,6 +19,7 @@
 #include "fplbase/preprocessor.h"
 #include "fplbase/renderer.h"
 #include "fplbase/shader.h"
+#include "fplbase/utilities.h"
 #include "shader_generated.h"
 
 namespace fplbase {
@@ -99,6 +100,7 @@ bool Shader::ReloadInternal() {
   auto sh =
       renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
                                  source_pair->fragment_shader.c_str(), this);
+  source_files_.swap(source_pair->files);
   delete source_pair;
   return sh != nullptr;
 }
@@ -111,18 +113,40 @@ void Shader::Reset(ShaderHandle program, ShaderHandle vs, ShaderHandle ps) {
 }
 
 void Shader::Load() {
+  // Left over if reloading a shader that failed to compile.
+  delete reinterpret_cast<const ShaderSourcePair *>(data_);
+  data_ = nullptr;
   ShaderSourcePair *source_pair = LoadSourceFile();
   if (source_pair != nullptr) {
     data_ = reinterpret_cast<uint8_t *>(source_pair);
   }
 }
 
+AssetMemoryUsage Shader::MemoryUsage() const {
+  AssetMemoryUsage usage(0, sizeof(*this));
+  for (auto it = local_defines_.begin(); it != local_defines_.end(); ++it) {
+    usage.cpu_bytes += sizeof(*it) + it->capacity();
+  }
+  for (auto it = enabled_defines_.begin(); it != enabled_defines_.end();
+       ++it) {
+    usage.cpu_bytes += sizeof(*it) + it->capacity();
+  }
+  if (data_) {
+    auto source_pair = reinterpret_cast<const ShaderSourcePair *>(data_);
+    usage.cpu_bytes += source_pair->vertex_shader.capacity() +
+                       source_pair->fragment_shader.capacity();
+  }
+  return usage;
+}
+
 bool Shader::Finalize() {
   if (data_ == nullptr) {
     return false;
   }
   const ShaderSourcePair *source_pair =
       reinterpret_cast<const ShaderSourcePair *>(data_);
+  // Recompiling deletes source_pair.
+  std::set<std::string> files = source_pair->files;
   auto sh =
       renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
                                  source_pair->fragment_shader.c_str(), this);
@@ -131,6 +155,7 @@ bool Shader::Finalize() {
     LogError(kError, "Shader compilation error:\n%s",
              renderer_->last_error().c_str());
   }
+  source_files_.swap(files);
 
   CallFinalizeCallback();
 
@@ -143,11 +168,14 @@ Shader::ShaderSourcePair *Shader::LoadSourceFile() {
   std::string error_message;
 
   ShaderSourcePair *source_pair = new ShaderSourcePair();
+  std::set<std::string> files;
   if (LoadFileWithDirectives(filename.c_str(), &source_pair->vertex_shader,
-                             enabled_defines_, &error_message)) {
+                             enabled_defines_, &error_message,
+                             &source_pair->files)) {
     filename = std::string(filename_) + ".glslf";
     if (LoadFileWithDirectives(filename.c_str(), &source_pair->fragment_shader,
-                               enabled_defines_, &error_message)) {
+                               enabled_defines_, &error_message, &files)) {
+      source_pair->files.insert(files.begin(), files.end());
       return source_pair;
     }
   }
@@ -173,12 +201,11 @@ static void BreakAndLogError(const char *cstr) {
 }
 
 Shader *Shader::LoadFromShaderDef(const char *filename) {
-  std::string flatbuf;
-  if (LoadFile(filename, &flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf.c_str()), flatbuf.length());
+  FileView flatbuf;
+  if (LoadFileView(filename, &flatbuf)) {
+    flatbuffers::Verifier verifier(flatbuf.data(), flatbuf.size());
     assert(shaderdef::VerifyShaderBuffer(verifier));
-    auto shaderdef = shaderdef::GetShader(flatbuf.c_str());
+    auto shaderdef = shaderdef::GetShader(flatbuf.data());
     auto shader = RendererBase::Get()->CompileAndLinkShader(
         shaderdef->vertex_shader()->c_str(),
         shaderdef->fragment_shader()->c_str());
@@ -0,0 +1,160 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/texture_cache.h"
+
+#include <thread>
+
+#include "fplbase/utilities.h"
+
+using mathfu::vec2i;
+
+namespace fplbase {
+
+// Bump when the layout of entries, or what Texture puts in them, changes.
+static const uint32_t kCacheVersion = 1;
+static const char kCacheMagic[4] = {'F', 'T', 'X', 'C'};
+
+// Precedes the pixels in every entry.
+struct TextureCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  int32_t width;
+  int32_t height;
+  int32_t texture_format;
+  uint32_t data_size;
+};
+
+TextureCache::TextureCache(const char *directory)
+    : directory_(directory), num_hits_(0), num_misses_(0), num_writes_(0) {
+  if (!directory_.empty() && directory_.back() != '/') directory_ += '/';
+}
+
+size_t TextureCache::DataSize(const vec2i &size,
+                              TextureFormat texture_format) {
+  size_t bytes_per_pixel;
+  switch (texture_format) {
+    case kFormat8888:
+      bytes_per_pixel = 4;
+      break;
+    case kFormat888:
+      bytes_per_pixel = 3;
+      break;
+    case kFormat5551:
+    case kFormat565:
+    case kFormatLuminanceAlpha:
+      bytes_per_pixel = 2;
+      break;
+    case kFormatLuminance:
+      bytes_per_pixel = 1;
+      break;
+    default:
+      return 0;
+  }
+  if (size.x <= 0 || size.y <= 0) return 0;
+  return static_cast<size_t>(size.x) * size.y * bytes_per_pixel;
+}
+
+std::string TextureCache::EntryFilename(uint64_t key) const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.fpltex",
+           static_cast<unsigned long long>(key));
+  return directory_ + name;
+}
+
+uint8_t *TextureCache::Read(uint64_t key, vec2i *size,
+                            TextureFormat *texture_format) {
+  FILE *file = fopen(EntryFilename(key).c_str(), "rb");
+  if (!file) {
+    ++num_misses_;
+    return nullptr;
+  }
+  TextureCacheHeader header;
+  uint8_t *pixels = nullptr;
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) == 0 &&
+      header.version == kCacheVersion && header.key == key) {
+    const vec2i entry_size(header.width, header.height);
+    const TextureFormat format =
+        static_cast<TextureFormat>(header.texture_format);
+    const size_t data_size = DataSize(entry_size, format);
+    // The pixels follow the header, so the single read below goes straight
+    // into the buffer that is uploaded.
+    if (data_size && data_size == header.data_size) {
+      pixels = static_cast<uint8_t *>(malloc(data_size));
+      if (fread(pixels, data_size, 1, file) == 1) {
+        *size = entry_size;
+        *texture_format = format;
+      } else {
+        free(pixels);
+        pixels = nullptr;
+      }
+    }
+  }
+  fclose(file);
+  if (pixels) {
+    ++num_hits_;
+  } else {
+    LogInfo("TextureCache: ignoring invalid entry %016llx",
+            static_cast<unsigned long long>(key));
+    ++num_misses_;
+  }
+  return pixels;
+}
+
+bool TextureCache::Write(uint64_t key, const uint8_t *pixels,
+                         const vec2i &size, TextureFormat texture_format) {
+  const size_t data_size = DataSize(size, texture_format);
+  if (!data_size) return false;
+  TextureCacheHeader header;
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.key = key;
+  header.width = size.x;
+  header.height = size.y;
+  header.texture_format = texture_format;
+  header.data_size = static_cast<uint32_t>(data_size);
+
+  // Unique to this thread, in case another one writes the same entry.
+  const std::string filename = EntryFilename(key);
+  const std::string temp_filename =
+      filename + "." +
+      flatbuffers::NumToString(
+          std::hash<std::thread::id>()(std::this_thread::get_id())) +
+      ".tmp";
+  FILE *file = fopen(temp_filename.c_str(), "wb");
+  if (!file) {
+    LogError(kError, "TextureCache: can't write %s", temp_filename.c_str());
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(pixels, data_size, 1, file) == 1;
+  ok = fclose(file) == 0 && ok;
+  if (ok && rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    // Windows doesn't rename over an existing file.
+    remove(filename.c_str());
+    ok = rename(temp_filename.c_str(), filename.c_str()) == 0;
+  }
+  if (!ok) {
+    LogError(kError, "TextureCache: can't write %s", filename.c_str());
+    remove(temp_filename.c_str());
+    return false;
+  }
+  ++num_writes_;
+  return true;
+}
+
+}  // namespace fplbase
@@ -14,10 +14,12 @@
 
 #include "precompiled.h"
 
+#include "fplbase/asset_id.h"
 #include "fplbase/flatbuffer_utils.h"
 #include "fplbase/renderer.h"
 #include "fplbase/texture.h"
 #include "fplbase/texture_atlas.h"
+#include "fplbase/texture_cache.h"
 #include "fplbase/utilities.h"
 #include "mathfu/glsl_mappings.h"
 #include "texture_atlas_generated.h"
@@ -64,6 +66,28 @@ static bool HasWebpHeader(const std::string &file) {
          file.substr(8, 4) == "WEBP";
 }
 
+// Files in these formats are uploaded as they are, see UnpackTextureFile().
+static bool IsCompressedFile(const std::string &ext) {
+  return ext == "astc" || ext == "pkm" || ext == "ktx";
+}
+
+static void Pack8888To5551(const uint8_t *buffer, int num_pixels,
+                           uint16_t *buffer16) {
+  for (int i = 0; i < num_pixels; i++) {
+    auto c = &buffer[i * 4];
+    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) |
+                  ((c[2] >> 3) << 1) | ((c[3] >> 7) << 0);
+  }
+}
+
+static void Pack888To565(const uint8_t *buffer, int num_pixels,
+                         uint16_t *buffer16) {
+  for (int i = 0; i < num_pixels; i++) {
+    auto c = &buffer[i * 3];
+    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | ((c[2] >> 3) << 0);
+  }
+}
+
 static void MultiplyRgbByAlpha(uint8_t *rgba_ptr, int width, int height) {
   const int num_pixels = width * height;
   for (int i = 0; i < num_pixels; ++i, rgba_ptr += 4) {
@@ -88,17 +112,102 @@ Texture::Texture(const char *filename, TextureFormat format, TextureFlags flags)
       target_(TextureTargetFromFlags(flags)),
       desired_(format),
       flags_(flags),
-      is_external_(false) {}
+      is_external_(false),
+      content_hash_(0),
+      original_(nullptr) {}
 
 Texture::~Texture() {
+  // Pixels of a texture that was loaded, but never finalized.
+  free(const_cast<uint8_t *>(data_));
   Delete();
   DestroyTextureImpl(impl_);
 }
 
 void Texture::Load() {
-  data_ = LoadAndUnpackTexture(filename_.c_str(), scale_, flags_, &size_,
-                               &texture_format_);
+  LoadFileData();
+  DecodeFileData();
+}
+
+void Texture::LoadFileData() {
+  file_data_.clear();
+  if (!LoadTextureFile(filename_.c_str(), &file_data_, &file_ext_)) {
+    file_data_.clear();
+  }
+}
+
+uint64_t Texture::HashFileData() const {
+  // Everything else that affects what the file decodes into.
+  const int flags = flags_ & ~kTextureFlagsLoadAsync;
+  const float scale[] = {scale_.x, scale_.y};
+  const bool use_16bpp = cache_ && MipmapGeneration16bppSupported();
+  uint64_t hash = HashAssetName(file_data_.data(), file_data_.size());
+  hash = HashAssetName(reinterpret_cast<const char *>(&desired_),
+                       sizeof(desired_), hash);
+  hash = HashAssetName(reinterpret_cast<const char *>(&flags), sizeof(flags),
+                       hash);
+  hash = HashAssetName(reinterpret_cast<const char *>(scale), sizeof(scale),
+                       hash);
+  // Whether ConvertForUpload() converts, which only matters to the cache.
+  hash = HashAssetName(reinterpret_cast<const char *>(&use_16bpp),
+                       sizeof(use_16bpp), hash);
+  return hash;
+}
+
+void Texture::DecodeFileData() {
+  const bool use_cache = cache_ && !IsCompressedFile(file_ext_);
+  if ((dedup_fn_ || use_cache) && !file_data_.empty() && !IsLoadCancelled()) {
+    content_hash_ = HashFileData();
+    if (dedup_fn_) {
+      Texture *original = dedup_fn_(content_hash_, this);
+      if (original != this) {
+        original_ = original;
+        std::string().swap(file_data_);
+        return;
+      }
+    }
+    if (use_cache) {
+      data_ = cache_->Read(content_hash_, &size_, &texture_format_);
+      if (data_) {
+        std::string().swap(file_data_);
+        SetOriginalSizeIfNotYetSet(size_);
+        return;
+      }
+    }
+  }
+  data_ = file_data_.empty() || IsLoadCancelled()
+              ? nullptr
+              : UnpackTextureFile(filename_.c_str(), file_data_, file_ext_,
+                                  scale_, flags_, &size_, &texture_format_);
+  std::string().swap(file_data_);
   SetOriginalSizeIfNotYetSet(size_);
+  if (use_cache && data_) {
+    ConvertForUpload();
+    cache_->Write(content_hash_, data_, size_, texture_format_);
+  }
+}
+
+void Texture::ConvertForUpload() {
+  // Mirrors the choice CreateTexture() makes.
+  if (!MipmapGeneration16bppSupported()) return;
+  TextureFormat desired = desired_;
+  if (desired == kFormatAuto && !IsCompressed(texture_format_)) {
+    desired = HasAlpha(texture_format_) ? kFormat5551 : kFormat565;
+  }
+  const int num_pixels = size_.x * size_.y;
+  uint16_t *buffer16;
+  if (desired == kFormat5551 && texture_format_ == kFormat8888) {
+    buffer16 = static_cast<uint16_t *>(malloc(num_pixels * sizeof(uint16_t)));
+    Pack8888To5551(data_, num_pixels, buffer16);
+    texture_format_ = kFormat5551;
+  } else if (desired == kFormat565 && texture_format_ == kFormat888) {
+    buffer16 = static_cast<uint16_t *>(malloc(num_pixels * sizeof(uint16_t)));
+    Pack888To565(data_, num_pixels, buffer16);
+    texture_format_ = kFormat565;
+  } else {
+    return;
+  }
+  free(const_cast<uint8_t *>(data_));
+  data_ = reinterpret_cast<const uint8_t *>(buffer16);
 }
 
 void Texture::LoadFromMemory(const uint8_t *data, const vec2i &size,
@@ -112,15 +221,94 @@ void Texture::LoadFromMemory(const uint8_t *data, const vec2i &size,
 
 bool Texture::Finalize() {
   if (data_) {
+    // Replaces the previous texture, when reloading.
+    Delete();
+    original_ = nullptr;
     id_ = CreateTexture(data_, size_, texture_format_, desired_, flags_, impl_);
     is_external_ = false;
     free(const_cast<uint8_t *>(data_));
     data_ = nullptr;
+  } else if (original_) {
+    // The original was finalized first, see set_dedup_fn().
+    if (ValidTextureHandle(original_->id_)) {
+      size_ = original_->size_;
+      texture_format_ = original_->texture_format_;
+      SetOriginalSizeIfNotYetSet(original_->original_size_);
+      SetTextureId(original_->target_, original_->id_);
+    }
   }
   CallFinalizeCallback();
   return ValidTextureHandle(id_);
 }
 
+// The bits per pixel of `format` in memory. Compressed formats are assumed
+// to use their largest common block size.
+static size_t BitsPerPixel(TextureFormat format) {
+  switch (format) {
+    case kFormat8888:
+      return 32;
+    case kFormat888:
+      return 24;
+    case kFormat5551:
+    case kFormat565:
+    case kFormatLuminanceAlpha:
+      return 16;
+    case kFormatPKM:
+      // ETC1 and ETC2 RGB.
+      return 4;
+    default:
+      // Luminance, ASTC 4x4, and ETC2 RGBA (the usual contents of KTX).
+      return 8;
+  }
+}
+
+// The number of bytes of a `size` image, and optionally its mip chain.
+static size_t ImageBytes(const vec2i &size, size_t bits_per_pixel,
+                         bool mips) {
+  size_t pixels = 0;
+  for (vec2i level = size; level.x > 0 && level.y > 0;
+       level = vec2i::Max(level / 2, mathfu::kOnes2i)) {
+    pixels += static_cast<size_t>(level.x) * level.y;
+    if (!mips || (level.x == 1 && level.y == 1)) break;
+  }
+  return (pixels * bits_per_pixel + 7) / 8;
+}
+
+size_t Texture::EstimateFinalizeCost() const {
+  if (!data_) return 0;
+  return ImageBytes(size_, BitsPerPixel(texture_format_),
+                    (flags_ & kTextureFlagsUseMipMaps) != 0);
+}
+
+AssetMemoryUsage Texture::MemoryUsage() const {
+  AssetMemoryUsage usage(0, sizeof(*this) + file_data_.capacity());
+  if (data_) {
+    // Decoded, but not yet uploaded.
+    usage.cpu_bytes += ImageBytes(size_, BitsPerPixel(texture_format_), false);
+  }
+  // Textures sharing the GPU texture of another one don't count it again.
+  if (ValidTextureHandle(id_) && !original_) {
+    // The format CreateTexture() picks for desired_.
+    TextureFormat format = desired_;
+    if (format == kFormatAuto) {
+      format = IsCompressed(texture_format_)
+                   ? texture_format_
+                   : HasAlpha(texture_format_) ? kFormat5551 : kFormat565;
+    } else if (format == kFormatNative) {
+      format = texture_format_;
+    }
+    // Compressed textures only have mips if their file does, which only KTX
+    // files support.
+    const bool mips = (flags_ & kTextureFlagsUseMipMaps) &&
+                      (!IsCompressed(format) || format == kFormatKTX);
+    const bool cube_map = (flags_ & kTextureFlagsIsCubeMap) != 0;
+    const int faces = cube_map ? 6 : 1;
+    usage.gpu_bytes = faces * ImageBytes(size_ / vec2i(1, faces),
+                                         BitsPerPixel(format), mips);
+  }
+  return usage;
+}
+
 void Texture::Set(size_t unit) { Set(unit, nullptr); }
 
 void Texture::Set(size_t unit, Renderer *) const {
@@ -131,20 +319,13 @@ void Texture::Set(size_t unit) const { const_cast<Texture *>(this)->Set(unit); }
 
 uint16_t *Texture::Convert8888To5551(const uint8_t *buffer, const vec2i &size) {
   auto buffer16 = new uint16_t[size.x * size.y];
-  for (int i = 0; i < size.x * size.y; i++) {
-    auto c = &buffer[i * 4];
-    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) |
-                  ((c[2] >> 3) << 1) | ((c[3] >> 7) << 0);
-  }
+  Pack8888To5551(buffer, size.x * size.y, buffer16);
   return buffer16;
 }
 
 uint16_t *Texture::Convert888To565(const uint8_t *buffer, const vec2i &size) {
   auto buffer16 = new uint16_t[size.x * size.y];
-  for (int i = 0; i < size.x * size.y; i++) {
-    auto c = &buffer[i * 3];
-    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | ((c[2] >> 3) << 0);
-  }
+  Pack888To565(buffer, size.x * size.y, buffer16);
   return buffer16;
 }
 
@@ -335,67 +516,65 @@ uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
   return image;
 }
 
-uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
-                                       TextureFlags flags, vec2i *dimensions,
-                                       TextureFormat *texture_format) {
-  std::string ext;
+bool Texture::LoadTextureFile(const char *filename, std::string *file,
+                              std::string *ext) {
   std::string basename = filename;
+  ext->clear();
   size_t ext_pos = basename.find_last_of(".");
   if (ext_pos != std::string::npos) {
-    ext = basename.substr(ext_pos + 1);
+    *ext = basename.substr(ext_pos + 1);
     basename = basename.substr(0, ext_pos);
   }
 
-  std::string file;
-
-  // Try to load ASTC, but default to WebP if not available or not supported.
-  if (ext == "astc") {
-    if (RendererBase::Get()->SupportsTextureFormat(kFormatASTC) &&
-        LoadFile(filename, &file)) {
-      auto buf = UnpackASTC(file.c_str(), file.length(), flags, dimensions,
-                            texture_format);
-      if (!buf) LogError(kApplication, "ASTC format problem: %s", filename);
-      return buf;
-    } else {
-      ext = "webp";
-    }
+  // Try to load ASTC, PKM or KTX, but default to WebP if not available or not
+  // supported.
+  TextureFormat format = kFormatAuto;
+  if (*ext == "astc") {
+    format = kFormatASTC;
+  } else if (*ext == "pkm") {
+    format = kFormatPKM;
+  } else if (*ext == "ktx") {
+    format = kFormatKTX;
   }
-
-  // Try to load PKM, but default to WebP if not available or not supported.
-  if (ext == "pkm") {
-    if (RendererBase::Get()->SupportsTextureFormat(kFormatPKM) &&
-        LoadFile(filename, &file)) {
-      auto buf = UnpackPKM(file.c_str(), file.length(), flags, dimensions,
-                           texture_format);
-      if (!buf) LogError(kApplication, "PKM format problem: %s", filename);
-      return buf;
-    } else {
-      ext = "webp";
-    }
-  }
-
-  // Try to load KTX, but default to WebP if not available or not supported.
-  if (ext == "ktx") {
-    if (RendererBase::Get()->SupportsTextureFormat(kFormatKTX) &&
-        LoadFile(filename, &file)) {
-      auto buf = UnpackKTX(file.c_str(), file.length(), flags, dimensions,
-                           texture_format);
-      if (!buf) LogError(kApplication, "KTX format problem: %s", filename);
-      return buf;
-    } else {
-      ext = "webp";
+  if (format != kFormatAuto) {
+    if (RendererBase::Get()->SupportsTextureFormat(format) &&
+        LoadFile(filename, file)) {
+      return true;
     }
+    *ext = "webp";
   }
 
   std::string altfilename = basename;
-  if (ext.length()) altfilename += "." + ext;
+  if (ext->length()) altfilename += "." + *ext;
 
-  if (!LoadFile(altfilename.c_str(), &file)) {
+  if (!LoadFile(altfilename.c_str(), file)) {
     LogError(kApplication, "Couldn\'t load: %s", filename);
-    return nullptr;
+    return false;
   }
+  return true;
+}
 
-  if (ext == "tga" || ext == "png" || ext == "jpg") {
+uint8_t *Texture::UnpackTextureFile(const char *filename,
+                                    const std::string &file,
+                                    const std::string &ext, const vec2 &scale,
+                                    TextureFlags flags, vec2i *dimensions,
+                                    TextureFormat *texture_format) {
+  if (ext == "astc") {
+    auto buf = UnpackASTC(file.c_str(), file.length(), flags, dimensions,
+                          texture_format);
+    if (!buf) LogError(kApplication, "ASTC format problem: %s", filename);
+    return buf;
+  } else if (ext == "pkm") {
+    auto buf = UnpackPKM(file.c_str(), file.length(), flags, dimensions,
+                         texture_format);
+    if (!buf) LogError(kApplication, "PKM format problem: %s", filename);
+    return buf;
+  } else if (ext == "ktx") {
+    auto buf = UnpackKTX(file.c_str(), file.length(), flags, dimensions,
+                         texture_format);
+    if (!buf) LogError(kApplication, "KTX format problem: %s", filename);
+    return buf;
+  } else if (ext == "tga" || ext == "png" || ext == "jpg") {
     auto buf = UnpackImage(file.c_str(), file.length(), scale, flags,
                            dimensions, texture_format);
     if (!buf) LogError(kApplication, "Image format problem: %s", filename);
@@ -412,16 +591,25 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
   }
 }
 
+uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
+                                       TextureFlags flags, vec2i *dimensions,
+                                       TextureFormat *texture_format) {
+  std::string file;
+  std::string ext;
+  if (!LoadTextureFile(filename, &file, &ext)) return nullptr;
+  return UnpackTextureFile(filename, file, ext, scale, flags, dimensions,
+                           texture_format);
+}
+
 TextureAtlas *TextureAtlas::LoadTextureAtlas(const char *filename,
                                              TextureFormat format,
                                              TextureFlags flags,
                                              const TextureLoaderFn &tlf) {
-  std::string flatbuf;
-  if (LoadFile(filename, &flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf.c_str()), flatbuf.length());
+  FileView flatbuf;
+  if (LoadFileView(filename, &flatbuf)) {
+    flatbuffers::Verifier verifier(flatbuf.data(), flatbuf.size());
     assert(atlasdef::VerifyTextureAtlasBuffer(verifier));
-    auto atlasdef = atlasdef::GetTextureAtlas(flatbuf.c_str());
+    auto atlasdef = atlasdef::GetTextureAtlas(flatbuf.data());
     Texture *atlas_texture =
         tlf(atlasdef->texture_filename()->c_str(), format, flags);
     auto atlas = new TextureAtlas();
@@ -222,7 +222,8 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
           }
           break;
         case kFormat5551:
-          // Nothing coversion.
+          // No conversion, e.g. converted by Texture::DecodeFileData().
+          type = GL_UNSIGNED_SHORT_5_5_5_1;
           gl_tex_image(buffer, tex_size, 0, num_pixels * 2, false);
           break;
         default:
@@ -15,7 +15,6 @@
 // clang-format off
 #include "precompiled.h"
 #include "fplbase/utilities.h"
-#include "fplutil/mutex.h"
 // clang-format on
 
 // Header files for mmap API.
@@ -25,35 +24,50 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #endif  // _WIN32
 
 #include <stdarg.h>
 
 namespace fplbase {
 
-// Function called by LoadFile().
-static fplutil::Mutex g_load_file_function_mutex_;
-static LoadFileFunction g_load_file_function = LoadFileRaw;
-
-LoadFileFunction SetLoadFileFunction(LoadFileFunction load_file_function) {
-  fplutil::MutexLock lock(g_load_file_function_mutex_);
-  LoadFileFunction previous_function = g_load_file_function;
-  if (load_file_function) {
-    g_load_file_function = load_file_function;
-  } else {
-    g_load_file_function = LoadFileRaw;
+FileView::FileView()
+    : data_(nullptr), size_(0), mapped_(nullptr), mapped_size_(0) {}
+
+FileView::FileView(FileView &&other)
+    : data_(nullptr), size_(0), mapped_(nullptr), mapped_size_(0) {
+  *this = std::move(other);
+}
+
+FileView &FileView::operator=(FileView &&other) {
+  if (this != &other) {
+    Reset();
+    data_ = other.data_;
+    size_ = other.size_;
+    mapped_ = other.mapped_;
+    mapped_size_ = other.mapped_size_;
+    owner_ = std::move(other.owner_);
+    contents_ = std::move(other.contents_);
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.mapped_ = nullptr;
+    other.mapped_size_ = 0;
+    other.owner_.reset();
+    other.contents_.clear();
   }
-  return previous_function;
-}
-
-bool LoadFile(const char *filename, std::string *dest) {
-  LoadFileFunction load_file_function;
-  {
-    fplutil::MutexLock lock(g_load_file_function_mutex_);
-    load_file_function = g_load_file_function;
-  }
-  assert(load_file_function);
-  return load_file_function(filename, dest);
+  return *this;
+}
+
+void FileView::Reset() {
+#if !defined(_WIN32)
+  if (mapped_) munmap(mapped_, mapped_size_);
+#endif  // !defined(_WIN32)
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = nullptr;
+  mapped_size_ = 0;
+  owner_.reset();
+  std::string().swap(contents_);
 }
 
 const void *MapFile(const char *filename, int32_t offset, int32_t *size) {
@@ -15,6 +15,7 @@
 // clang-format off
 #include "precompiled.h"
 #include "fplbase/utilities.h"
+#include "fplbase/file_system.h"
 #include "fplutil/mutex.h"
 // clang-format on
 
@@ -60,6 +61,8 @@ bool SaveFile(const char *filename, const void *data, size_t size) {
   }
   size_t wlen = static_cast<size_t>(SDL_RWwrite(handle, data, 1, size));
   SDL_RWclose(handle);
+  // LoadFile() may have found the file missing before.
+  ForgetMissingFiles();
   return (wlen == size);
 }
 
@@ -15,6 +15,7 @@
 // clang-format off
 #include "precompiled.h"
 #include "fplbase/utilities.h"
+#include "fplbase/file_system.h"
 #include "fplutil/mutex.h"
 // clang-format on
 
@@ -97,6 +98,8 @@ bool SaveFile(const char *filename, const void *data, size_t size) {
   }
   size_t wlen = fwrite(data, 1, size, fd);
   fclose(fd);
+  // LoadFile() may have found the file missing before.
+  ForgetMissingFiles();
   return size == wlen && size > 0;
 #endif
 }
@@ -0,0 +1,105 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the cost of the AssetManager's Find*() lookups: by name in a
+// std::map<std::string, T *> (how the tables used to be keyed), by name in an
+// AssetId-keyed hash table, and by a precomputed AssetId.
+//
+// Usage: asset_manager_benchmark [num_lookups]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fplbase/asset_id.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double, std::nano> Nanoseconds;
+
+struct Asset {
+  int value;
+};
+
+// Names shaped like real asset paths, which share long prefixes and so are
+// slow to tell apart by string comparison.
+std::vector<std::string> MakeNames(int num_assets) {
+  std::vector<std::string> names;
+  for (int i = 0; i < num_assets; ++i) {
+    char name[64];
+    snprintf(name, sizeof(name),
+             "textures/environment/level_%02d/tile_%04d.webp", i % 16, i);
+    names.push_back(name);
+  }
+  return names;
+}
+
+template <typename F>
+double NanosecondsPerLookup(int num_lookups, int num_names, F lookup) {
+  long long sum = 0;
+  const Clock::time_point start = Clock::now();
+  for (int i = 0; i < num_lookups; ++i) {
+    sum += lookup(i % num_names)->value;
+  }
+  const double ns = Nanoseconds(Clock::now() - start).count();
+  // Keeps the lookups from being optimized out.
+  if (sum == -1) printf("%lld\n", sum);
+  return ns / num_lookups;
+}
+
+}  // namespace
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  const int num_lookups = argc > 1 ? atoi(argv[1]) : 10000000;
+  const int kNumAssets[] = {16, 256, 4096};
+  printf("%d lookups\n", num_lookups);
+  printf("%8s %16s %16s %16s\n", "assets", "map by name ns",
+         "hash by name ns", "hash by id ns");
+  for (size_t n = 0; n < sizeof(kNumAssets) / sizeof(kNumAssets[0]); ++n) {
+    const std::vector<std::string> names = MakeNames(kNumAssets[n]);
+    std::vector<Asset> assets(names.size());
+    std::map<std::string, Asset *> string_map;
+    std::unordered_map<fplbase::AssetId, Asset *, fplbase::AssetIdHash> id_map;
+    std::vector<fplbase::AssetId> ids;
+    for (size_t i = 0; i < names.size(); ++i) {
+      assets[i].value = static_cast<int>(i);
+      string_map[names[i]] = &assets[i];
+      ids.push_back(fplbase::AssetId(names[i]));
+      id_map[ids.back()] = &assets[i];
+    }
+    const int num_names = static_cast<int>(names.size());
+
+    // Callers pass names as const char *, so each lookup builds a string.
+    const double map_ns = NanosecondsPerLookup(
+        num_lookups, num_names, [&](int i) {
+          return string_map.find(names[i].c_str())->second;
+        });
+    const double hash_name_ns = NanosecondsPerLookup(
+        num_lookups, num_names, [&](int i) {
+          return id_map.find(fplbase::AssetId::FromName(names[i].c_str()))
+              ->second;
+        });
+    const double hash_id_ns = NanosecondsPerLookup(
+        num_lookups, num_names,
+        [&](int i) { return id_map.find(ids[i])->second; });
+    printf("%8d %16.1f %16.1f %16.1f\n", num_names, map_ns, hash_name_ns,
+           hash_id_ns);
+  }
+  return 0;
+}
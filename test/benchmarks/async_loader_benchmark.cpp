@@ -0,0 +1,117 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how much the main thread's TryFinalize() calls suffer from
+// contention with the loader's workers, by loading many trivial assets with
+// an increasing number of workers.
+//
+// Usage: async_loader_benchmark [num_assets]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "fplbase/async_loader.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double, std::micro> Microseconds;
+
+// An asset that takes no time to load or finalize, so the benchmark measures
+// nothing but the loader's own overhead.
+class TrivialAsset : public fplbase::AsyncAsset {
+ public:
+  TrivialAsset() : AsyncAsset("trivial"), finalized_count_(0) {}
+
+  virtual void Load() {
+    data_ = reinterpret_cast<const uint8_t *>(filename_.c_str());
+  }
+
+  virtual bool Finalize() {
+    ++finalized_count_;
+    data_ = nullptr;
+    return true;
+  }
+
+  virtual bool IsValid() { return finalized_count_ == 1; }
+
+  virtual bool SupportsConcurrentLoad() const { return true; }
+
+ private:
+  int finalized_count_;
+};
+
+struct Result {
+  double total_ms;
+  int num_calls;
+  double mean_call_us;
+  double max_call_us;
+};
+
+Result Run(int num_workers, int num_assets) {
+  std::vector<std::unique_ptr<TrivialAsset>> assets;
+  fplbase::AsyncLoader loader;
+  loader.SetNumWorkers(num_workers);
+  for (int i = 0; i < num_assets; ++i) {
+    assets.emplace_back(new TrivialAsset());
+    loader.QueueJob(assets.back().get());
+  }
+
+  Result result = {0.0, 0, 0.0, 0.0};
+  double total_call_us = 0.0;
+  const Clock::time_point start = Clock::now();
+  loader.StartLoading();
+  for (bool done = false; !done;) {
+    // Poll as hard as a main thread possibly can, which is when it contends
+    // the most with the workers.
+    const Clock::time_point call_start = Clock::now();
+    done = loader.TryFinalize();
+    const double call_us = Microseconds(Clock::now() - call_start).count();
+    total_call_us += call_us;
+    result.max_call_us = std::max(result.max_call_us, call_us);
+    ++result.num_calls;
+  }
+  result.total_ms = Microseconds(Clock::now() - start).count() / 1000.0;
+  result.mean_call_us = total_call_us / result.num_calls;
+  loader.Stop();
+
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    if (!(*it)->IsValid()) {
+      fprintf(stderr, "asset wasn't finalized exactly once\n");
+      exit(1);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  const int num_assets = argc > 1 ? atoi(argv[1]) : 100000;
+  const int kNumWorkers[] = {1, 2, 4, 8, 16};
+  printf("%d assets\n", num_assets);
+  printf("%8s %10s %12s %10s %14s %13s\n", "workers", "total ms", "assets/s",
+         "calls", "mean call us", "max call us");
+  for (size_t i = 0; i < sizeof(kNumWorkers) / sizeof(kNumWorkers[0]); ++i) {
+    const Result r = Run(kNumWorkers[i], num_assets);
+    printf("%8d %10.1f %12.0f %10d %14.2f %13.1f\n", kNumWorkers[i],
+           r.total_ms, num_assets / r.total_ms * 1000.0, r.num_calls,
+           r.mean_call_us, r.max_call_us);
+  }
+  return 0;
+}
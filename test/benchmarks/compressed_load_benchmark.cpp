@@ -0,0 +1,131 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how fast LoadFile() loads a large mesh-like file from local disk,
+// stored raw and compressed, decompressing with an increasing number of
+// threads. The files are loaded once before timing, so they are read from
+// the page cache: this measures the cost of decompression, which is what
+// compressing adds on storage that is faster than this, and saves on storage
+// that is slower (SD cards, network drives).
+//
+// Usage: compressed_load_benchmark [file_mb] [block_kb]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "fplbase/compressed_file.h"
+#include "fplbase/utilities.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+const int kNumRuns = 5;
+const int kNumThreads[] = {1, 2, 4, 8};
+
+// Vertices on a wavy grid, and the indices of its triangles, which compress
+// about as well as real meshes do.
+std::string MakeMeshLikeFile(size_t size) {
+  std::string file;
+  file.reserve(size);
+  const int kGridSize = 256;
+  for (int i = 0; file.size() < size; ++i) {
+    const int x = i % kGridSize;
+    const int y = (i / kGridSize) % kGridSize;
+    const float vertex[8] = {
+        static_cast<float>(x), static_cast<float>(y),
+        static_cast<float>((x * 37 + y * 11) % 101) * 0.01f,  // position
+        0.0f, 0.0f, 1.0f,                                     // normal
+        x / static_cast<float>(kGridSize),                    // uv
+        y / static_cast<float>(kGridSize)};
+    const unsigned short indices[6] = {
+        static_cast<unsigned short>(i), static_cast<unsigned short>(i + 1),
+        static_cast<unsigned short>(i + kGridSize),
+        static_cast<unsigned short>(i + 1),
+        static_cast<unsigned short>(i + kGridSize + 1),
+        static_cast<unsigned short>(i + kGridSize)};
+    file.append(reinterpret_cast<const char *>(vertex), sizeof(vertex));
+    file.append(reinterpret_cast<const char *>(indices), sizeof(indices));
+  }
+  file.resize(size);
+  return file;
+}
+
+// Returns the fastest of kNumRuns loads, in ms.
+double TimeLoad(const std::string &filename, size_t expected_size) {
+  double best_ms = 0.0;
+  std::string contents;
+  for (int run = 0; run < kNumRuns; ++run) {
+    const Clock::time_point start = Clock::now();
+    if (!fplbase::LoadFile(filename.c_str(), &contents) ||
+        contents.size() != expected_size) {
+      fprintf(stderr, "can't load %s\n", filename.c_str());
+      exit(1);
+    }
+    const double ms = Milliseconds(Clock::now() - start).count();
+    if (run == 0 || ms < best_ms) best_ms = ms;
+  }
+  return best_ms;
+}
+
+}  // namespace
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  const size_t file_mb = argc > 1 ? atoi(argv[1]) : 64;
+  const size_t block_kb = argc > 2 ? atoi(argv[2]) : 256;
+  const size_t size = file_mb * 1024 * 1024;
+
+  char dir[] = "/tmp/fplbase_compressed_load_XXXXXX";
+  if (!mkdtemp(dir)) {
+    fprintf(stderr, "can't make a temporary directory\n");
+    return 1;
+  }
+  const std::string raw_file = std::string(dir) + "/mesh.raw";
+  const std::string compressed_file = std::string(dir) + "/mesh.compressed";
+  const std::string contents = MakeMeshLikeFile(size);
+  std::string compressed;
+  if (!fplbase::CompressFileData(contents, block_kb * 1024, &compressed) ||
+      !fplbase::SaveFile(raw_file.c_str(), contents) ||
+      !fplbase::SaveFile(compressed_file.c_str(), compressed)) {
+    fprintf(stderr, "can't write the files to %s\n", dir);
+    return 1;
+  }
+  // Reads both into the page cache.
+  TimeLoad(raw_file, size);
+  TimeLoad(compressed_file, size);
+
+  printf("%d MB file, %d KB blocks, compressed to %.1f%%\n",
+         static_cast<int>(file_mb), static_cast<int>(block_kb),
+         100.0 * compressed.size() / contents.size());
+  printf("%-12s %8s %10s %10s\n", "file", "threads", "best ms", "MB/s");
+  const double raw_ms = TimeLoad(raw_file, size);
+  printf("%-12s %8s %10.1f %10.0f\n", "raw", "-", raw_ms,
+         file_mb / raw_ms * 1000.0);
+  for (size_t i = 0; i < sizeof(kNumThreads) / sizeof(kNumThreads[0]); ++i) {
+    fplbase::SetMaxDecompressionThreads(kNumThreads[i]);
+    const double ms = TimeLoad(compressed_file, size);
+    printf("%-12s %8d %10.1f %10.0f\n", "compressed", kNumThreads[i], ms,
+           file_mb / ms * 1000.0);
+  }
+
+  remove(raw_file.c_str());
+  remove(compressed_file.c_str());
+  remove(dir);
+  return 0;
+}
@@ -0,0 +1,154 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how AssetManager::Find*() style lookups scale when called from
+// several threads at once: in an AssetId-keyed hash table guarded by a plain
+// mutex, by a ReadMostlyMutex, and by a ReadMostlyMutex while another thread
+// keeps adding and removing assets. Unsynchronized lookups, which are only
+// safe while nobody writes, are the baseline.
+//
+// Usage: concurrent_lookup_benchmark [lookups_per_thread]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "fplbase/asset_id.h"
+#include "fplbase/read_mostly_mutex.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double, std::nano> Nanoseconds;
+typedef std::unordered_map<fplbase::AssetId, int *, fplbase::AssetIdHash>
+    AssetMap;
+
+const int kNumAssets = 1024;
+const int kNumThreads[] = {1, 2, 4, 8};
+
+// Runs `lookup` on `num_threads` threads at once, and returns the average
+// time per lookup, over all threads.
+template <typename F>
+double NanosecondsPerLookup(int num_threads, int lookups_per_thread,
+                            const std::vector<fplbase::AssetId> &ids,
+                            F lookup) {
+  std::atomic<int> num_ready(0);
+  std::atomic<bool> go(false);
+  std::atomic<long long> sum(0);
+  std::vector<double> thread_ns(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      ++num_ready;
+      while (!go) std::this_thread::yield();
+      long long thread_sum = 0;
+      const Clock::time_point start = Clock::now();
+      for (int i = 0; i < lookups_per_thread; ++i) {
+        const int *value = lookup(ids[(i * 7 + t) % ids.size()]);
+        if (value) thread_sum += *value;
+      }
+      thread_ns[t] = Nanoseconds(Clock::now() - start).count();
+      sum += thread_sum;
+    }));
+  }
+  while (num_ready < num_threads) std::this_thread::yield();
+  go = true;
+  double total_ns = 0;
+  for (int t = 0; t < num_threads; ++t) {
+    threads[t].join();
+    total_ns += thread_ns[t];
+  }
+  // Keeps the lookups from being optimized out.
+  if (sum == -1) printf("%lld\n", sum.load());
+  return total_ns / (static_cast<double>(num_threads) * lookups_per_thread);
+}
+
+int *Find(const AssetMap &map, fplbase::AssetId id) {
+  auto it = map.find(id);
+  return it != map.end() ? it->second : nullptr;
+}
+
+}  // namespace
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  const int lookups_per_thread = argc > 1 ? atoi(argv[1]) : 2000000;
+  std::vector<int> values(kNumAssets * 2);
+  std::vector<fplbase::AssetId> ids;
+  AssetMap map;
+  for (int i = 0; i < kNumAssets; ++i) {
+    values[i] = i;
+    ids.push_back(fplbase::AssetId::FromName(
+        ("meshes/level/prop_" + std::to_string(i) + ".fplmesh").c_str()));
+    map[ids.back()] = &values[i];
+  }
+
+  printf("%d lookups per thread, %d assets\n", lookups_per_thread,
+         kNumAssets);
+  printf("%8s %14s %14s %14s %14s\n", "threads", "unlocked ns", "mutex ns",
+         "read-mostly ns", "+writer ns");
+  for (size_t n = 0; n < sizeof(kNumThreads) / sizeof(kNumThreads[0]); ++n) {
+    const int num_threads = kNumThreads[n];
+    const double unlocked_ns = NanosecondsPerLookup(
+        num_threads, lookups_per_thread, ids,
+        [&](fplbase::AssetId id) { return Find(map, id); });
+
+    std::mutex mutex;
+    const double mutex_ns = NanosecondsPerLookup(
+        num_threads, lookups_per_thread, ids, [&](fplbase::AssetId id) {
+          std::lock_guard<std::mutex> lock(mutex);
+          return Find(map, id);
+        });
+
+    fplbase::ReadMostlyMutex read_mostly;
+    const double read_mostly_ns = NanosecondsPerLookup(
+        num_threads, lookups_per_thread, ids, [&](fplbase::AssetId id) {
+          fplbase::ReadMostlyMutex::ReadLock lock(read_mostly);
+          return Find(map, id);
+        });
+
+    // Like a main thread that loads and unloads an asset every 100us.
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+      const fplbase::AssetId id = fplbase::AssetId::FromName("streamed");
+      for (int i = 0; !done; ++i) {
+        {
+          fplbase::ReadMostlyMutex::WriteLock lock(read_mostly);
+          if (i % 2) {
+            map.erase(id);
+          } else {
+            map[id] = &values[kNumAssets + i % kNumAssets];
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    });
+    const double writer_ns = NanosecondsPerLookup(
+        num_threads, lookups_per_thread, ids, [&](fplbase::AssetId id) {
+          fplbase::ReadMostlyMutex::ReadLock lock(read_mostly);
+          return Find(map, id);
+        });
+    done = true;
+    writer.join();
+
+    printf("%8d %14.1f %14.1f %14.1f %14.1f\n", num_threads, unlocked_ns,
+           mutex_ns, read_mostly_ns, writer_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <unordered_map>
+
+#include "fplbase/asset_id.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+// Must be usable as a compile time constant.
+constexpr AssetId kMeshId("meshes/player.fplmesh");
+static_assert(kMeshId.hash() != 0, "AssetId isn't computed at compile time");
+
+// Known 64-bit FNV-1a values.
+static_assert(AssetId("").hash() == 0xcbf29ce484222325ULL, "wrong hash");
+static_assert(AssetId("a").hash() == 0xaf63dc4c8601ec8cULL, "wrong hash");
+
+TEST(AssetIdTest, SameHashEverywhere) {
+  const char *name = "meshes/player.fplmesh";
+  const std::string str(name);
+  EXPECT_EQ(kMeshId, AssetId(name));
+  EXPECT_EQ(kMeshId, AssetId(str));
+  EXPECT_EQ(kMeshId, AssetId::FromName(name));
+  EXPECT_EQ(kMeshId.hash(), HashAssetName(str.c_str(), str.size()));
+  EXPECT_EQ(kMeshId, AssetId::FromHash(kMeshId.hash()));
+}
+
+TEST(AssetIdTest, HashesInPieces) {
+  const std::string str("textures/rock.webp");
+  const uint64_t first = HashAssetName(str.c_str(), 9);
+  EXPECT_EQ(HashAssetName(str.c_str(), str.size()),
+            HashAssetName(str.c_str() + 9, str.size() - 9, first));
+}
+
+TEST(AssetIdTest, DifferentNames) {
+  EXPECT_NE(kMeshId, AssetId("meshes/player.fplmesh2"));
+  EXPECT_NE(AssetId("ab"), AssetId("ba"));
+  EXPECT_NE(AssetId(""), AssetId());
+}
+
+TEST(AssetIdTest, MapKey) {
+  std::unordered_map<AssetId, int, AssetIdHash> map;
+  map[AssetId::FromName("a.webp")] = 1;
+  map[AssetId::FromName("b.webp")] = 2;
+  EXPECT_EQ(1, map[AssetId("a.webp")]);
+  EXPECT_EQ(2, map[AssetId("b.webp")]);
+  EXPECT_EQ(map.end(), map.find(AssetId("c.webp")));
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fplbase/asset_manager.h"
+#include "fplbase/file_system.h"
+#include "fplbase/renderer.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> Files;
+
+const size_t kFileSize = 1000;
+
+// FileAssets report their size and need no GPU, so they exercise eviction
+// without a renderer that was initialized.
+class AssetManagerEvictionTest : public ::testing::Test {
+ protected:
+  AssetManagerEvictionTest() : asset_manager_(SharedRenderer()) {}
+
+  virtual void SetUp() {
+    MountMemoryFiles("files", Files{{"a.bin", std::string(kFileSize, 'a')},
+                                    {"b.bin", std::string(kFileSize, 'b')},
+                                    {"c.bin", std::string(kFileSize, 'c')}});
+    // One per frame, so that a.bin is the least recently used.
+    ASSERT_TRUE(asset_manager_.LoadFileAsset("a.bin") != nullptr);
+    asset_manager_.TryFinalize();
+    ASSERT_TRUE(asset_manager_.LoadFileAsset("b.bin") != nullptr);
+    asset_manager_.TryFinalize();
+    ASSERT_TRUE(asset_manager_.LoadFileAsset("c.bin") != nullptr);
+    asset_manager_.TryFinalize();
+  }
+  virtual void TearDown() { Unmount("files"); }
+
+  size_t FileUsage() {
+    return asset_manager_.GetMemoryUsage(kAssetTypeFile).total();
+  }
+
+  // Whether `filename` is still loaded. Doesn't count as a use.
+  bool IsLoaded(const char *filename) {
+    const std::vector<AssetMemoryRecord> records =
+        asset_manager_.GetLargestAssets(static_cast<size_t>(-1));
+    for (auto it = records.begin(); it != records.end(); ++it) {
+      if (it->type == kAssetTypeFile &&
+          it->id == AssetId::FromName(filename)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The AssetManager only needs one to exist. It is never initialized, and
+  // never destroyed, since shutting it down would need a GL context.
+  static Renderer &SharedRenderer() {
+    static Renderer *renderer = new Renderer();
+    return *renderer;
+  }
+
+  AssetManager asset_manager_;
+};
+
+TEST_F(AssetManagerEvictionTest, EvictsOnlyOverBudget) {
+  asset_manager_.SetMemoryBudget(kAssetTypeFile, FileUsage());
+  EXPECT_EQ(0u, asset_manager_.EvictUnusedAssets());
+  EXPECT_TRUE(IsLoaded("a.bin"));
+  asset_manager_.SetMemoryBudget(kAssetTypeFile, kNoMemoryBudget);
+  EXPECT_EQ(0u, asset_manager_.EvictUnusedAssets());
+}
+
+TEST_F(AssetManagerEvictionTest, EvictsLeastRecentlyUsedFirst) {
+  // Using a.bin again makes b.bin the least recently used.
+  EXPECT_TRUE(asset_manager_.FindFileAsset("a.bin") != nullptr);
+  asset_manager_.SetMemoryBudget(kAssetTypeFile, FileUsage() - 1);
+  EXPECT_LT(kFileSize, asset_manager_.EvictUnusedAssets());
+  EXPECT_TRUE(IsLoaded("a.bin"));
+  EXPECT_FALSE(IsLoaded("b.bin"));
+  EXPECT_TRUE(IsLoaded("c.bin"));
+
+  // Until it fits.
+  asset_manager_.SetMemoryBudget(kAssetTypeFile, 0);
+  asset_manager_.EvictUnusedAssets();
+  EXPECT_EQ(0u, FileUsage());
+
+  // Evicted assets load anew.
+  EXPECT_TRUE(asset_manager_.LoadFileAsset("b.bin") != nullptr);
+  EXPECT_TRUE(IsLoaded("b.bin"));
+}
+
+TEST_F(AssetManagerEvictionTest, KeepsAssetsThatAreReferredTo) {
+  AssetHandle<FileAsset> a(asset_manager_.FindFileAsset("a.bin"));
+  asset_manager_.FindFileAsset("b.bin")->IncreaseRefCount();
+  asset_manager_.SetMemoryBudget(kAssetTypeFile, 0);
+  asset_manager_.EvictUnusedAssets();
+  EXPECT_TRUE(IsLoaded("a.bin"));
+  EXPECT_TRUE(IsLoaded("b.bin"));
+  EXPECT_FALSE(IsLoaded("c.bin"));
+
+  // Evictable once the owner unloaded it.
+  asset_manager_.UnloadFileAsset("b.bin");
+  asset_manager_.EvictUnusedAssets();
+  EXPECT_FALSE(IsLoaded("b.bin"));
+  a.reset();
+  asset_manager_.EvictUnusedAssets();
+  EXPECT_FALSE(IsLoaded("a.bin"));
+}
+
+TEST_F(AssetManagerEvictionTest, KeepsAssetsThatAreLoading) {
+  // Queued, but never loaded, since loading wasn't started.
+  Texture *tex =
+      asset_manager_.LoadTexture("a.bin", kFormatAuto, kTextureFlagsLoadAsync);
+  ASSERT_FALSE(tex->IsFinalized());
+  asset_manager_.SetMemoryBudget(kAssetTypeTexture, 0);
+  asset_manager_.EvictUnusedAssets();
+  EXPECT_EQ(tex, asset_manager_.FindTexture("a.bin"));
+  asset_manager_.UnloadTexture("a.bin");
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fplbase/asset_pack.h"
+#include "fplbase/utilities.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+const char kPackFile[] = "asset_pack_test.fplpack";
+
+class AssetPackTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    entries_.push_back(std::make_pair("textures/b.webp", "texture"));
+    entries_.push_back(std::make_pair("a.fplmesh", "mesh"));
+    entries_.push_back(std::make_pair("empty", ""));
+    entries_.push_back(
+        std::make_pair("binary", std::string("\0\1\2\3\0", 5)));
+    ASSERT_TRUE(AssetPack::Save(kPackFile, entries_));
+  }
+  virtual void TearDown() {
+    UnmountAssetPack(kPackFile);
+    remove(kPackFile);
+  }
+
+  std::vector<std::pair<std::string, std::string>> entries_;
+};
+
+TEST_F(AssetPackTest, FindsEntries) {
+  AssetPack pack;
+  ASSERT_TRUE(pack.Open(kPackFile));
+  EXPECT_EQ(entries_.size(), pack.num_entries());
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    size_t size = 1;
+    const uint8_t *data = pack.FindEntry(it->first.c_str(), &size);
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(data) % kAssetPackAlignment);
+    EXPECT_EQ(it->second, std::string(reinterpret_cast<const char *>(data),
+                                      size));
+  }
+  EXPECT_EQ(nullptr, pack.FindEntry("missing", nullptr));
+  pack.Close();
+  EXPECT_FALSE(pack.IsOpen());
+  EXPECT_EQ(nullptr, pack.FindEntry("a.fplmesh", nullptr));
+}
+
+TEST_F(AssetPackTest, RejectsDuplicates) {
+  entries_.push_back(entries_[0]);
+  EXPECT_FALSE(AssetPack::Save("asset_pack_test_duplicates.fplpack",
+                               entries_));
+}
+
+TEST_F(AssetPackTest, RejectsOtherFiles) {
+  const char kOtherFile[] = "asset_pack_test.txt";
+  ASSERT_TRUE(SaveFile(kOtherFile, std::string("not a pack file")));
+  AssetPack pack;
+  EXPECT_FALSE(pack.Open(kOtherFile));
+  remove(kOtherFile);
+}
+
+TEST_F(AssetPackTest, LoadFileReadsMountedPacks) {
+  std::string contents;
+  EXPECT_FALSE(LoadFileFromAssetPacks("a.fplmesh", &contents));
+
+  ASSERT_TRUE(MountAssetPack(kPackFile));
+  EXPECT_TRUE(LoadFile("a.fplmesh", &contents));
+  EXPECT_EQ("mesh", contents);
+
+  size_t size = 0;
+  std::shared_ptr<const AssetPack> pack;
+  const uint8_t *data = FindInAssetPacks("textures/b.webp", &size, &pack);
+  ASSERT_NE(nullptr, data);
+  ASSERT_TRUE(UnmountAssetPack(kPackFile));
+  // The pack stays open until the last pointer into it is released.
+  EXPECT_EQ(0, memcmp(data, "texture", size));
+  EXPECT_FALSE(LoadFileFromAssetPacks("a.fplmesh", &contents));
+  EXPECT_FALSE(UnmountAssetPack(kPackFile));
+}
+
+TEST_F(AssetPackTest, FileViewsReadPacksInPlace) {
+  FileView view;
+  ASSERT_TRUE(MountAssetPack(kPackFile));
+  ASSERT_TRUE(LoadFileView("a.fplmesh", &view));
+  EXPECT_EQ("mesh", std::string(reinterpret_cast<const char *>(view.data()),
+                                view.size()));
+  size_t size = 0;
+  std::shared_ptr<const AssetPack> pack;
+  EXPECT_EQ(FindInAssetPacks("a.fplmesh", &size, &pack), view.data());
+
+  // Views outlive unmounting, and can be moved.
+  ASSERT_TRUE(UnmountAssetPack(kPackFile));
+  pack.reset();
+  FileView moved(std::move(view));
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ(0, memcmp(moved.data(), "mesh", moved.size()));
+}
+
+TEST_F(AssetPackTest, FileViewsReadFiles) {
+  // Not mounted, so this reads the pack file itself.
+  FileView view;
+  ASSERT_TRUE(LoadFileView(kPackFile, &view));
+  std::string contents;
+  ASSERT_TRUE(LoadFile(kPackFile, &contents));
+  EXPECT_EQ(contents, std::string(reinterpret_cast<const char *>(view.data()),
+                                  view.size()));
+  EXPECT_FALSE(LoadFileView("asset_pack_test_missing", &view));
+  EXPECT_TRUE(view.empty());
+}
+
+}  // namespace
+}  // namespace fplbase
@@ -0,0 +1,96 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <utility>
+#include <vector>
+
+#include "fplbase/asset.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+class TestAsset : public Asset {
+ public:
+  int value = 0;
+};
+
+TEST(AssetHandleTest, CountsHandles) {
+  TestAsset asset;
+  EXPECT_EQ(0, asset.handle_count());
+  {
+    AssetHandle<TestAsset> handle(&asset);
+    EXPECT_EQ(1, asset.handle_count());
+    EXPECT_EQ(&asset, handle.get());
+    handle->value = 1;
+    EXPECT_EQ(1, (*handle).value);
+
+    AssetHandle<TestAsset> copy(handle);
+    EXPECT_EQ(2, asset.handle_count());
+    AssetHandle<TestAsset> assigned;
+    assigned = copy;
+    EXPECT_EQ(3, asset.handle_count());
+    assigned = assigned;
+    EXPECT_EQ(3, asset.handle_count());
+  }
+  EXPECT_EQ(0, asset.handle_count());
+}
+
+TEST(AssetHandleTest, MoveAndReset) {
+  TestAsset a, b;
+  AssetHandle<TestAsset> handle(&a);
+  AssetHandle<TestAsset> moved(std::move(handle));
+  EXPECT_FALSE(handle);
+  EXPECT_TRUE(moved);
+  EXPECT_EQ(1, a.handle_count());
+
+  moved.reset(&b);
+  EXPECT_EQ(0, a.handle_count());
+  EXPECT_EQ(1, b.handle_count());
+  moved.reset();
+  EXPECT_EQ(0, b.handle_count());
+  EXPECT_EQ(nullptr, moved.get());
+}
+
+TEST(AssetHandleTest, InContainers) {
+  TestAsset asset;
+  std::vector<AssetHandle<TestAsset>> handles;
+  for (int i = 0; i < 100; ++i) handles.push_back(&asset);
+  EXPECT_EQ(100, asset.handle_count());
+  handles.clear();
+  EXPECT_EQ(0, asset.handle_count());
+}
+
+TEST(AssetMemoryUsageTest, Adds) {
+  AssetMemoryUsage usage;
+  EXPECT_EQ(0u, usage.total());
+  usage += AssetMemoryUsage(100, 20);
+  usage += AssetMemoryUsage(1, 2);
+  EXPECT_EQ(101u, usage.gpu_bytes);
+  EXPECT_EQ(22u, usage.cpu_bytes);
+  EXPECT_EQ(123u, usage.total());
+
+  // Assets that don't know better count at least their own size.
+  TestAsset asset;
+  EXPECT_EQ(0u, asset.MemoryUsage().gpu_bytes);
+  EXPECT_LT(0u, asset.MemoryUsage().cpu_bytes);
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
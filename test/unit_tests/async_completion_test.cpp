@@ -0,0 +1,182 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fplbase/async_completion.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+class TestAsset : public AsyncAsset {
+ public:
+  explicit TestAsset(const std::string &name) : AsyncAsset(name.c_str()) {}
+
+  virtual void Load() {
+    data_ = reinterpret_cast<const uint8_t *>(filename_.c_str());
+  }
+
+  virtual bool Finalize() {
+    data_ = nullptr;
+    CallFinalizeCallback();
+    return true;
+  }
+
+  virtual bool IsValid() { return IsFinalized(); }
+
+  virtual bool SupportsConcurrentLoad() const { return true; }
+};
+
+typedef std::vector<std::unique_ptr<TestAsset>> TestAssets;
+
+// Records the order in which listeners were notified.
+class OrderListener : public FinalizeListener {
+ public:
+  OrderListener(int id, std::vector<int> *order) : id_(id), order_(order) {}
+  virtual void OnFinalized() { order_->push_back(id_); }
+
+ private:
+  int id_;
+  std::vector<int> *order_;
+};
+
+void CreateAssets(int count, TestAssets *assets,
+                  std::vector<AsyncAsset *> *pointers) {
+  for (int i = 0; i < count; ++i) {
+    assets->emplace_back(new TestAsset("asset" + std::to_string(i)));
+    pointers->push_back(assets->back().get());
+  }
+}
+
+void LoadAll(const TestAssets &assets) {
+  AsyncLoader loader;
+  loader.SetNumWorkers(2);
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    loader.QueueJob(it->get());
+  }
+  loader.StartLoading();
+  loader.Stop();
+  EXPECT_TRUE(loader.TryFinalize());
+}
+
+}  // namespace
+
+class AsyncCompletionTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// Listeners are notified in order, after the asset is finalized.
+TEST_F(AsyncCompletionTests, FinalizeListener) {
+  TestAsset asset("asset");
+  std::vector<int> order;
+  OrderListener first(1, &order);
+  OrderListener removed(2, &order);
+  bool finalized = false;
+  auto last = MakeFinalizeFunction([&]() {
+    finalized = asset.IsFinalized();
+    order.push_back(3);
+  });
+  EXPECT_TRUE(asset.AddFinalizeListener(&first));
+  EXPECT_TRUE(asset.AddFinalizeListener(&removed));
+  EXPECT_TRUE(asset.AddFinalizeListener(&last));
+  EXPECT_TRUE(asset.RemoveFinalizeListener(&removed));
+  EXPECT_FALSE(asset.RemoveFinalizeListener(&removed));
+
+  EXPECT_TRUE(asset.LoadNow());
+  EXPECT_TRUE(finalized);
+  ASSERT_EQ(2u, order.size());
+  EXPECT_EQ(1, order[0]);
+  EXPECT_EQ(3, order[1]);
+  EXPECT_FALSE(asset.AddFinalizeListener(&first));
+}
+
+// A group is ready once all of its assets are finalized.
+TEST_F(AsyncCompletionTests, WhenAll) {
+  TestAssets assets;
+  std::vector<AsyncAsset *> pointers;
+  CreateAssets(30, &assets, &pointers);
+  WhenAll group(pointers);
+  EXPECT_EQ(30, group.num_pending());
+  int num_ready = 0;
+  auto count = MakeFinalizeFunction([&]() { ++num_ready; });
+  group.Then(&count);
+
+  LoadAll(assets);
+  EXPECT_TRUE(group.IsReady());
+  EXPECT_EQ(1, num_ready);
+}
+
+// Continuations can wait for other groups in turn.
+TEST_F(AsyncCompletionTests, Chaining) {
+  TestAssets first_assets;
+  TestAssets second_assets;
+  std::vector<AsyncAsset *> first_pointers;
+  std::vector<AsyncAsset *> second_pointers;
+  CreateAssets(3, &first_assets, &first_pointers);
+  CreateAssets(3, &second_assets, &second_pointers);
+  std::unique_ptr<WhenAll> second;
+  std::vector<int> order;
+  OrderListener second_ready(2, &order);
+  WhenAll first(first_pointers);
+  auto chain = MakeFinalizeFunction([&]() {
+    order.push_back(1);
+    second.reset(new WhenAll(second_pointers));
+    second->Then(&second_ready);
+  });
+  first.Then(&chain);
+
+  LoadAll(first_assets);
+  ASSERT_EQ(1u, order.size());
+  ASSERT_TRUE(second != nullptr);
+  EXPECT_EQ(3, second->num_pending());
+  LoadAll(second_assets);
+  ASSERT_EQ(2u, order.size());
+  EXPECT_EQ(2, order[1]);
+}
+
+// Groups of assets that are finalized already are ready right away, and
+// destroying a group stops it from listening.
+TEST_F(AsyncCompletionTests, ReadyAndDestroyedGroups) {
+  TestAssets assets;
+  std::vector<AsyncAsset *> pointers;
+  CreateAssets(4, &assets, &pointers);
+  EXPECT_TRUE(assets[0]->LoadNow());
+  {
+    WhenAll group(pointers);
+    EXPECT_EQ(3, group.num_pending());
+  }
+  LoadAll(assets);
+
+  WhenAll group(pointers);
+  EXPECT_TRUE(group.IsReady());
+  int num_ready = 0;
+  auto count = MakeFinalizeFunction([&]() { ++num_ready; });
+  group.Then(&count);
+  EXPECT_EQ(1, num_ready);
+
+  WhenAll empty(nullptr, 0);
+  EXPECT_TRUE(empty.IsReady());
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,858 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "fplbase/async_loader.h"
+#include "fplbase/utilities.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+// Tracks how many TestAssets are inside Load() at the same time, and the
+// order in which they were loaded.
+struct LoadStats {
+  LoadStats()
+      : num_loading(0), max_num_loading(0), num_destroyed(0), num_staged(0),
+        max_num_staged(0), num_decoded(0) {}
+  std::atomic<int> num_loading;
+  std::atomic<int> max_num_loading;
+  std::atomic<int> num_destroyed;
+  // Assets whose file data was read, but not yet decoded.
+  std::atomic<int> num_staged;
+  std::atomic<int> max_num_staged;
+  std::atomic<int> num_decoded;
+  std::mutex mutex;
+  std::vector<std::string> load_order;
+  // Only touched by the main thread.
+  std::vector<std::string> finalize_order;
+};
+
+void UpdateMax(std::atomic<int> *max_value, int value) {
+  int max = *max_value;
+  while (value > max && !max_value->compare_exchange_weak(max, value)) {
+  }
+}
+
+class TestAsset : public AsyncAsset {
+ public:
+  TestAsset(const char *filename, LoadStats *stats, bool concurrent)
+      : AsyncAsset(filename), stats_(stats), concurrent_(concurrent),
+        num_finalized_(0), cost_(0), finalize_time_ms_(0),
+        wait_for_cancel_(false), staged_(false), decode_time_ms_(0) {}
+  virtual ~TestAsset() { ++stats_->num_destroyed; }
+
+  virtual void Load() {
+    UpdateMax(&stats_->max_num_loading, ++stats_->num_loading);
+    {
+      std::lock_guard<std::mutex> lock(stats_->mutex);
+      stats_->load_order.push_back(filename_);
+    }
+    for (auto it = dependencies_.begin(); it != dependencies_.end(); ++it) {
+      AddDependency(*it);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    // Simulates a long decode that stops early once it's no longer needed.
+    for (int i = 0; wait_for_cancel_ && !IsLoadCancelled() && i < 5000; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    --stats_->num_loading;
+    data_ = reinterpret_cast<const uint8_t *>(filename_.c_str());
+  }
+
+  virtual bool Finalize() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(finalize_time_ms_));
+    ++num_finalized_;
+    stats_->finalize_order.push_back(filename_);
+    data_ = nullptr;
+    CallFinalizeCallback();
+    return true;
+  }
+
+  virtual bool IsValid() { return num_finalized_ == 1; }
+
+  virtual bool SupportsConcurrentLoad() const { return concurrent_; }
+
+  virtual size_t EstimateFinalizeCost() const { return cost_; }
+
+  virtual bool SupportsStagedLoad() const { return staged_; }
+
+  virtual void LoadFileData() {
+    Load();
+    data_ = nullptr;
+    UpdateMax(&stats_->max_num_staged, ++stats_->num_staged);
+  }
+
+  virtual void DecodeFileData() {
+    --stats_->num_staged;
+    std::this_thread::sleep_for(std::chrono::milliseconds(decode_time_ms_));
+    ++stats_->num_decoded;
+    data_ = reinterpret_cast<const uint8_t *>(filename_.c_str());
+  }
+
+  virtual size_t FileDataSize() const { return 100; }
+
+  void set_cost(size_t cost) { cost_ = cost; }
+  void set_finalize_time_ms(int ms) { finalize_time_ms_ = ms; }
+  void set_wait_for_cancel(bool wait) { wait_for_cancel_ = wait; }
+  void set_staged(bool staged, int decode_time_ms) {
+    staged_ = staged;
+    decode_time_ms_ = decode_time_ms;
+  }
+  // Dependencies to add when loaded.
+  void add_dependency(TestAsset *dependency) {
+    dependencies_.push_back(dependency);
+  }
+
+ private:
+  LoadStats *stats_;
+  bool concurrent_;
+  int num_finalized_;
+  size_t cost_;
+  int finalize_time_ms_;
+  bool wait_for_cancel_;
+  bool staged_;
+  int decode_time_ms_;
+  std::vector<TestAsset *> dependencies_;
+};
+
+typedef std::vector<std::unique_ptr<TestAsset>> TestAssets;
+
+void QueueTestAssets(AsyncLoader *loader, LoadStats *stats, bool concurrent,
+                     int count, TestAssets *assets) {
+  for (int i = 0; i < count; ++i) {
+    const std::string name = "asset" + std::to_string(assets->size());
+    assets->emplace_back(new TestAsset(name.c_str(), stats, concurrent));
+    loader->QueueJob(assets->back().get());
+  }
+}
+
+void FinalizeAll(AsyncLoader *loader) {
+  while (!loader->TryFinalize()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Runs every task on a thread of its own, and tracks how many run at once.
+class TestExecutor : public AsyncExecutor {
+ public:
+  TestExecutor() : num_tasks(0), num_running(0), max_num_running(0) {}
+  virtual ~TestExecutor() {
+    for (auto it = threads_.begin(); it != threads_.end(); ++it) it->join();
+  }
+
+  virtual void Execute(const std::function<void()> &task) {
+    ++num_tasks;
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.push_back(std::thread([this, task]() {
+      UpdateMax(&max_num_running, ++num_running);
+      task();
+      --num_running;
+    }));
+  }
+
+  std::atomic<int> num_tasks;
+  std::atomic<int> num_running;
+  std::atomic<int> max_num_running;
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::thread> threads_;
+};
+
+// Runs tasks right away, on the calling thread.
+class InlineExecutor : public AsyncExecutor {
+ public:
+  virtual void Execute(const std::function<void()> &task) { task(); }
+};
+
+}  // namespace
+
+class AsyncLoaderTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// All assets get loaded and finalized exactly once by a single worker.
+TEST_F(AsyncLoaderTests, SingleWorker) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 20, &assets);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  EXPECT_EQ(1, stats.max_num_loading);
+}
+
+// Concurrent assets are spread over all workers.
+TEST_F(AsyncLoaderTests, MultipleWorkers) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(4);
+  EXPECT_EQ(4, loader.num_workers());
+  QueueTestAssets(&loader, &stats, true, 100, &assets);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  EXPECT_LE(2, stats.max_num_loading);
+  EXPECT_GE(4, stats.max_num_loading);
+}
+
+// Assets that don't support concurrent loading are loaded one at a time.
+TEST_F(AsyncLoaderTests, NonConcurrentAssetsAreSerialized) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(4);
+  QueueTestAssets(&loader, &stats, false, 20, &assets);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  EXPECT_EQ(1, stats.max_num_loading);
+}
+
+// Idle workers steal jobs that were all queued before there were workers.
+TEST_F(AsyncLoaderTests, WorkStealing) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 100, &assets);
+  loader.SetNumWorkers(4);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  EXPECT_LE(2, stats.max_num_loading);
+}
+
+// Loading can be paused, and resumed with a different number of workers.
+TEST_F(AsyncLoaderTests, PauseAndResume) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(2);
+  QueueTestAssets(&loader, &stats, true, 50, &assets);
+  loader.StartLoading();
+  loader.PauseLoading();
+  loader.SetNumWorkers(3);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+}
+
+// Higher priority jobs are loaded first, and jobs can be re-prioritized while
+// they are queued.
+TEST_F(AsyncLoaderTests, Priorities) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 10, &assets);
+  assets.emplace_back(new TestAsset("urgent", &stats, true));
+  loader.QueueJob(assets.back().get(), kLoadPriorityHighest);
+  assets.emplace_back(new TestAsset("unimportant", &stats, true));
+  loader.QueueJob(assets.back().get(), kLoadPriorityLowest);
+  EXPECT_TRUE(loader.SetJobPriority(assets[5].get(), kLoadPriorityHigh));
+  EXPECT_TRUE(loader.SetJobPriority(assets[0].get(), kLoadPriorityLow));
+  EXPECT_EQ(kLoadPriorityHigh, assets[5]->load_priority());
+
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_FALSE(loader.SetJobPriority(assets[1].get(), kLoadPriorityHigh));
+
+  ASSERT_EQ(assets.size(), stats.load_order.size());
+  EXPECT_EQ("urgent", stats.load_order[0]);
+  EXPECT_EQ("asset5", stats.load_order[1]);
+  EXPECT_EQ("asset1", stats.load_order[2]);
+  EXPECT_EQ("asset0", stats.load_order[10]);
+  EXPECT_EQ("unimportant", stats.load_order[11]);
+}
+
+// Jobs queued together are loaded in the order they were given.
+TEST_F(AsyncLoaderTests, QueueJobs) {
+  LoadStats stats;
+  TestAssets assets;
+  std::vector<AsyncAsset *> jobs;
+  for (int i = 0; i < 10; ++i) {
+    const std::string name = "asset" + std::to_string(i);
+    assets.emplace_back(new TestAsset(name.c_str(), &stats, true));
+    jobs.push_back(assets.back().get());
+  }
+  std::reverse(jobs.begin(), jobs.end());
+  AsyncLoader loader;
+  loader.QueueJobs(jobs, kLoadPriorityHigh);
+  EXPECT_EQ(10, loader.num_pending_jobs());
+  EXPECT_EQ(kLoadPriorityHigh, assets[0]->load_priority());
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  ASSERT_EQ(assets.size(), stats.load_order.size());
+  EXPECT_EQ("asset9", stats.load_order[0]);
+  EXPECT_EQ("asset0", stats.load_order[9]);
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+}
+
+// Aborted jobs are never finalized.
+TEST_F(AsyncLoaderTests, AbortJob) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(2);
+  QueueTestAssets(&loader, &stats, true, 20, &assets);
+  loader.AbortJob(assets[3].get());
+  loader.StartLoading();
+  loader.AbortJob(assets[10].get());
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_FALSE(assets[3]->IsValid());
+  EXPECT_FALSE(assets[3]->IsFinalized());
+}
+
+// Aborting a job that is loading doesn't wait for it, but lets Load() know it
+// can stop.
+TEST_F(AsyncLoaderTests, AbortLoadingJob) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 2, &assets);
+  assets[0]->set_wait_for_cancel(true);
+  loader.StartLoading();
+  while (stats.num_loading == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_FALSE(loader.AbortJob(assets[0].get()));
+  EXPECT_TRUE(assets[0]->IsLoadCancelled());
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_FALSE(assets[0]->IsFinalized());
+  EXPECT_TRUE(assets[1]->IsValid());
+  EXPECT_TRUE(loader.AbortJob(assets[0].get()));
+}
+
+// A job that is still queued gets loaded and finalized by LoadJobNow(), and
+// not again by a worker.
+TEST_F(AsyncLoaderTests, LoadJobNowLoadsQueuedJob) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 3, &assets);
+  EXPECT_TRUE(loader.LoadJobNow(assets[1].get()));
+  EXPECT_TRUE(assets[1]->IsValid());
+  EXPECT_EQ(2, loader.num_pending_jobs());
+  EXPECT_FALSE(loader.LoadJobNow(assets[1].get()));
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_EQ(3u, stats.load_order.size());
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+}
+
+// LoadJobNow() waits for a worker that is loading the job, instead of loading
+// it again.
+TEST_F(AsyncLoaderTests, LoadJobNowWaitsForWorker) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(2);
+  QueueTestAssets(&loader, &stats, true, 4, &assets);
+  assets[0]->set_staged(true, 5);
+  loader.StartLoading();
+  while (stats.num_loading == 0 && stats.num_decoded == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(loader.LoadJobNow(assets[0].get()));
+  EXPECT_TRUE(assets[0]->IsValid());
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_EQ(4u, stats.load_order.size());
+  EXPECT_TRUE(assets[0]->IsValid());
+}
+
+// LoadJobNow() finalizes what the job depends on first.
+TEST_F(AsyncLoaderTests, LoadJobNowLoadsDependencies) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 3, &assets);
+  assets[0]->add_dependency(assets[2].get());
+  EXPECT_TRUE(loader.LoadJobNow(assets[0].get()));
+  ASSERT_EQ(2u, stats.finalize_order.size());
+  EXPECT_EQ("asset2", stats.finalize_order[0]);
+  EXPECT_EQ("asset0", stats.finalize_order[1]);
+  EXPECT_EQ(1, loader.num_pending_jobs());
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+}
+
+// Assets that can't load concurrently are still only loaded by the first
+// worker, unless loading is paused.
+TEST_F(AsyncLoaderTests, LoadJobNowKeepsNonConcurrentJobsSerialized) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, false, 10, &assets);
+  EXPECT_TRUE(loader.LoadJobNow(assets[0].get()));
+  loader.StartLoading();
+  EXPECT_TRUE(loader.LoadJobNow(assets[9].get()));
+  EXPECT_TRUE(assets[9]->IsValid());
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_EQ(1, stats.max_num_loading);
+  EXPECT_EQ(10u, stats.load_order.size());
+}
+
+// ReloadJob() loads and finalizes a finalized asset again, but only once it
+// is done loading.
+TEST_F(AsyncLoaderTests, ReloadJob) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 2, &assets);
+  EXPECT_FALSE(loader.ReloadJob(assets[0].get()));
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  EXPECT_TRUE(loader.ReloadJob(assets[0].get()));
+  EXPECT_FALSE(loader.ReloadJob(assets[0].get()));
+  EXPECT_TRUE(assets[0]->IsFinalized());
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_EQ(3u, stats.load_order.size());
+  ASSERT_EQ(3u, stats.finalize_order.size());
+  EXPECT_EQ("asset0", stats.finalize_order.back());
+
+  // Assets loaded without a loader can be reloaded by one too.
+  TestAsset asset("loaded_now", &stats, true);
+  EXPECT_FALSE(loader.ReloadJob(&asset));
+  asset.LoadNow();
+  EXPECT_TRUE(loader.ReloadJob(&asset));
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_EQ("loaded_now", stats.finalize_order.back());
+  EXPECT_EQ(5u, stats.finalize_order.size());
+}
+
+// Assets passed to AbortJobAndDelete are deleted once the loader is done with
+// them.
+TEST_F(AsyncLoaderTests, AbortJobAndDelete) {
+  LoadStats stats;
+  AsyncLoader loader;
+  TestAsset *loading = new TestAsset("loading", &stats, true);
+  loading->set_wait_for_cancel(true);
+  loader.QueueJob(loading);
+  TestAsset *queued = new TestAsset("queued", &stats, true);
+  loader.QueueJob(queued);
+  loader.StartLoading();
+  while (stats.num_loading == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  loader.AbortJobAndDelete(queued);
+  EXPECT_EQ(1, stats.num_destroyed);
+  loader.AbortJobAndDelete(loading);
+  loader.Stop();
+  EXPECT_EQ(2, stats.num_destroyed);
+  EXPECT_EQ(1u, stats.load_order.size());
+}
+
+// Dependencies discovered by Load() are loaded right away, and finalized
+// before the asset that depends on them.
+TEST_F(AsyncLoaderTests, Dependencies) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(4);
+  QueueTestAssets(&loader, &stats, true, 1, &assets);
+  TestAsset *parent = assets[0].get();
+  for (int i = 0; i < 6; ++i) {
+    const std::string name = "child" + std::to_string(i);
+    assets.emplace_back(new TestAsset(name.c_str(), &stats, true));
+    parent->add_dependency(assets.back().get());
+  }
+  // One child is already queued, with a lower priority.
+  loader.QueueJob(assets[1].get(), kLoadPriorityLowest);
+  loader.AddDependency(parent, assets[1].get());
+  EXPECT_EQ(kLoadPriorityNormal, assets[1]->load_priority());
+  // One grandchild.
+  assets.emplace_back(new TestAsset("grandchild", &stats, true));
+  assets[2]->add_dependency(assets.back().get());
+
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  ASSERT_EQ(assets.size(), stats.finalize_order.size());
+  EXPECT_EQ("asset0", stats.finalize_order.back());
+  EXPECT_LE(2, stats.max_num_loading);
+  const auto child1 = std::find(stats.finalize_order.begin(),
+                                stats.finalize_order.end(), "child1");
+  const auto grandchild = std::find(stats.finalize_order.begin(),
+                                    stats.finalize_order.end(), "grandchild");
+  EXPECT_LT(grandchild, child1);
+}
+
+// Aborting a dependency doesn't block the assets depending on it.
+TEST_F(AsyncLoaderTests, AbortDependency) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 2, &assets);
+  loader.AddDependency(assets[0].get(), assets[1].get());
+  loader.AbortJob(assets[1].get());
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_TRUE(assets[0]->IsValid());
+  EXPECT_FALSE(assets[1]->IsFinalized());
+}
+
+// With I/O workers, staged assets are read and decoded on different threads.
+TEST_F(AsyncLoaderTests, StagedLoad) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumWorkers(2);
+  loader.SetNumIoWorkers(1);
+  EXPECT_EQ(1, loader.num_io_workers());
+  QueueTestAssets(&loader, &stats, true, 10, &assets);
+  for (int i = 0; i < 20; ++i) {
+    assets.emplace_back(new TestAsset("staged", &stats, true));
+    assets.back()->set_staged(true, 2);
+    loader.QueueJob(assets.back().get());
+  }
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  EXPECT_EQ(20, stats.num_decoded);
+  EXPECT_EQ(0, stats.num_staged);
+}
+
+// I/O workers stop reading ahead once enough data is waiting to be decoded.
+TEST_F(AsyncLoaderTests, StagedLoadBackpressure) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumIoWorkers(2);
+  loader.SetMaxStagedBytes(100);
+  for (int i = 0; i < 20; ++i) {
+    assets.emplace_back(new TestAsset("staged", &stats, true));
+    assets.back()->set_staged(true, 5);
+    loader.QueueJob(assets.back().get());
+  }
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_EQ(20, stats.num_decoded);
+  // One staged file, plus one per I/O worker that was already reading.
+  EXPECT_GE(3, stats.max_num_staged);
+}
+
+// A byte budget limits how many assets get finalized per call, preferring
+// cheaper assets when the next one doesn't fit.
+TEST_F(AsyncLoaderTests, FinalizeByteBudget) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 5, &assets);
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    (*it)->set_cost(100);
+  }
+  assets[1]->set_cost(1000);
+  loader.StartLoading();
+  loader.Stop();
+
+  const FinalizeBudget budget(0.0, 250);
+  FinalizeStatus status;
+  EXPECT_FALSE(loader.TryFinalize(budget, &status));
+  EXPECT_EQ(2, status.num_finalized);
+  EXPECT_EQ(200u, status.bytes_finalized);
+  EXPECT_EQ(3, status.num_ready);
+  EXPECT_EQ(1200u, status.bytes_ready);
+  EXPECT_EQ(3, status.num_pending);
+  EXPECT_TRUE(assets[0]->IsValid());
+  EXPECT_FALSE(assets[1]->IsValid());
+  EXPECT_TRUE(assets[2]->IsValid());
+
+  // The expensive asset doesn't fit, but is first in line, so it gets
+  // finalized on its own.
+  EXPECT_FALSE(loader.TryFinalize(budget, &status));
+  EXPECT_EQ(1, status.num_finalized);
+  EXPECT_TRUE(assets[1]->IsValid());
+
+  EXPECT_TRUE(loader.TryFinalize(budget, &status));
+  EXPECT_EQ(2, status.num_finalized);
+  EXPECT_EQ(0, status.num_ready);
+  EXPECT_EQ(0, status.num_pending);
+}
+
+// A time budget spreads expensive finalizes over multiple calls.
+TEST_F(AsyncLoaderTests, FinalizeTimeBudget) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, true, 4, &assets);
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    (*it)->set_finalize_time_ms(5);
+  }
+  loader.StartLoading();
+  loader.Stop();
+
+  const FinalizeBudget budget(0.001, 0);
+  FinalizeStatus status;
+  int num_calls = 0;
+  while (!loader.TryFinalize(budget, &status)) {
+    EXPECT_EQ(1, status.num_finalized);
+    ++num_calls;
+  }
+  EXPECT_EQ(3, num_calls);
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+}
+
+// Jobs are finalized in the order they finished loading, and the number of
+// pending jobs can be polled at any time.
+TEST_F(AsyncLoaderTests, PendingJobs) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  QueueTestAssets(&loader, &stats, false, 10, &assets);
+  EXPECT_EQ(10, loader.num_pending_jobs());
+  loader.StartLoading();
+  loader.Stop();
+  EXPECT_EQ(10, loader.num_pending_jobs());
+
+  FinalizeStatus status;
+  EXPECT_TRUE(loader.TryFinalize(FinalizeBudget(), &status));
+  EXPECT_EQ(10, status.num_finalized);
+  EXPECT_EQ(0, status.num_pending);
+  EXPECT_EQ(0, loader.num_pending_jobs());
+  EXPECT_EQ(stats.load_order, stats.finalize_order);
+
+  // Nothing left to do.
+  EXPECT_TRUE(loader.TryFinalize(FinalizeBudget(), &status));
+  EXPECT_EQ(0, status.num_finalized);
+  EXPECT_EQ(0, status.num_ready);
+}
+
+// Telemetry records every step of every finalized asset, in order.
+TEST_F(AsyncLoaderTests, Telemetry) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetNumIoWorkers(1);
+  QueueTestAssets(&loader, &stats, true, 2, &assets);
+  assets[1]->set_staged(true, 1);
+  assets[1]->set_cost(100);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  EXPECT_TRUE(loader.load_records().empty());
+  EXPECT_TRUE(loader.queue_depth_samples().empty());
+
+  // Only assets finalized while enabled are recorded.
+  loader.SetTelemetryEnabled(true);
+  QueueTestAssets(&loader, &stats, true, 1, &assets);
+  assets[2]->set_staged(true, 1);
+  QueueTestAssets(&loader, &stats, true, 1, &assets);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  ASSERT_EQ(2u, loader.load_records().size());
+  for (auto it = loader.load_records().begin();
+       it != loader.load_records().end(); ++it) {
+    EXPECT_LT(0.0, it->queued);
+    EXPECT_LE(it->queued, it->load_start);
+    EXPECT_LE(it->load_start, it->load_end);
+    EXPECT_LE(it->load_end, it->finalize_start);
+    EXPECT_LE(it->finalize_start, it->finalize_end);
+    if (it->filename == "asset2") {
+      EXPECT_LE(it->load_start, it->read_end);
+      EXPECT_LE(it->read_end, it->decode_start);
+      EXPECT_LE(it->decode_start, it->load_end);
+      EXPECT_EQ(100u, it->bytes_read);
+    } else {
+      EXPECT_EQ("asset3", it->filename);
+      EXPECT_EQ(0.0, it->read_end);
+      EXPECT_EQ(0u, it->bytes_read);
+    }
+  }
+  ASSERT_FALSE(loader.queue_depth_samples().empty());
+  EXPECT_EQ(0, loader.queue_depth_samples().back().num_pending);
+
+  const std::string json = loader.TelemetryToJson();
+  EXPECT_NE(std::string::npos, json.find("\"filename\": \"asset2\""));
+  EXPECT_NE(std::string::npos, json.find("\"queue_depth\": ["));
+  loader.ClearTelemetry();
+  EXPECT_TRUE(loader.load_records().empty());
+  EXPECT_TRUE(loader.queue_depth_samples().empty());
+}
+
+// The files of the next queued jobs are read ahead as each job is taken.
+TEST_F(AsyncLoaderTests, ReadAhead) {
+  char dir[] = "/tmp/fplbase_read_ahead_XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetReadAheadDepth(2);
+  for (int i = 0; i < 5; ++i) {
+    const std::string filename = dir + ("/file" + std::to_string(i));
+    ASSERT_TRUE(SaveFile(filename.c_str(), filename));
+    assets.emplace_back(new TestAsset(filename.c_str(), &stats, true));
+    loader.QueueJob(assets.back().get());
+  }
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+
+  // Only the first job wasn't read ahead, and each file was read ahead once.
+  const ReadAheadStats read_ahead = loader.GetReadAheadStats();
+  EXPECT_EQ(4, read_ahead.num_hints);
+  EXPECT_EQ(0, read_ahead.num_failed_hints);
+  EXPECT_EQ(4, read_ahead.num_hinted_loads);
+  EXPECT_EQ(1, read_ahead.num_unhinted_loads);
+  EXPECT_EQ(0, read_ahead.num_wasted_hints);
+  EXPECT_LT(0.0, read_ahead.total_lead_seconds);
+  loader.ResetReadAheadStats();
+  EXPECT_EQ(0, loader.GetReadAheadStats().num_hints);
+
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    remove((*it)->filename().c_str());
+  }
+  remove(dir);
+}
+
+// Aborting a job that was read ahead wastes the read, and missing files
+// can't be read ahead at all.
+TEST_F(AsyncLoaderTests, ReadAheadStats) {
+  LoadStats stats;
+  TestAssets assets;
+  AsyncLoader loader;
+  loader.SetReadAheadDepth(2);
+  QueueTestAssets(&loader, &stats, true, 3, &assets);
+  assets[0]->set_wait_for_cancel(true);
+  loader.StartLoading();
+  while (loader.GetReadAheadStats().num_failed_hints < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(loader.AbortJob(assets[1].get()));
+  loader.AbortJob(assets[0].get());
+  FinalizeAll(&loader);
+  loader.Stop();
+
+  const ReadAheadStats read_ahead = loader.GetReadAheadStats();
+  EXPECT_EQ(2, read_ahead.num_hints);
+  EXPECT_EQ(2, read_ahead.num_failed_hints);
+  EXPECT_EQ(1, read_ahead.num_hinted_loads);
+  EXPECT_EQ(1, read_ahead.num_unhinted_loads);
+  EXPECT_EQ(1, read_ahead.num_wasted_hints);
+}
+
+// Workers run as tasks on an app-provided executor, no more than one per
+// worker at a time.
+TEST_F(AsyncLoaderTests, Executor) {
+  LoadStats stats;
+  TestAssets assets;
+  TestExecutor executor;
+  AsyncLoader loader;
+  loader.SetExecutor(&executor);
+  loader.SetNumWorkers(3);
+  QueueTestAssets(&loader, &stats, true, 30, &assets);
+  QueueTestAssets(&loader, &stats, false, 10, &assets);
+  EXPECT_EQ(0, executor.num_tasks);
+  loader.StartLoading();
+  FinalizeAll(&loader);
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+  EXPECT_LE(1, executor.num_tasks);
+  EXPECT_GE(3, executor.max_num_running);
+  EXPECT_GE(3, stats.max_num_loading);
+
+  // Nothing runs on the executor while the loader is stopped.
+  const int num_tasks = executor.num_tasks;
+  QueueTestAssets(&loader, &stats, true, 1, &assets);
+  EXPECT_EQ(num_tasks, executor.num_tasks);
+  loader.AbortJob(assets.back().get());
+}
+
+// An executor may run tasks on the thread that hands them over.
+TEST_F(AsyncLoaderTests, InlineExecutor) {
+  LoadStats stats;
+  TestAssets assets;
+  InlineExecutor executor;
+  AsyncLoader loader;
+  loader.SetExecutor(&executor);
+  loader.SetNumIoWorkers(1);
+  QueueTestAssets(&loader, &stats, true, 5, &assets);
+  for (int i = 0; i < 5; ++i) {
+    assets.emplace_back(new TestAsset("staged", &stats, true));
+    assets.back()->set_staged(true, 0);
+    loader.QueueJob(assets.back().get());
+  }
+  loader.StartLoading();
+  EXPECT_EQ(assets.size(), stats.load_order.size());
+  EXPECT_EQ(5, stats.num_decoded);
+  EXPECT_TRUE(loader.TryFinalize());
+  loader.Stop();
+  for (auto it = assets.begin(); it != assets.end(); ++it) {
+    EXPECT_TRUE((*it)->IsValid());
+  }
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fplbase/compressed_file.h"
+#include "fplbase/file_system.h"
+#include "fplbase/utilities.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> Files;
+
+// Text that compresses well, of `size` bytes.
+std::string Compressible(size_t size) {
+  std::string text;
+  for (int i = 0; text.size() < size; ++i) {
+    text += "vertex " + std::to_string(i % 100) + "\n";
+  }
+  text.resize(size);
+  return text;
+}
+
+// Bytes that don't compress at all, of `size` bytes.
+std::string Incompressible(size_t size) {
+  std::string bytes(size, 0);
+  uint32_t x = 12345;
+  for (size_t i = 0; i < size; ++i) {
+    x = x * 1103515245 + 12345;
+    bytes[i] = static_cast<char>(x >> 24);
+  }
+  return bytes;
+}
+
+std::string Decompress(const std::string &compressed) {
+  std::string contents;
+  if (!DecompressFileData(compressed.data(), compressed.size(), &contents)) {
+    return "<corrupt>";
+  }
+  return contents;
+}
+
+TEST(CompressedFileTest, RoundTrips) {
+  const std::string contents = Compressible(10000);
+  std::string compressed;
+  ASSERT_TRUE(CompressFileData(contents, 1024, &compressed));
+  EXPECT_TRUE(IsCompressedFileData(compressed.data(), compressed.size()));
+  EXPECT_FALSE(IsCompressedFileData(contents.data(), contents.size()));
+  EXPECT_LT(compressed.size(), contents.size() / 2);
+  EXPECT_EQ(contents, Decompress(compressed));
+}
+
+TEST(CompressedFileTest, RoundTripsEmptyFiles) {
+  std::string compressed;
+  ASSERT_TRUE(CompressFileData(std::string(), 1024, &compressed));
+  EXPECT_EQ(kCompressedFileHeaderSize, compressed.size());
+  EXPECT_EQ("", Decompress(compressed));
+}
+
+TEST(CompressedFileTest, StoresIncompressibleBlocks) {
+  const std::string contents = Incompressible(4000) + Compressible(4000);
+  std::string compressed;
+  ASSERT_TRUE(CompressFileData(contents, 1000, &compressed));
+  EXPECT_LT(compressed.size(), contents.size());
+  EXPECT_EQ(contents, Decompress(compressed));
+}
+
+TEST(CompressedFileTest, DecompressesOnManyThreads) {
+  const std::string contents = Compressible(5 * 1024 * 1024 + 17);
+  std::string compressed;
+  ASSERT_TRUE(CompressFileData(contents, 64 * 1024, &compressed));
+  const int max_threads = MaxDecompressionThreads();
+  SetMaxDecompressionThreads(4);
+  EXPECT_EQ(contents, Decompress(compressed));
+  SetMaxDecompressionThreads(max_threads);
+}
+
+TEST(CompressedFileTest, RejectsCorruptFiles) {
+  const std::string contents = Compressible(10000);
+  std::string compressed;
+  ASSERT_TRUE(CompressFileData(contents, 1024, &compressed));
+  EXPECT_EQ("<corrupt>", Decompress(compressed.substr(0, 10)));
+  EXPECT_EQ("<corrupt>",
+            Decompress(compressed.substr(0, compressed.size() - 1)));
+  // One byte more than the last block holds.
+  std::string corrupt = compressed;
+  ++corrupt[8];
+  EXPECT_EQ("<corrupt>", Decompress(corrupt));
+  EXPECT_FALSE(CompressFileData(contents, 0, &compressed));
+}
+
+TEST(CompressedFileTest, LoadFileDecompresses) {
+  const std::string contents = Compressible(10000);
+  std::string compressed;
+  ASSERT_TRUE(CompressFileData(contents, 1024, &compressed));
+  MountMemoryFiles("memory", Files{{"a.bin", compressed}});
+
+  std::string loaded;
+  ASSERT_TRUE(LoadFile("a.bin", &loaded));
+  EXPECT_EQ(contents, loaded);
+  FileView view;
+  ASSERT_TRUE(LoadFileView("a.bin", &view));
+  EXPECT_EQ(contents, std::string(reinterpret_cast<const char *>(
+                                      view.data()), view.size()));
+  Unmount("memory");
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
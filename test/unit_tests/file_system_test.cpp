@@ -0,0 +1,220 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fplbase/file_system.h"
+#include "fplbase/utilities.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> Files;
+
+class FileSystemTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    num_loads_ = 0;
+    SetLoadFileFunction([](const char *filename, std::string *dest) {
+      ++num_loads_;
+      if (strcmp(filename, "fallback.txt") != 0) return false;
+      *dest = "fallback";
+      return true;
+    });
+    ResetMountStats();
+  }
+  virtual void TearDown() {
+    std::vector<MountStats> stats;
+    GetMountStats(&stats);
+    for (auto it = stats.begin(); it != stats.end(); ++it) {
+      Unmount(it->name.c_str());
+    }
+    for (auto it = files_.rbegin(); it != files_.rend(); ++it) {
+      remove(it->c_str());
+    }
+    SetLoadFileFunction(nullptr);
+  }
+
+  // Makes a directory to mount, and returns its name.
+  std::string MakeDirectory() {
+    char dir[] = "/tmp/fplbase_file_system_XXXXXX";
+    EXPECT_TRUE(mkdtemp(dir) != nullptr);
+    files_.push_back(dir);
+    return dir;
+  }
+
+  void WriteFile(const std::string &filename, const char *contents) {
+    files_.push_back(filename);
+    EXPECT_TRUE(SaveFile(filename.c_str(), std::string(contents)));
+  }
+
+  std::string Load(const char *filename) {
+    std::string contents;
+    if (!LoadFile(filename, &contents)) return "<missing>";
+    return contents;
+  }
+
+  static int num_loads_;
+  std::vector<std::string> files_;
+};
+
+int FileSystemTest::num_loads_;
+
+TEST_F(FileSystemTest, LaterMountsComeFirst) {
+  MountMemoryFiles("first", Files{{"a.txt", "first a"}, {"b.txt", "b"}});
+  MountMemoryFiles("second", Files{{"a.txt", "second a"}});
+  EXPECT_EQ("second a", Load("a.txt"));
+  EXPECT_EQ("b", Load("b.txt"));
+  EXPECT_EQ("fallback", Load("fallback.txt"));
+  EXPECT_TRUE(Unmount("second"));
+  EXPECT_FALSE(Unmount("second"));
+  EXPECT_EQ("first a", Load("a.txt"));
+}
+
+TEST_F(FileSystemTest, ReadsDirectories) {
+  const std::string dir = MakeDirectory();
+  files_.push_back(dir + "/textures");
+  ASSERT_EQ(0, mkdir(files_.back().c_str(), 0700));
+  WriteFile(dir + "/textures/a.webp", "a");
+  ASSERT_TRUE(MountDirectory(dir.c_str()));
+  EXPECT_EQ("a", Load("textures/a.webp"));
+
+  FileView view;
+  ASSERT_TRUE(LoadFileView("textures/a.webp", &view));
+  EXPECT_EQ("a", std::string(reinterpret_cast<const char *>(view.data()),
+                             view.size()));
+
+  // Only listed when mounting.
+  WriteFile(dir + "/b.webp", "b");
+  EXPECT_EQ("<missing>", Load("b.webp"));
+  ASSERT_TRUE(MountDirectory(dir.c_str()));
+  EXPECT_EQ("b", Load("b.webp"));
+  EXPECT_FALSE(MountDirectory((dir + "/missing").c_str()));
+}
+
+TEST_F(FileSystemTest, DoesntListLinkedDirectoriesAgain) {
+  const std::string dir = MakeDirectory();
+  const std::string other = MakeDirectory();
+  files_.push_back(dir + "/textures");
+  ASSERT_EQ(0, mkdir(files_.back().c_str(), 0700));
+  WriteFile(dir + "/textures/a.webp", "a");
+  WriteFile(other + "/b.webp", "b");
+  // A link to an ancestor isn't followed, other links are.
+  files_.push_back(dir + "/textures/up");
+  ASSERT_EQ(0, symlink(dir.c_str(), files_.back().c_str()));
+  files_.push_back(dir + "/other");
+  ASSERT_EQ(0, symlink(other.c_str(), files_.back().c_str()));
+  ASSERT_TRUE(MountDirectory(dir.c_str()));
+  EXPECT_EQ("a", Load("textures/a.webp"));
+  EXPECT_EQ("b", Load("other/b.webp"));
+  EXPECT_EQ("<missing>", Load("textures/up/textures/a.webp"));
+}
+
+TEST_F(FileSystemTest, ResolvesMountedPaths) {
+  const std::string dir = MakeDirectory();
+  WriteFile(dir + "/a.webp", "a");
+  ASSERT_TRUE(MountDirectory(dir.c_str()));
+  EXPECT_EQ(dir + "/a.webp", ResolveMountedPath("a.webp"));
+  EXPECT_EQ("b.webp", ResolveMountedPath("b.webp"));
+  MountMemoryFiles("memory", Files{{"a.webp", "in memory"}});
+  EXPECT_EQ("", ResolveMountedPath("a.webp"));
+}
+
+TEST_F(FileSystemTest, RemembersMissingFiles) {
+  SetLoadFileFunction(nullptr);
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ(1, NumCachedMisses());
+
+  // Until it may have appeared.
+  MountMemoryFiles("memory", Files{{"missing.txt", "found"}});
+  EXPECT_EQ("found", Load("missing.txt"));
+  Unmount("memory");
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ(1, NumCachedMisses());
+  ForgetMissingFiles();
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ(1, NumCachedMisses());
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ(2, NumCachedMisses());
+}
+
+TEST_F(FileSystemTest, AsksTheLoadFileFunctionAgain) {
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ("<missing>", Load("missing.txt"));
+  EXPECT_EQ(2, num_loads_);
+  EXPECT_EQ(0, NumCachedMisses());
+}
+
+TEST_F(FileSystemTest, CountsHitsAndMisses) {
+  MountMemoryFiles("memory", Files{{"a.txt", "abc"}});
+  Load("a.txt");
+  Load("fallback.txt");
+  Load("missing.txt");
+  std::vector<MountStats> stats;
+  GetMountStats(&stats);
+  ASSERT_EQ(2u, stats.size());
+  EXPECT_EQ("memory", stats[0].name);
+  EXPECT_EQ(kMountMemory, stats[0].type);
+  EXPECT_EQ(1, stats[0].num_hits);
+  EXPECT_EQ(2, stats[0].num_misses);
+  EXPECT_EQ(3u, stats[0].num_bytes);
+  EXPECT_EQ(kMountLoadFileFunction, stats[1].type);
+  EXPECT_EQ(1, stats[1].num_hits);
+  EXPECT_EQ(1, stats[1].num_misses);
+}
+
+TEST_F(FileSystemTest, ReadsFilesAhead) {
+  const std::string dir = MakeDirectory();
+  WriteFile(dir + "/a.bin", "a");
+  ASSERT_TRUE(MountDirectory(dir.c_str()));
+  MountMemoryFiles("memory", Files{{"b.bin", "b"}});
+  EXPECT_TRUE(ReadAheadFile("a.bin"));
+  // Files in memory are never read.
+  EXPECT_FALSE(ReadAheadFile("b.bin"));
+  EXPECT_FALSE(ReadAheadFile("missing.bin"));
+  // Only files the default load file function reads can be read ahead.
+  EXPECT_FALSE(ReadAheadFile((dir + "/a.bin").c_str()));
+  SetLoadFileFunction(nullptr);
+  EXPECT_TRUE(ReadAheadFile((dir + "/a.bin").c_str()));
+  // Hints aren't loads.
+  std::vector<MountStats> stats;
+  GetMountStats(&stats);
+  EXPECT_EQ(0, stats[1].num_hits);
+}
+
+TEST_F(FileSystemTest, FileViewsOutliveTheirMount) {
+  MountMemoryFiles("memory", Files{{"a.txt", "in memory"}});
+  FileView view;
+  ASSERT_TRUE(LoadFileView("a.txt", &view));
+  Unmount("memory");
+  EXPECT_EQ("in memory", std::string(reinterpret_cast<const char *>(
+                                         view.data()), view.size()));
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,112 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "fplbase/file_watcher.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+void WriteFile(const std::string &filename, const char *contents) {
+  FILE *file = fopen(filename.c_str(), "wb");
+  ASSERT_TRUE(file != nullptr);
+  fputs(contents, file);
+  fclose(file);
+}
+
+class FileWatcherTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char dir[] = "/tmp/fplbase_file_watcher_XXXXXX";
+    if (FileWatcher::IsSupported()) {
+      ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    }
+    dir_ = dir;
+  }
+  virtual void TearDown() {
+    for (auto it = files_.begin(); it != files_.end(); ++it) {
+      remove(it->c_str());
+    }
+    remove(dir_.c_str());
+  }
+
+  std::string File(const char *name) {
+    files_.push_back(dir_ + "/" + name);
+    return files_.back();
+  }
+
+  std::string dir_;
+  std::vector<std::string> files_;
+};
+
+TEST_F(FileWatcherTest, ReportsWrittenFiles) {
+  FileWatcher watcher;
+  const std::string watched = File("watched.txt");
+  const std::string other = File("other.txt");
+  if (!FileWatcher::IsSupported()) {
+    EXPECT_FALSE(watcher.Watch(watched.c_str()));
+    return;
+  }
+  ASSERT_TRUE(watcher.Watch(watched.c_str()));
+  EXPECT_TRUE(watcher.IsWatched(watched));
+  EXPECT_FALSE(watcher.IsWatched(other));
+
+  std::vector<std::string> changed;
+  watcher.Poll(&changed);
+  EXPECT_TRUE(changed.empty());
+
+  // Written twice, but reported once.
+  WriteFile(watched, "a");
+  WriteFile(watched, "b");
+  WriteFile(other, "c");
+  watcher.Poll(&changed);
+  ASSERT_EQ(1u, changed.size());
+  EXPECT_EQ(watched, changed[0]);
+
+  changed.clear();
+  watcher.Poll(&changed);
+  EXPECT_TRUE(changed.empty());
+}
+
+TEST_F(FileWatcherTest, ReportsRenamedFiles) {
+  FileWatcher watcher;
+  const std::string watched = File("renamed.txt");
+  const std::string temp = File("renamed.txt.tmp");
+  if (!FileWatcher::IsSupported()) return;
+  ASSERT_TRUE(watcher.Watch(watched.c_str()));
+  WriteFile(temp, "a");
+  ASSERT_EQ(0, rename(temp.c_str(), watched.c_str()));
+  std::vector<std::string> changed;
+  watcher.Poll(&changed);
+  ASSERT_EQ(1u, changed.size());
+  EXPECT_EQ(watched, changed[0]);
+}
+
+TEST_F(FileWatcherTest, MissingDirectory) {
+  FileWatcher watcher;
+  EXPECT_FALSE(watcher.Watch((dir_ + "/missing/file.txt").c_str()));
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
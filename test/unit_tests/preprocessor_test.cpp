@@ -63,6 +63,17 @@ void PreprocessorTests::TearDown() {
   file_ = "";
 }
 
+// Every file that was read is reported, the top level one included.
+TEST_F(PreprocessorTests, ReportsIncludedFiles) {
+  const char *file = "#include \"common.glsl\"\nvoid main() {}\n";
+  std::set<std::string> files;
+  EXPECT_TRUE(fplbase::LoadFileWithDirectives(file, &file_, kEmptyDefines,
+                                              &error_message_, &files));
+  EXPECT_EQ(2u, files.size());
+  EXPECT_EQ(1u, files.count(file));
+  EXPECT_EQ(1u, files.count("common.glsl"));
+}
+
 // #defines should just be passed through.
 TEST_F(PreprocessorTests, DefinePassthrough) {
   const char* file = "#define foo";
@@ -0,0 +1,89 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "fplbase/read_mostly_mutex.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+const int kNumReaders = 8;
+
+TEST(ReadMostlyMutexTest, ReadersShareTheLock) {
+  ReadMostlyMutex mutex;
+  ReadMostlyMutex::ReadLock lock(mutex);
+  // Would wait forever if readers excluded each other.
+  std::thread other([&mutex]() { ReadMostlyMutex::ReadLock lock(mutex); });
+  other.join();
+}
+
+TEST(ReadMostlyMutexTest, WriterWaitsForReaders) {
+  ReadMostlyMutex mutex;
+  std::atomic<bool> written(false);
+  std::thread writer;
+  {
+    ReadMostlyMutex::ReadLock lock(mutex);
+    writer = std::thread([&]() {
+      ReadMostlyMutex::WriteLock lock(mutex);
+      written = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(written);
+  }
+  writer.join();
+  EXPECT_TRUE(written);
+}
+
+// Readers never see a map that is half way through being changed.
+TEST(ReadMostlyMutexTest, ReadersSeeConsistentData) {
+  ReadMostlyMutex mutex;
+  std::unordered_map<int, int> map;
+  map[0] = 0;
+  std::atomic<bool> done(false);
+  std::atomic<int> num_errors(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kNumReaders; ++i) {
+    readers.push_back(std::thread([&]() {
+      while (!done) {
+        ReadMostlyMutex::ReadLock lock(mutex);
+        // Every key the writer adds is the value of key 0.
+        auto it = map.find(map.find(0)->second);
+        if (it == map.end() || it->second != it->first) ++num_errors;
+      }
+    }));
+  }
+  for (int i = 1; i <= 1000; ++i) {
+    ReadMostlyMutex::WriteLock lock(mutex);
+    map[i] = i;
+    map[0] = i;
+    if (i > 1) map.erase(i - 1);
+  }
+  done = true;
+  for (auto it = readers.begin(); it != readers.end(); ++it) it->join();
+  EXPECT_EQ(0, num_errors.load());
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,108 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "fplbase/utilities.h"
+#include "gtest/gtest.h"
+#include "shader_generated.h"
+#include "shader_pipeline.h"
+
+namespace fplbase {
+namespace {
+
+char kIncludeDir[] = "include";
+
+// Runs shader_pipeline in a directory of its own, with an include dir.
+class ShaderPipelineTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char cwd[4096];
+    ASSERT_TRUE(getcwd(cwd, sizeof(cwd)) != nullptr);
+    cwd_ = cwd;
+    char dir[] = "/tmp/fplbase_shader_pipeline_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    dir_ = dir;
+    ASSERT_EQ(0, chdir(dir));
+    ASSERT_EQ(0, mkdir(kIncludeDir, 0700));
+    WriteFile("shader.glslf", "void main() {}\n");
+  }
+  virtual void TearDown() {
+    for (auto it = files_.begin(); it != files_.end(); ++it) {
+      remove(it->c_str());
+    }
+    remove("shader.fplshader");
+    remove(kIncludeDir);
+    EXPECT_EQ(0, chdir(cwd_.c_str()));
+    remove(dir_.c_str());
+  }
+
+  void WriteFile(const char *filename, const char *contents) {
+    files_.push_back(filename);
+    EXPECT_TRUE(SaveFile(filename, std::string(contents)));
+  }
+
+  // Returns the vertex shader shader_pipeline wrote, or "<failed>".
+  std::string Run() {
+    ShaderPipelineArgs args;
+    args.vertex_shader = "shader.glslv";
+    args.fragment_shader = "shader.glslf";
+    args.output_file = "shader.fplshader";
+    args.include_dirs.push_back(kIncludeDir);
+    std::string output;
+    if (RunShaderPipeline(args) != 0 ||
+        !LoadFile(args.output_file.c_str(), &output)) {
+      return "<failed>";
+    }
+    return shaderdef::GetShader(output.data())->vertex_shader()->str();
+  }
+
+  std::string cwd_;
+  std::string dir_;
+  std::vector<std::string> files_;
+};
+
+TEST_F(ShaderPipelineTest, IncludesFromIncludeDirs) {
+  WriteFile("shader.glslv", "#include \"common.glslh\"\nvoid main() {}\n");
+  WriteFile("include/common.glslh", "// include dir\n");
+  EXPECT_NE(std::string::npos, Run().find("// include dir"));
+}
+
+TEST_F(ShaderPipelineTest, IncludesFromWorkingDirectoryFirst) {
+  WriteFile("shader.glslv", "#include \"common.glslh\"\nvoid main() {}\n");
+  WriteFile("common.glslh", "// working dir\n");
+  WriteFile("include/common.glslh", "// include dir\n");
+  const std::string vsh = Run();
+  EXPECT_NE(std::string::npos, vsh.find("// working dir"));
+  EXPECT_EQ(std::string::npos, vsh.find("// include dir"));
+}
+
+// Only #included files are searched for in the include dirs.
+TEST_F(ShaderPipelineTest, DoesntReadShadersFromIncludeDirs) {
+  WriteFile("include/shader.glslv", "void main() {}\n");
+  EXPECT_EQ("<failed>", Run());
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
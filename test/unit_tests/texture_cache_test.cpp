@@ -0,0 +1,120 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "fplbase/texture_cache.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+const uint64_t kKey = 0x0123456789abcdefULL;
+
+class TextureCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char dir[] = "/tmp/fplbase_texture_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    dir_ = dir;
+    // A 4x2 8888 texture.
+    for (int i = 0; i < 4 * 2 * 4; ++i) {
+      pixels_.push_back(static_cast<uint8_t>(i));
+    }
+  }
+  virtual void TearDown() {
+    for (auto it = keys_.begin(); it != keys_.end(); ++it) {
+      remove(TextureCache(dir_.c_str()).EntryFilename(*it).c_str());
+    }
+    remove(dir_.c_str());
+  }
+
+  bool Write(TextureCache &cache, uint64_t key) {
+    keys_.push_back(key);
+    return cache.Write(key, pixels_.data(), mathfu::vec2i(4, 2), kFormat8888);
+  }
+
+  std::string dir_;
+  std::vector<uint8_t> pixels_;
+  std::vector<uint64_t> keys_;
+};
+
+TEST_F(TextureCacheTest, ReadsWhatWasWritten) {
+  TextureCache cache(dir_.c_str());
+  EXPECT_TRUE(Write(cache, kKey));
+  mathfu::vec2i size(0, 0);
+  TextureFormat format = kFormatAuto;
+  uint8_t *pixels = cache.Read(kKey, &size, &format);
+  ASSERT_TRUE(pixels != nullptr);
+  EXPECT_EQ(4, size.x);
+  EXPECT_EQ(2, size.y);
+  EXPECT_EQ(kFormat8888, format);
+  EXPECT_EQ(0, memcmp(pixels_.data(), pixels, pixels_.size()));
+  free(pixels);
+  EXPECT_EQ(1, cache.num_writes());
+  EXPECT_EQ(1, cache.num_hits());
+  EXPECT_EQ(0, cache.num_misses());
+}
+
+TEST_F(TextureCacheTest, MissesOtherKeys) {
+  TextureCache cache(dir_.c_str());
+  EXPECT_TRUE(Write(cache, kKey));
+  mathfu::vec2i size;
+  TextureFormat format;
+  EXPECT_TRUE(cache.Read(kKey + 1, &size, &format) == nullptr);
+  EXPECT_EQ(1, cache.num_misses());
+}
+
+// As left behind by a run that was killed while writing, without the
+// temporary file.
+TEST_F(TextureCacheTest, IgnoresTruncatedEntries) {
+  TextureCache cache(dir_.c_str());
+  EXPECT_TRUE(Write(cache, kKey));
+  const std::string filename = cache.EntryFilename(kKey);
+  FILE *file = fopen(filename.c_str(), "rb");
+  ASSERT_TRUE(file != nullptr);
+  std::vector<char> contents(1024);
+  contents.resize(fread(contents.data(), 1, contents.size(), file));
+  fclose(file);
+  file = fopen(filename.c_str(), "wb");
+  ASSERT_TRUE(file != nullptr);
+  fwrite(contents.data(), 1, contents.size() - 1, file);
+  fclose(file);
+
+  mathfu::vec2i size;
+  TextureFormat format;
+  EXPECT_TRUE(cache.Read(kKey, &size, &format) == nullptr);
+  EXPECT_EQ(1, cache.num_misses());
+}
+
+TEST_F(TextureCacheTest, OnlyWritesUncompressedFormats) {
+  TextureCache cache(dir_.c_str());
+  EXPECT_FALSE(cache.Write(kKey, pixels_.data(), mathfu::vec2i(4, 2),
+                           kFormatASTC));
+  EXPECT_EQ(0, cache.num_writes());
+  EXPECT_EQ(16u, TextureCache::DataSize(mathfu::vec2i(4, 2), kFormat5551));
+  EXPECT_EQ(0u, TextureCache::DataSize(mathfu::vec2i(4, 2), kFormatKTX));
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}